@@ -0,0 +1,102 @@
+#ifndef BENCHMARK_GEOMETRY_H
+#define BENCHMARK_GEOMETRY_H
+
+#include <common/grid.h>
+#include <cmath>
+#include <utility>
+
+namespace nucleusforce::benchmarks {
+/**
+  * @brief Kind of synthetic cell
+  */
+enum class Shape {
+  Ellipse, ///< Convex elliptical cell around an elliptical nucleus
+  Branched, ///< Concave cell with narrow arms, so distances wind around the notches
+  MultiNucleus, ///< Grid of small round cells, each with its own nucleus
+};
+
+inline const char* shape_name(Shape shape) {
+  switch (shape) {
+    case Shape::Ellipse: return "ellipse";
+    case Shape::Branched: return "branched";
+    case Shape::MultiNucleus: return "multi_nucleus";
+  }
+  return "";
+}
+
+/**
+  * @brief Synthetic image as labels, with the cell and nucleus masks isolated from it
+  */
+struct Geometry {
+  Shape shape = Shape::Ellipse;
+  int size = 0;
+  Grid<int> labels; ///< 0 background, 1 cell, 2 nucleus
+  Grid<int> cell;
+  Grid<int> nucleus;
+};
+
+/**
+  * @brief Label of the pixel (y, x) of a size x size image of the given shape
+  */
+inline int label_at(Shape shape, int size, int y, int x) {
+  double u = (x + 0.5) / size - 0.5;
+  double v = (y + 0.5) / size - 0.5;
+  switch (shape) {
+    case Shape::Ellipse: {
+      double r = (u / 0.45) * (u / 0.45) + (v / 0.3) * (v / 0.3);
+      return r < 0.1 ? 2 : r < 1 ? 1 : 0;
+    }
+    case Shape::Branched: {
+      // Star with 7 arms whose width shrinks towards their tips
+      double r = std::hypot(u, v);
+      double theta = std::atan2(v, u);
+      double edge = 0.18 + 0.27 * std::pow(std::abs(std::cos(3.5 * theta)), 3);
+      return r < 0.08 ? 2 : r < edge ? 1 : 0;
+    }
+    case Shape::MultiNucleus: {
+      // 8 x 8 cells, each offset from the centre of its tile
+      const int tiles = 8;
+      double tu = u * tiles + tiles / 2.0;
+      double tv = v * tiles + tiles / 2.0;
+      double cu = tu - std::floor(tu) - 0.5;
+      double cv = tv - std::floor(tv) - 0.5;
+      double r = std::hypot(cu, cv * 1.2);
+      return r < 0.12 ? 2 : r < 0.45 ? 1 : 0;
+    }
+  }
+  return 0;
+}
+
+/**
+  * @brief Generate a size x size image of the given shape
+  */
+inline Geometry make_geometry(Shape shape, int size) {
+  Geometry g{shape, size, Grid<int>(size, size), Grid<int>(size, size), Grid<int>(size, size)};
+  for (int y = 0; y < size; ++y) {
+    for (int x = 0; x < size; ++x) {
+      int label = label_at(shape, size, y, x);
+      g.labels(y, x) = label;
+      g.cell(y, x) = label == 1;
+      g.nucleus(y, x) = label == 2;
+    }
+  }
+  return g;
+}
+
+/**
+  * @brief Geometry of the given shape and size, kept until a different one is asked for
+  *
+  * Benchmarks run one size after another, so caching a single geometry avoids
+  * regenerating it for every repetition without holding several 16k x 16k images.
+  */
+inline const Geometry& cached_geometry(Shape shape, int size) {
+  static Geometry cached;
+  if (cached.size != size || cached.shape != shape) {
+    cached = Geometry{};
+    cached = make_geometry(shape, size);
+  }
+  return cached;
+}
+} // namespace nucleusforce::benchmarks
+
+#endif // BENCHMARK_GEOMETRY_H
@@ -0,0 +1,74 @@
+#include <common/grid.h>
+#include <common/kernels.h>
+#include <common/simd.h>
+#include <nucleus_force/nucleus_force.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+using namespace nucleusforce;
+
+/**
+  * @brief Best wall time of several runs of body, in milliseconds
+  */
+static double time_ms(const std::function<void()>& body, int repeats = 5) {
+  double best = 1e300;
+  for (int i = 0; i < repeats; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+int main(int argc, char* argv[]) {
+  int size = argc > 1 ? std::atoi(argv[1]) : 2048;
+
+  // Elliptical cell around an elliptical nucleus, and the label image they came from
+  Grid<int> labels(size, size);
+  Grid<int> cell(size, size);
+  Grid<int> nucleus(size, size);
+  Grid<double> force(size, size);
+  for (int y = 0; y < size; ++y) {
+    for (int x = 0; x < size; ++x) {
+      double u = (x - size / 2.0) / (size * 0.45);
+      double v = (y - size / 2.0) / (size * 0.3);
+      double r = u * u + v * v;
+      labels(y, x) = r < 0.1 ? 2 : r < 1 ? 1 : 0;
+      cell(y, x) = labels(y, x) == 1;
+      nucleus(y, x) = labels(y, x) == 2;
+      force(y, x) = nucleus(y, x) ? 1.0 + (x % 7) : 0.0;
+    }
+  }
+  Grid<int> out(size, size);
+
+  struct Kernel {
+    const char* name;
+    std::function<void()> body;
+  };
+  std::vector<Kernel> benchmarks = {
+    {"isolate_color", [&] {
+      for (int y = 0; y < size; ++y) kernels::select_equal_row(labels.row(y), size, 1, out.row(y));
+    }},
+    {"find_boundary", [&] { find_boundary(cell, nucleus); }},
+    {"find_force_vector", [&] { find_force_vector(nucleus, force); }},
+  };
+
+  std::printf("%d x %d pixels, CPU supports %s\n\n", size, size, simd_level_name(supported_simd_level()));
+  std::printf("%-20s %-8s %10s %10s\n", "kernel", "simd", "ms", "speedup");
+  for (const Kernel& kernel : benchmarks) {
+    double scalar_ms = 0;
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2}) {
+      if (level > supported_simd_level()) continue;
+      set_simd_level(level);
+      double ms = time_ms(kernel.body);
+      if (level == SimdLevel::Scalar) scalar_ms = ms;
+      std::printf("%-20s %-8s %10.2f %9.2fx\n", kernel.name, simd_level_name(level), ms, scalar_ms / ms);
+    }
+  }
+
+  return 0;
+}
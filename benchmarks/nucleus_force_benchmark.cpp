@@ -0,0 +1,262 @@
+#include <benchmark/benchmark.h>
+#include <common/grid.h>
+#include <image/image_parse.h>
+#include <image/image_reader.h>
+#include <nucleus_force/distance.h>
+#include <nucleus_force/moments.h>
+#include <nucleus_force/nucleus_force.h>
+#include <opencv2/core.hpp>
+#include <malloc.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include "geometry.h"
+
+using namespace nucleusforce;
+using namespace nucleusforce::benchmarks;
+
+// Heap use of the whole process, kept by the replacement operator new and delete below
+static std::atomic<long long> heap_bytes{0};
+static std::atomic<long long> heap_peak{0};
+
+void* operator new(std::size_t size) {
+  void* p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) throw std::bad_alloc();
+  long long now = heap_bytes += malloc_usable_size(p);
+  long long peak = heap_peak.load(std::memory_order_relaxed);
+  while (now > peak && !heap_peak.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {}
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  if (p == nullptr) return;
+  heap_bytes -= malloc_usable_size(p);
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  operator delete(p);
+}
+
+/**
+  * @brief Geometry of the benchmark's arguments
+  */
+static const Geometry& setup(benchmark::State& state) {
+  Shape shape = static_cast<Shape>(state.range(0));
+  state.SetLabel(shape_name(shape));
+  return cached_geometry(shape, static_cast<int>(state.range(1)));
+}
+
+/**
+  * @brief Start tracking the peak heap use from what is allocated now
+  */
+static long long start_peak_memory() {
+  long long baseline = heap_bytes.load();
+  heap_peak = baseline;
+  return baseline;
+}
+
+/**
+  * @brief Report pixels per second and the peak heap growth while the benchmark ran
+  */
+static void report(benchmark::State& state, long long baseline) {
+  const double pixels = static_cast<double>(state.range(1)) * state.range(1);
+  state.counters["pixels"] = benchmark::Counter(pixels, benchmark::Counter::kIsIterationInvariantRate);
+  state.counters["peak_mem"] = benchmark::Counter(static_cast<double>(heap_peak - baseline),
+                                                  benchmark::Counter::kDefaults,
+                                                  benchmark::Counter::OneK::kIs1024);
+}
+
+static void BM_ColorMapLoad(benchmark::State& state) {
+  const Geometry& g = setup(state);
+  const cv::Vec3b colors[3] = {cv::Vec3b(0, 0, 0), cv::Vec3b(255, 0, 255), cv::Vec3b(0, 255, 0)};
+  cv::Mat image(g.size, g.size, CV_8UC3);
+  for (int y = 0; y < g.size; ++y) {
+    cv::Vec3b* row = image.ptr<cv::Vec3b>(y);
+    for (int x = 0; x < g.size; ++x) {
+      row[x] = colors[g.labels(y, x)];
+    }
+  }
+
+  long long baseline = start_peak_memory();
+  for (auto _ : state) {
+    image::ColorMap cm;
+    cm.load(image, "benchmark");
+    benchmark::DoNotOptimize(cm.get_color_grid().data());
+  }
+  report(state, baseline);
+}
+
+static void BM_IsolateColor(benchmark::State& state) {
+  const Geometry& g = setup(state);
+  cv::Mat image(g.size, g.size, CV_8UC3);
+  for (int y = 0; y < g.size; ++y) {
+    cv::Vec3b* row = image.ptr<cv::Vec3b>(y);
+    for (int x = 0; x < g.size; ++x) {
+      row[x] = g.labels(y, x) == 1 ? cv::Vec3b(255, 0, 255) : cv::Vec3b(0, 0, 0);
+    }
+  }
+  image::ColorMap cm;
+  cm.load(image, "benchmark");
+  image = cv::Mat();
+
+  long long baseline = start_peak_memory();
+  for (auto _ : state) {
+    Grid<int> cell = image::isolate_color_grid(cm, cv::Vec3b(255, 0, 255));
+    benchmark::DoNotOptimize(cell.data());
+  }
+  report(state, baseline);
+}
+
+static void BM_FindBoundary(benchmark::State& state) {
+  const Geometry& g = setup(state);
+  long long baseline = start_peak_memory();
+  for (auto _ : state) {
+    Grid<int> boundary = find_boundary(g.cell, g.nucleus);
+    benchmark::DoNotOptimize(boundary.data());
+  }
+  report(state, baseline);
+}
+
+static void BM_FindDist(benchmark::State& state) {
+  const Geometry& g = setup(state);
+  long long baseline = start_peak_memory();
+  for (auto _ : state) {
+    Grid<int> dist = find_dist(g.cell, g.nucleus);
+    benchmark::DoNotOptimize(dist.data());
+  }
+  report(state, baseline);
+}
+
+static void BM_FindEuclideanDist(benchmark::State& state) {
+  const Geometry& g = setup(state);
+  long long baseline = start_peak_memory();
+  for (auto _ : state) {
+    Grid<double> dist = find_euclidean_dist(g.cell, g.nucleus);
+    benchmark::DoNotOptimize(dist.data());
+  }
+  report(state, baseline);
+}
+
+static void BM_FindGeodesicDist(benchmark::State& state) {
+  const Geometry& g = setup(state);
+  long long baseline = start_peak_memory();
+  for (auto _ : state) {
+    Grid<double> dist = find_geodesic_dist(g.cell, g.nucleus);
+    benchmark::DoNotOptimize(dist.data());
+  }
+  report(state, baseline);
+}
+
+static void BM_FindNucleusForce(benchmark::State& state) {
+  const Geometry& g = setup(state);
+  long long baseline = start_peak_memory();
+  for (auto _ : state) {
+    Grid<double> force = find_nucleus_force(g.cell, g.nucleus);
+    benchmark::DoNotOptimize(force.data());
+  }
+  report(state, baseline);
+}
+
+static void BM_FindNucleusForceWorkspace(benchmark::State& state) {
+  const Geometry& g = setup(state);
+  Workspace workspace;
+  find_nucleus_force(g.cell, g.nucleus, workspace);
+
+  long long baseline = start_peak_memory();
+  for (auto _ : state) {
+    const Grid<double>& force = find_nucleus_force(g.cell, g.nucleus, workspace);
+    benchmark::DoNotOptimize(force.data());
+  }
+  report(state, baseline);
+}
+
+static void BM_FindNucleusForceNarrow(benchmark::State& state) {
+  const Geometry& g = setup(state);
+  long long baseline = start_peak_memory();
+  for (auto _ : state) {
+    Grid<float> force = find_nucleus_force<Connectivity::Four, uint16_t, float>(g.cell, g.nucleus);
+    benchmark::DoNotOptimize(force.data());
+  }
+  report(state, baseline);
+}
+
+static void BM_FindNucleusForceEight(benchmark::State& state) {
+  const Geometry& g = setup(state);
+  long long baseline = start_peak_memory();
+  for (auto _ : state) {
+    Grid<double> force = find_nucleus_force<Connectivity::Eight>(g.cell, g.nucleus);
+    benchmark::DoNotOptimize(force.data());
+  }
+  report(state, baseline);
+}
+
+static void BM_FindForceVector(benchmark::State& state) {
+  const Geometry& g = setup(state);
+  Grid<double> force(g.size, g.size);
+  for (int y = 0; y < g.size; ++y) {
+    for (int x = 0; x < g.size; ++x) {
+      force(y, x) = g.nucleus(y, x) ? 1.0 + (x % 7) : 0.0;
+    }
+  }
+
+  long long baseline = start_peak_memory();
+  for (auto _ : state) {
+    std::vector<double> force_vector = find_force_vector(g.nucleus, force);
+    benchmark::DoNotOptimize(force_vector.data());
+  }
+  report(state, baseline);
+}
+
+static void BM_FindForceMoments(benchmark::State& state) {
+  const Geometry& g = setup(state);
+  Grid<double> force(g.size, g.size);
+  for (int y = 0; y < g.size; ++y) {
+    for (int x = 0; x < g.size; ++x) {
+      force(y, x) = g.nucleus(y, x) ? 1.0 + (x % 7) : 0.0;
+    }
+  }
+  // The nucleus pixel list a ForceMap already holds as its first distance level
+  std::vector<int> pixels;
+  for (size_t i = 0; i < g.nucleus.size(); ++i) {
+    if (g.nucleus.data()[i] == 1) pixels.push_back(static_cast<int>(i));
+  }
+  ThreadPool pool(1);
+
+  long long baseline = start_peak_memory();
+  for (auto _ : state) {
+    ForceMoments moments = find_force_moments(pixels.data(), pixels.data() + pixels.size(), force, pool);
+    benchmark::DoNotOptimize(moments);
+  }
+  report(state, baseline);
+}
+
+/**
+  * @brief Every shape at 256, 1024, 4096 and 16384 pixels square
+  *
+  * The largest size needs several GiB of memory, so filter it out on smaller machines.
+  */
+static void geometries(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"shape", "size"});
+  b->ArgsProduct({{static_cast<int>(Shape::Ellipse), static_cast<int>(Shape::Branched),
+                   static_cast<int>(Shape::MultiNucleus)},
+                  benchmark::CreateRange(256, 16384, 4)});
+  b->Unit(benchmark::kMillisecond);
+}
+
+BENCHMARK(BM_ColorMapLoad)->Apply(geometries);
+BENCHMARK(BM_IsolateColor)->Apply(geometries);
+BENCHMARK(BM_FindBoundary)->Apply(geometries);
+BENCHMARK(BM_FindDist)->Apply(geometries);
+BENCHMARK(BM_FindEuclideanDist)->Apply(geometries);
+BENCHMARK(BM_FindGeodesicDist)->Apply(geometries);
+BENCHMARK(BM_FindNucleusForce)->Apply(geometries);
+BENCHMARK(BM_FindNucleusForceWorkspace)->Apply(geometries);
+BENCHMARK(BM_FindNucleusForceNarrow)->Apply(geometries);
+BENCHMARK(BM_FindNucleusForceEight)->Apply(geometries);
+BENCHMARK(BM_FindForceVector)->Apply(geometries);
+BENCHMARK(BM_FindForceMoments)->Apply(geometries);
+
+BENCHMARK_MAIN();
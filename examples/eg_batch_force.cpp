@@ -0,0 +1,52 @@
+#include <batch/time_lapse.h>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+  if (argc == 1) {
+    std::cerr << "Usage: " << argv[0]
+              << " <directory|glob|multi-page tiff> [output directory] [threads] [csv|npy|raw]" << std::endl;
+    return 1;
+  }
+
+  // Same colors as eg_boundary_force:
+  // - black: empty space
+  // - magenta: cell
+  // - green: nucleus boundary
+  nucleusforce::batch::BatchOptions options;
+  options.output_dir = argc > 2 ? argv[2] : "output/batch";
+  options.threads = argc > 3 ? static_cast<unsigned>(std::stoul(argv[3])) : 0;
+
+  std::string format = argc > 4 ? argv[4] : "csv";
+  if (format == "npy") {
+    options.format = nucleusforce::batch::OutputFormat::Npy;
+  } else if (format == "raw") {
+    options.format = nucleusforce::batch::OutputFormat::Raw;
+  } else if (format != "csv") {
+    std::cerr << "Unknown output format: " << format << std::endl;
+    return 1;
+  }
+
+  std::vector<nucleusforce::batch::FrameResult> results;
+  try {
+    results = nucleusforce::batch::run_batch(std::string(argv[1]), options);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  int failed = 0;
+  for (const nucleusforce::batch::FrameResult& result : results) {
+    if (!result.ok) {
+      std::cerr << result.name << ": " << result.error << std::endl;
+      failed++;
+    }
+  }
+
+  std::cout << "Processed " << results.size() - failed << " of " << results.size() << " frames into "
+            << options.output_dir << "." << std::endl;
+
+  return failed == 0 ? 0 : 1;
+}
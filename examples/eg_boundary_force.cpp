@@ -1,9 +1,14 @@
 #include "opencv2/core/matx.hpp"
+#include <common/grid.h>
 #include <image/image_reader.h>
 #include <image/image_parse.h>
 #include <iostream>
+#include <nucleus_force/force_map.h>
 #include <nucleus_force/nucleus_force.h>
 #include <unordered_map>
+#include <vector>
+
+using nucleusforce::Grid;
 
 int main(int argc, char* argv[]) {
   if (argc == 1) {
@@ -24,19 +29,19 @@ int main(int argc, char* argv[]) {
 
   std::cout << "Read image into color map..." << std::endl;
 
-  std::vector<std::vector<int>> cell = nucleusforce::image::isolate_color(cm, cv::Vec3b(255, 0, 255));
-  std::vector<std::vector<int>> nucleus = nucleusforce::image::isolate_color(cm, cv::Vec3b(0, 255, 0));
+  std::vector<Grid<int>> masks = nucleusforce::image::isolate_colors(cm, {cv::Vec3b(255, 0, 255), cv::Vec3b(0, 255, 0)});
+  const Grid<int>& cell = masks[0];
+  const Grid<int>& nucleus = masks[1];
 
   std::cout << "Isolated cell and nucleus colors..." << std::endl;
 
-  std::vector<std::vector<int>> boundary = nucleusforce::find_boundary(cell, nucleus);
-  std::vector<std::vector<int>> dist = nucleusforce::find_dist(cell, nucleus);
-  std::vector<std::vector<double>> force = nucleusforce::find_nucleus_force(cell, nucleus);
+  nucleusforce::ForceMap force_map(cell, nucleus);
+  Grid<double> force = force_map.nucleus_force();
 
   std::cout << "Finding force and exporting..." << std::endl;
 
-  nucleusforce::export_csv("output/boundary.csv", boundary);
-  nucleusforce::export_csv("output/dist.csv", dist);
+  nucleusforce::export_csv("output/boundary.csv", force_map.boundary());
+  nucleusforce::export_csv("output/dist.csv", force_map.dist());
   nucleusforce::export_csv("output/force.csv", force);
 
   std::cout << "Done." << std::endl;
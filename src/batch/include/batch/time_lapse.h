@@ -0,0 +1,111 @@
+#ifndef TIME_LAPSE_H
+#define TIME_LAPSE_H
+
+#include <common/trace.h>
+#include <image/image_reader.h>
+#include <opencv2/core.hpp>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace nucleusforce::batch {
+/**
+  * @brief File format of the per-frame arrays
+  */
+enum class OutputFormat {
+  Csv, ///< Text, as written by export_csv
+  Npy, ///< NumPy .npy, as written by export_npy
+  Raw, ///< Raw binary grid, as written by export_raw
+};
+
+/**
+  * @brief Settings shared by every frame of a batch
+  */
+struct BatchOptions {
+  /// Number each color of the image maps to, defaults to black background, magenta cell and green nucleus
+  std::unordered_map<cv::Vec3b, int> color_mapping = {
+    {cv::Vec3b(0, 0, 0), 0},
+    {cv::Vec3b(255, 0, 255), 1},
+    {cv::Vec3b(0, 255, 0), 2},
+  };
+  cv::Vec3b cell_color = cv::Vec3b(255, 0, 255); ///< Color of the cell in BGR
+  cv::Vec3b nucleus_color = cv::Vec3b(0, 255, 0); ///< Color of the nucleus in BGR
+  unsigned threads = 0; ///< Frames processed at once, 0 for one per hardware core
+  size_t max_in_flight = 0; ///< Decoded frames waiting for a thread, 0 for twice the thread count
+  std::string output_dir; ///< Directory for per-frame arrays and summary.csv, empty to write nothing
+  OutputFormat format = OutputFormat::Csv; ///< File format of the per-frame arrays
+  bool sparse_force = false; ///< Write the force as one (y, x, force) row per non-zero pixel instead of a full array
+  bool write_trace = false; ///< Write the stage timings of every frame to trace.json in Chrome trace-event format
+};
+
+/**
+  * @brief Net force on the nucleus in one frame
+  */
+struct FrameResult {
+  int index = 0; ///< Position of the frame in the time-lapse
+  std::string name; ///< Name of the frame, used to prefix its output files
+  bool ok = false; ///< Whether the frame was processed
+  std::string error; ///< Why the frame could not be processed
+  std::vector<double> centroid; ///< (x, y) centroid of the nucleus
+  std::vector<double> force_vector; ///< (x, y) net force on the nucleus
+  trace::Trace trace; ///< Stage timings and counters, empty unless built with NUCLEUSFORCE_TRACE
+};
+
+/**
+  * @brief List the image files of a time-lapse
+  *
+  * @param input a directory (every image in it), a glob such as frames/t_*.png (only the
+  *              file name may contain * and ?), or a single image or multi-page TIFF
+  *
+  * @return paths sorted by file name
+  * @throws std::invalid_argument if no image matches
+  */
+std::vector<std::string> find_frame_files(const std::string& input);
+
+/**
+  * @brief Find the net force on the nucleus in every frame of a time-lapse
+  *
+  * Frames are decoded on the calling thread and handed to a fixed set of worker threads
+  * through a bounded queue, so at most max_in_flight decoded frames wait in memory
+  * however far decoding gets ahead. Every page of a TIFF is a frame of its own. A frame
+  * that cannot be read or processed is reported in its result rather than stopping the
+  * batch.
+  *
+  * When output_dir is set, each frame's boundary, distance and force arrays are written to
+  * <name>_boundary, <name>_dist and <name>_force with the extension of the output format
+  * (.csv, .npy or .grid), and the results to summary.csv. With sparse_force the force
+  * file is an N x 3 array of (y, x, force) rows, so its size scales with the nucleus
+  * rather than the image. With write_trace, the stage timings of every frame are written
+  * to trace.json, one thread per frame, for chrome://tracing or Perfetto.
+  *
+  * @param files image files in time-lapse order, as returned by find_frame_files
+  * @param options settings shared by every frame
+  *
+  * @return one result per frame in time-lapse order
+  */
+std::vector<FrameResult> run_batch(const std::vector<std::string>& files, const BatchOptions& options);
+
+/**
+  * @brief Find the net force on the nucleus in every frame of the time-lapse at input
+  *
+  * @param input directory, glob or file accepted by find_frame_files
+  * @param options settings shared by every frame
+  *
+  * @return one result per frame in time-lapse order
+  */
+std::vector<FrameResult> run_batch(const std::string& input, const BatchOptions& options);
+
+/**
+  * @brief Output the results as a csv with one row per frame
+  *
+  * Columns are frame, name, centroid_x, centroid_y, force_x, force_y and error. The numeric
+  * columns are empty for frames that failed.
+  *
+  * @param filepath string of the filepath for the csv
+  * @param results results from run_batch
+  */
+void write_summary(const std::string& filepath, const std::vector<FrameResult>& results);
+} // namespace nucleusforce::batch
+
+#endif // TIME_LAPSE_H
@@ -0,0 +1,337 @@
+#include <batch/time_lapse.h>
+
+#include <common/bounded_queue.h>
+#include <common/grid.h>
+#include <common/sparse_grid.h>
+#include <common/trace.h>
+#include <image/image_parse.h>
+#include <nucleus_force/grid_io.h>
+#include <nucleus_force/nucleus_force.h>
+#include <nucleus_force/workspace.h>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cctype>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace nucleusforce::batch {
+/**
+  * @brief A decoded frame waiting to be processed
+  */
+struct Frame {
+  int index = 0;
+  std::string name;
+  cv::Mat image; ///< Empty if the frame could not be read
+  trace::Clock::time_point read_start; ///< When decoding the file holding the frame started
+  trace::Clock::time_point read_end; ///< When decoding it finished
+};
+
+static std::string lowercase_extension(const fs::path& path) {
+  std::string extension = path.extension().string();
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return extension;
+}
+
+static bool is_image(const fs::path& path) {
+  const std::string extension = lowercase_extension(path);
+  return extension == ".png" || extension == ".tif" || extension == ".tiff" ||
+         extension == ".jpg" || extension == ".jpeg" || extension == ".bmp";
+}
+
+static bool is_tiff(const fs::path& path) {
+  const std::string extension = lowercase_extension(path);
+  return extension == ".tif" || extension == ".tiff";
+}
+
+/**
+  * @brief Match name against a pattern where * is any run of characters and ? is any one character
+  */
+static bool match_glob(const std::string& pattern, const std::string& name) {
+  size_t p = 0;
+  size_t n = 0;
+  size_t star = std::string::npos; // Position of the last * in pattern
+  size_t resume = 0; // Position in name to retry from after the last *
+  while (n < name.size()) {
+    if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+      ++p;
+      ++n;
+    } else if (p < pattern.size() && pattern[p] == '*') {
+      star = p++;
+      resume = n;
+    } else if (star != std::string::npos) {
+      p = star + 1;
+      n = ++resume;
+    } else {
+      return false;
+    }
+  }
+  while (p < pattern.size() && pattern[p] == '*') ++p;
+  return p == pattern.size();
+}
+
+std::vector<std::string> find_frame_files(const std::string& input) {
+  fs::path path(input);
+  std::vector<fs::path> files;
+
+  if (fs::is_directory(path)) {
+    for (const fs::directory_entry& entry : fs::directory_iterator(path)) {
+      if (entry.is_regular_file() && is_image(entry.path())) {
+        files.push_back(entry.path());
+      }
+    }
+  } else if (path.filename().string().find_first_of("*?") != std::string::npos) {
+    fs::path dir = path.has_parent_path() ? path.parent_path() : fs::path(".");
+    const std::string pattern = path.filename().string();
+    if (fs::is_directory(dir)) {
+      for (const fs::directory_entry& entry : fs::directory_iterator(dir)) {
+        if (entry.is_regular_file() && match_glob(pattern, entry.path().filename().string())) {
+          files.push_back(entry.path());
+        }
+      }
+    }
+  } else if (fs::is_regular_file(path)) {
+    files.push_back(path);
+  }
+
+  if (files.empty()) {
+    throw std::invalid_argument("No frames found at: " + input);
+  }
+
+  std::sort(files.begin(), files.end(), [](const fs::path& a, const fs::path& b) {
+    return a.filename().string() < b.filename().string();
+  });
+
+  std::vector<std::string> paths;
+  for (const fs::path& file : files) {
+    paths.push_back(file.string());
+  }
+  return paths;
+}
+
+/**
+  * @brief Decode every frame of files in order and push them onto the queue
+  */
+static void read_frames(const std::vector<std::string>& files, BoundedQueue<Frame>& queue) {
+  int index = 0;
+  for (const std::string& file : files) {
+    fs::path path(file);
+    const std::string stem = path.stem().string();
+
+    const trace::Clock::time_point start = trace::Clock::now();
+    if (!is_tiff(path)) {
+      cv::Mat image = cv::imread(file, cv::IMREAD_COLOR);
+      queue.push({index++, stem, std::move(image), start, trace::Clock::now()});
+      continue;
+    }
+
+    // Every page of a TIFF is decoded at once, so each is charged the whole decode
+    std::vector<cv::Mat> pages;
+    if (!cv::imreadmulti(file, pages, cv::IMREAD_COLOR) || pages.empty()) {
+      queue.push({index++, stem, cv::Mat(), start, trace::Clock::now()});
+      continue;
+    }
+    const trace::Clock::time_point end = trace::Clock::now();
+    for (size_t page = 0; page < pages.size(); ++page) {
+      std::string name = stem;
+      if (pages.size() > 1) {
+        std::ostringstream suffix;
+        suffix << "_" << std::setw(4) << std::setfill('0') << page;
+        name += suffix.str();
+      }
+      queue.push({index++, name, std::move(pages[page]), start, end});
+    }
+  }
+}
+
+/**
+  * @brief Write array to prefix with the extension of format
+  */
+template <typename T>
+static void write_array(const std::string& prefix, const Grid<T>& array, OutputFormat format) {
+  switch (format) {
+    case OutputFormat::Csv:
+      export_csv(prefix + ".csv", array);
+      break;
+    case OutputFormat::Npy:
+      export_npy(prefix + ".npy", array);
+      break;
+    case OutputFormat::Raw:
+      export_raw(prefix + ".grid", array);
+      break;
+  }
+}
+
+/**
+  * @brief Find the force on one frame and write its arrays
+  *
+  * workspace belongs to the calling worker, so once it has seen a frame as large as this
+  * one the boundary, distance and force are found without allocating.
+  */
+static FrameResult process_frame(const Frame& frame, const BatchOptions& options, Workspace& workspace) {
+  FrameResult result;
+  result.index = frame.index;
+  result.name = frame.name;
+  result.trace.name = frame.name;
+  trace::Session session(result.trace);
+  NF_TRACE_SPAN("imread", frame.read_start, frame.read_end);
+
+  try {
+    NF_TRACE_SCOPE("process_frame");
+    if (frame.image.empty()) {
+      throw std::invalid_argument("Could not read frame: " + frame.name);
+    }
+
+    image::ColorMap cm;
+    cm.load(frame.image, frame.name, options.color_mapping);
+    // Everything is computed on the bounding box of the cell and nucleus, and only put
+    // back into the full frame when written
+    const std::vector<cv::Vec3b> colors = {options.cell_color, options.nucleus_color};
+    const Region region = image::find_colors_bounding_box(cm, colors);
+    std::vector<Grid<int>> masks = image::isolate_colors(cm, colors, region);
+
+    const Grid<double>& force = find_nucleus_force(masks[0], masks[1], workspace);
+    result.centroid = find_nucleus_centroid(masks[1]);
+    result.centroid[0] += region.x;
+    result.centroid[1] += region.y;
+
+    std::optional<SparseGrid<double>> sparse;
+    if (options.sparse_force) {
+      sparse = SparseGrid<double>::from_dense(force);
+      result.force_vector = find_force_vector(masks[1], *sparse);
+    } else {
+      result.force_vector = find_force_vector(masks[1], force);
+    }
+
+    if (!options.output_dir.empty()) {
+      const std::string prefix = (fs::path(options.output_dir) / frame.name).string();
+      const int rows = cm.get_color_grid().rows();
+      const int cols = cm.get_color_grid().cols();
+      write_array(prefix + "_boundary", embed(workspace.boundary, region, rows, cols), options.format);
+      write_array(prefix + "_dist", embed(workspace.dist, region, rows, cols, -1), options.format);
+      if (sparse) {
+        Grid<double> coordinates = sparse->to_coordinates();
+        for (int i = 0; i < coordinates.rows(); ++i) {
+          coordinates(i, 0) += region.y;
+          coordinates(i, 1) += region.x;
+        }
+        write_array(prefix + "_force", coordinates, options.format);
+      } else {
+        write_array(prefix + "_force", embed(force, region, rows, cols), options.format);
+      }
+    }
+    result.ok = true;
+  } catch (const std::exception& e) {
+    result.ok = false;
+    result.error = e.what();
+    result.centroid.clear();
+    result.force_vector.clear();
+  }
+
+  return result;
+}
+
+std::vector<FrameResult> run_batch(const std::vector<std::string>& files, const BatchOptions& options) {
+  unsigned threads = options.threads;
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  size_t max_in_flight = options.max_in_flight == 0 ? 2 * threads : options.max_in_flight;
+
+  if (!options.output_dir.empty()) {
+    fs::create_directories(options.output_dir);
+  }
+
+  BoundedQueue<Frame> queue(max_in_flight);
+  std::vector<FrameResult> results;
+  std::mutex results_mutex;
+
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < threads; ++i) {
+    workers.emplace_back([&] {
+      Workspace workspace;
+      while (std::optional<Frame> frame = queue.pop()) {
+        FrameResult result = process_frame(*frame, options, workspace);
+        std::lock_guard<std::mutex> lock(results_mutex);
+        results.push_back(std::move(result));
+      }
+    });
+  }
+
+  // Always let the workers finish before leaving, even if reading throws
+  try {
+    read_frames(files, queue);
+  } catch (...) {
+    queue.close();
+    for (std::thread& worker : workers) worker.join();
+    throw;
+  }
+  queue.close();
+  for (std::thread& worker : workers) worker.join();
+
+  std::sort(results.begin(), results.end(), [](const FrameResult& a, const FrameResult& b) {
+    return a.index < b.index;
+  });
+
+  if (!options.output_dir.empty()) {
+    write_summary((fs::path(options.output_dir) / "summary.csv").string(), results);
+    if (options.write_trace) {
+      std::vector<const trace::Trace*> traces;
+      for (const FrameResult& result : results) {
+        traces.push_back(&result.trace);
+      }
+      trace::write_chrome_trace((fs::path(options.output_dir) / "trace.json").string(), traces);
+    }
+  }
+
+  return results;
+}
+
+std::vector<FrameResult> run_batch(const std::string& input, const BatchOptions& options) {
+  return run_batch(find_frame_files(input), options);
+}
+
+/**
+  * @brief Quote a csv field, doubling any quotes inside it
+  */
+static std::string quote_csv(const std::string& field) {
+  std::string quoted = "\"";
+  for (char c : field) {
+    if (c == '"') quoted += '"';
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+void write_summary(const std::string& filepath, const std::vector<FrameResult>& results) {
+  std::ofstream file(filepath);
+
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open file for writing: " + filepath);
+  }
+
+  file << std::setprecision(17);
+  file << "frame,name,centroid_x,centroid_y,force_x,force_y,error\n";
+  for (const FrameResult& result : results) {
+    file << result.index << "," << quote_csv(result.name) << ",";
+    if (result.ok) {
+      file << result.centroid[0] << "," << result.centroid[1] << ","
+           << result.force_vector[0] << "," << result.force_vector[1] << ",";
+    } else {
+      file << ",,,," << quote_csv(result.error);
+    }
+    file << "\n";
+  }
+}
+} // namespace nucleusforce::batch
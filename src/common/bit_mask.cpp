@@ -0,0 +1,45 @@
+#include <common/bit_mask.h>
+
+namespace nucleusforce {
+BitMask::BitMask(int rows, int cols)
+    : rows_(rows), cols_(cols), words_per_row_((cols + 63) / 64),
+      words_(static_cast<size_t>(rows) * ((cols + 63) / 64), 0) {}
+
+BitMask BitMask::from_grid(GridView<const int> grid) {
+  BitMask mask(grid.rows(), grid.cols());
+  for (int y = 0; y < grid.rows(); ++y) {
+    const int* in = grid.row(y);
+    uint64_t* out = mask.row(y);
+    for (int w = 0; w < mask.words_per_row_; ++w) {
+      int begin = w * 64;
+      int end = std::min(begin + 64, grid.cols());
+      uint64_t word = 0;
+      for (int x = begin; x < end; ++x) {
+        word |= uint64_t(in[x] == 1) << (x - begin);
+      }
+      out[w] = word;
+    }
+  }
+  return mask;
+}
+
+Grid<int> BitMask::to_grid() const {
+  Grid<int> grid(rows_, cols_);
+  for (int y = 0; y < rows_; ++y) {
+    const uint64_t* in = row(y);
+    int* out = grid.row(y);
+    for (int x = 0; x < cols_; ++x) {
+      out[x] = (in[x >> 6] >> (x & 63)) & 1;
+    }
+  }
+  return grid;
+}
+
+size_t BitMask::count() const {
+  size_t total = 0;
+  for (uint64_t word : words_) {
+    total += __builtin_popcountll(word);
+  }
+  return total;
+}
+} // namespace nucleusforce
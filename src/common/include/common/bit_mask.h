@@ -0,0 +1,83 @@
+#ifndef BIT_MASK_H
+#define BIT_MASK_H
+
+#include <algorithm>
+#include <common/grid.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nucleusforce {
+/**
+  * @brief Binary 2D mask packed 64 pixels per word
+  *
+  * Each row starts on a new word. Pixel x of a row is bit x % 64 of word x / 64, and the
+  * bits past the last column of a row are always 0.
+  */
+class BitMask {
+public:
+  /**
+    * @brief Empty mask
+    */
+  BitMask() = default;
+
+  /**
+    * @brief Mask of rows x cols pixels, all 0
+    */
+  BitMask(int rows, int cols);
+
+  /**
+    * @brief Pack a 2D array where 1 is set and anything else is not
+    */
+  static BitMask from_grid(GridView<const int> grid);
+
+  /**
+    * @brief Unpack into a 2D array of 1s and 0s
+    */
+  Grid<int> to_grid() const;
+
+  int rows() const { return rows_; }
+  int cols() const { return cols_; }
+
+  /**
+    * @brief Number of 64-bit words in each row
+    */
+  int words_per_row() const { return words_per_row_; }
+
+  uint64_t* row(int y) { return words_.data() + static_cast<size_t>(y) * words_per_row_; }
+  const uint64_t* row(int y) const { return words_.data() + static_cast<size_t>(y) * words_per_row_; }
+
+  bool get(int y, int x) const { return (row(y)[x >> 6] >> (x & 63)) & 1; }
+
+  void set(int y, int x, bool value) {
+    uint64_t bit = uint64_t(1) << (x & 63);
+    if (value) row(y)[x >> 6] |= bit;
+    else row(y)[x >> 6] &= ~bit;
+  }
+
+  /**
+    * @brief Number of set pixels
+    */
+  size_t count() const;
+
+  /**
+    * @brief Bits of the last word of a row that hold pixels, used to keep the padding at 0
+    */
+  uint64_t last_word_mask() const {
+    return (cols_ & 63) == 0 ? ~uint64_t(0) : (uint64_t(1) << (cols_ & 63)) - 1;
+  }
+
+  bool operator==(const BitMask& other) const {
+    return rows_ == other.rows_ && cols_ == other.cols_ && words_ == other.words_;
+  }
+  bool operator!=(const BitMask& other) const { return !(*this == other); }
+
+private:
+  int rows_ = 0;
+  int cols_ = 0;
+  int words_per_row_ = 0;
+  std::vector<uint64_t> words_;
+}; // class BitMask
+} // namespace nucleusforce
+
+#endif // BIT_MASK_H
@@ -0,0 +1,89 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+namespace nucleusforce {
+/**
+  * @brief First-in first-out queue shared between threads that holds at most a fixed number of items
+  *
+  * push blocks while the queue is full, so a fast producer waits for its consumers
+  * instead of piling up work in memory.
+  */
+template <typename T>
+class BoundedQueue {
+public:
+  /**
+    * @param capacity largest number of items held at once, at least 1
+    */
+  explicit BoundedQueue(size_t capacity) : capacity_(capacity) {
+    if (capacity == 0) {
+      throw std::invalid_argument("BoundedQueue capacity must be at least 1");
+    }
+  }
+
+  BoundedQueue(const BoundedQueue&) = delete;
+  BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+  /**
+    * @brief Add an item, waiting for space if the queue is full
+    *
+    * @return false if the queue was closed and the item was dropped
+    */
+  bool push(T item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+    if (closed_) return false;
+    items_.push_back(std::move(item));
+    not_empty_.notify_one();
+    return true;
+  }
+
+  /**
+    * @brief Take the oldest item, waiting for one if the queue is empty
+    *
+    * @return the item, or nothing once the queue is closed and empty
+    */
+  std::optional<T> pop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+    if (items_.empty()) return std::nullopt;
+    T item = std::move(items_.front());
+    items_.pop_front();
+    not_full_.notify_one();
+    return item;
+  }
+
+  /**
+    * @brief Stop accepting items and wake every waiting thread
+    *
+    * Items already queued can still be popped.
+    */
+  void close() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+    }
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+
+  size_t capacity() const { return capacity_; }
+
+private:
+  const size_t capacity_;
+  std::deque<T> items_;
+  bool closed_ = false;
+  std::mutex mutex_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+}; // class BoundedQueue
+} // namespace nucleusforce
+
+#endif // BOUNDED_QUEUE_H
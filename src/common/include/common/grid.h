@@ -0,0 +1,267 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <common/trace.h>
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace nucleusforce {
+/**
+  * @brief Rectangle of a grid with top-left corner (y, x)
+  */
+struct Region {
+  int y = 0;
+  int x = 0;
+  int rows = 0;
+  int cols = 0;
+
+  bool empty() const { return rows == 0 || cols == 0; }
+
+  bool operator==(const Region& other) const {
+    return y == other.y && x == other.x && rows == other.rows && cols == other.cols;
+  }
+  bool operator!=(const Region& other) const { return !(*this == other); }
+};
+
+/**
+  * @brief Rows top to bottom and columns left to right, inclusive, grown by halo on every side and clipped to a rows x cols grid
+  */
+inline Region grow_region(int top, int bottom, int left, int right, int halo, int rows, int cols) {
+  Region region;
+  region.y = std::max(0, top - halo);
+  region.x = std::max(0, left - halo);
+  region.rows = std::min(rows - 1, bottom + halo) - region.y + 1;
+  region.cols = std::min(cols - 1, right + halo) - region.x + 1;
+  return region;
+}
+
+/**
+  * @brief Non-owning view of a row-major 2D array
+  *
+  * Rows are `stride` elements apart, so a view can describe a whole Grid or a
+  * rectangular window of one without copying.
+  */
+template <typename T>
+class GridView {
+public:
+  /**
+    * @brief Empty view
+    */
+  GridView() = default;
+
+  /**
+    * @brief View rows x cols elements starting at data, with rows stride elements apart
+    *
+    * @param data pointer to the first element of the first row
+    * @param rows number of rows
+    * @param cols number of columns
+    * @param stride distance in elements between the starts of consecutive rows
+    */
+  GridView(T* data, int rows, int cols, std::ptrdiff_t stride)
+      : data_(data), rows_(rows), cols_(cols), stride_(stride) {}
+
+  /**
+    * @brief View a contiguous block of rows x cols elements
+    */
+  GridView(T* data, int rows, int cols) : GridView(data, rows, cols, cols) {}
+
+  /**
+    * @brief Allow a mutable view to be passed where a read-only view is expected
+    */
+  template <typename U, typename = std::enable_if_t<std::is_same_v<T, const U>>>
+  GridView(const GridView<U>& other)
+      : data_(other.data()), rows_(other.rows()), cols_(other.cols()), stride_(other.stride()) {}
+
+  int rows() const { return rows_; }
+  int cols() const { return cols_; }
+  std::ptrdiff_t stride() const { return stride_; }
+  T* data() const { return data_; }
+  bool empty() const { return rows_ == 0 || cols_ == 0; }
+  bool is_contiguous() const { return stride_ == cols_; }
+
+  /**
+    * @brief Pointer to the first element of row y
+    */
+  T* row(int y) const { return data_ + y * stride_; }
+
+  T& operator()(int y, int x) const { return data_[y * stride_ + x]; }
+
+  /**
+    * @brief View of the rectangle with top-left corner (y, x)
+    */
+  GridView subview(int y, int x, int rows, int cols) const {
+    if (y < 0 || x < 0 || rows < 0 || cols < 0 || y + rows > rows_ || x + cols > cols_) {
+      throw std::out_of_range("subview exceeds the bounds of the grid");
+    }
+    return GridView(data_ + y * stride_ + x, rows, cols, stride_);
+  }
+
+  /**
+    * @brief View of region
+    */
+  GridView subview(const Region& region) const { return subview(region.y, region.x, region.rows, region.cols); }
+
+  /**
+    * @brief Copy the viewed elements into a vector of vectors
+    */
+  std::vector<std::vector<std::remove_const_t<T>>> to_vector() const {
+    std::vector<std::vector<std::remove_const_t<T>>> array(rows_);
+    for (int y = 0; y < rows_; ++y) {
+      array[y].assign(row(y), row(y) + cols_);
+    }
+    return array;
+  }
+
+private:
+  T* data_ = nullptr;
+  int rows_ = 0;
+  int cols_ = 0;
+  std::ptrdiff_t stride_ = 0;
+}; // class GridView
+
+/**
+  * @brief Owning 2D array stored as a single contiguous row-major buffer
+  */
+template <typename T>
+class Grid {
+public:
+  /**
+    * @brief Empty grid
+    */
+  Grid() = default;
+
+  /**
+    * @brief Grid of rows x cols elements, all set to value
+    */
+  Grid(int rows, int cols, const T& value = T())
+      : rows_(rows), cols_(cols), data_(static_cast<size_t>(rows) * cols, value) {
+    NF_TRACE_COUNT("bytes_allocated", static_cast<long long>(data_.size() * sizeof(T)));
+  }
+
+  /**
+    * @brief Copy a view into a new grid
+    */
+  explicit Grid(GridView<const T> view) : Grid(view.rows(), view.cols()) {
+    for (int y = 0; y < rows_; ++y) {
+      std::copy(view.row(y), view.row(y) + cols_, row(y));
+    }
+  }
+
+  /**
+    * @brief Copy a vector of vectors into a new grid
+    *
+    * @param array rectangular 2D array
+    */
+  static Grid from_vector(const std::vector<std::vector<T>>& array) {
+    if (array.empty()) {
+      return Grid();
+    }
+    Grid grid(static_cast<int>(array.size()), static_cast<int>(array[0].size()));
+    for (int y = 0; y < grid.rows_; ++y) {
+      if (array[y].size() != static_cast<size_t>(grid.cols_)) {
+        throw std::invalid_argument("All rows of the array must have the same length.");
+      }
+      std::copy(array[y].begin(), array[y].end(), grid.row(y));
+    }
+    return grid;
+  }
+
+  /**
+    * @brief Copy the grid into a vector of vectors
+    */
+  std::vector<std::vector<T>> to_vector() const { return view().to_vector(); }
+
+  int rows() const { return rows_; }
+  int cols() const { return cols_; }
+  size_t size() const { return data_.size(); }
+  bool empty() const { return data_.empty(); }
+
+  T* data() { return data_.data(); }
+  const T* data() const { return data_.data(); }
+  T* row(int y) { return data_.data() + static_cast<size_t>(y) * cols_; }
+  const T* row(int y) const { return data_.data() + static_cast<size_t>(y) * cols_; }
+
+  T& operator()(int y, int x) { return data_[static_cast<size_t>(y) * cols_ + x]; }
+  const T& operator()(int y, int x) const { return data_[static_cast<size_t>(y) * cols_ + x]; }
+
+  /**
+    * @brief Set every element to value
+    */
+  void fill(const T& value) { std::fill(data_.begin(), data_.end(), value); }
+
+  /**
+    * @brief Resize to rows x cols elements, all set to value, keeping the storage when it is large enough
+    *
+    * Reusing a grid this way allocates nothing once it has held the largest size asked of it.
+    */
+  void assign(int rows, int cols, const T& value = T()) {
+    const size_t size = static_cast<size_t>(rows) * cols;
+    if (size > data_.capacity()) {
+      NF_TRACE_COUNT("bytes_allocated", static_cast<long long>(size * sizeof(T)));
+    }
+    rows_ = rows;
+    cols_ = cols;
+    data_.assign(size, value);
+  }
+
+  /**
+    * @brief Elements the grid can hold without allocating
+    */
+  size_t capacity() const { return data_.capacity(); }
+
+  GridView<T> view() { return GridView<T>(data(), rows_, cols_); }
+  GridView<const T> view() const { return GridView<const T>(data(), rows_, cols_); }
+
+  operator GridView<T>() { return view(); }
+  operator GridView<const T>() const { return view(); }
+
+  bool operator==(const Grid& other) const {
+    return rows_ == other.rows_ && cols_ == other.cols_ && data_ == other.data_;
+  }
+  bool operator!=(const Grid& other) const { return !(*this == other); }
+
+private:
+  int rows_ = 0;
+  int cols_ = 0;
+  std::vector<T> data_;
+}; // class Grid
+
+/**
+  * @brief Place a grid cut from region of a larger grid back into a grid of the full size
+  *
+  * @param crop grid the size of region
+  * @param region where crop sits in the full grid
+  * @param rows rows of the full grid
+  * @param cols columns of the full grid
+  * @param fill value of every element outside region
+  */
+template <typename T>
+Grid<T> embed(const Grid<T>& crop, const Region& region, int rows, int cols, const T& fill = T()) {
+  if (crop.rows() != region.rows || crop.cols() != region.cols) {
+    throw std::invalid_argument("Cropped grid must be the size of its region.");
+  }
+  Grid<T> full(rows, cols, fill);
+  GridView<T> window = full.view().subview(region);
+  for (int y = 0; y < region.rows; ++y) {
+    std::copy(crop.row(y), crop.row(y) + region.cols, window.row(y));
+  }
+  return full;
+}
+
+/**
+  * @brief Check that two grids have the same dimensions
+  *
+  * @throws std::invalid_argument with message if they differ
+  */
+template <typename T, typename U>
+void check_same_shape(GridView<T> a, GridView<U> b, const char* message) {
+  if (a.rows() != b.rows() || a.cols() != b.cols()) {
+    throw std::invalid_argument(message);
+  }
+}
+} // namespace nucleusforce
+
+#endif // GRID_H
@@ -0,0 +1,43 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+namespace nucleusforce::kernels {
+/**
+  * @brief Set out[x] to 1 where in[x] == value and 0 elsewhere, for x in [0, n)
+  */
+void select_equal_row(const int* in, int n, int value, int* out);
+
+/**
+  * @brief Find the cell boundary on the interior columns [1, cols - 1) of an interior row
+  *
+  * A cell pixel (1) is on the boundary when its right, lower, left, upper, lower-right
+  * or upper-left neighbour is neither cell nor nucleus. Columns 0 and cols - 1 of out
+  * are not written.
+  *
+  * @param cell rows y - 1, y and y + 1 of the cell
+  * @param nucleus rows y - 1, y and y + 1 of the nucleus
+  * @param cols number of columns
+  * @param out row y of the boundary
+  */
+void boundary_row(const int* const cell[3], const int* const nucleus[3], int cols, int* out);
+
+/**
+  * @brief Add the net force of one row of nucleus pixels to (fx, fy)
+  *
+  * Every pixel x where nucleus[x] and force[x] are non-zero pulls towards the centroid
+  * (cx, cy) with magnitude force[x].
+  *
+  * @param nucleus row of the nucleus mask
+  * @param force row of the force on each pixel
+  * @param n number of columns
+  * @param y row index
+  * @param cx x coordinate of the centroid
+  * @param cy y coordinate of the centroid
+  * @param fx running x component of the net force
+  * @param fy running y component of the net force
+  */
+void accumulate_force_row(const int* nucleus, const double* force, int n, int y,
+                          double cx, double cy, double& fx, double& fy);
+} // namespace nucleusforce::kernels
+
+#endif // KERNELS_H
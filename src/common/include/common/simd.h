@@ -0,0 +1,37 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+namespace nucleusforce {
+/**
+  * @brief Instruction sets the vectorised kernels can use, from least to most capable
+  */
+enum class SimdLevel {
+  Scalar = 0, ///< Plain C++ loops
+  SSE41 = 1, ///< 128-bit SSE4.1
+  AVX2 = 2, ///< 256-bit AVX2
+};
+
+/**
+  * @brief Most capable instruction set supported by this CPU and build
+  */
+SimdLevel supported_simd_level();
+
+/**
+  * @brief Instruction set the kernels currently dispatch to
+  */
+SimdLevel simd_level();
+
+/**
+  * @brief Limit the kernels to an instruction set, e.g. to compare against the scalar code
+  *
+  * @param level requested level, lowered to supported_simd_level() if the CPU lacks it
+  */
+void set_simd_level(SimdLevel level);
+
+/**
+  * @brief Printable name of an instruction set
+  */
+const char* simd_level_name(SimdLevel level);
+} // namespace nucleusforce
+
+#endif // SIMD_H
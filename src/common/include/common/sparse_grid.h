@@ -0,0 +1,146 @@
+#ifndef SPARSE_GRID_H
+#define SPARSE_GRID_H
+
+#include <common/grid.h>
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+namespace nucleusforce {
+/**
+  * @brief One non-zero element of a SparseGrid
+  */
+template <typename T>
+struct SparseEntry {
+  int y = 0;
+  int x = 0;
+  T value = T();
+};
+
+/**
+  * @brief 2D array that stores only its non-zero elements, in compressed sparse row form
+  *
+  * The columns and values of row y are the elements row_offsets()[y] up to
+  * row_offsets()[y + 1] of columns() and values(), in increasing column order. Every
+  * element not stored is zero, so memory scales with the number of non-zero elements
+  * rather than with the area of the grid.
+  */
+template <typename T>
+class SparseGrid {
+public:
+  /**
+    * @brief Empty grid
+    */
+  SparseGrid() : row_offsets_(1, 0) {}
+
+  /**
+    * @brief Grid of rows x cols zeros
+    */
+  SparseGrid(int rows, int cols) : rows_(rows), cols_(cols), row_offsets_(static_cast<size_t>(rows) + 1, 0) {}
+
+  /**
+    * @brief Grid of rows x cols holding entries, which may be in any order
+    *
+    * @throws std::invalid_argument if an entry is outside the grid or two entries share a pixel
+    */
+  SparseGrid(int rows, int cols, std::vector<SparseEntry<T>> entries) : SparseGrid(rows, cols) {
+    std::sort(entries.begin(), entries.end(), [](const SparseEntry<T>& a, const SparseEntry<T>& b) {
+      return a.y != b.y ? a.y < b.y : a.x < b.x;
+    });
+    for (size_t i = 0; i < entries.size(); ++i) {
+      const SparseEntry<T>& entry = entries[i];
+      if (entry.y < 0 || entry.y >= rows || entry.x < 0 || entry.x >= cols) {
+        throw std::invalid_argument("Sparse entry is outside the grid.");
+      }
+      if (i > 0 && entry.y == entries[i - 1].y && entry.x == entries[i - 1].x) {
+        throw std::invalid_argument("Sparse entries must be at distinct pixels.");
+      }
+      if (entry.value == T()) continue;
+      row_offsets_[entry.y + 1]++;
+      columns_.push_back(entry.x);
+      values_.push_back(entry.value);
+    }
+    for (int y = 0; y < rows; ++y) {
+      row_offsets_[y + 1] += row_offsets_[y];
+    }
+  }
+
+  /**
+    * @brief Keep the non-zero elements of a dense array
+    */
+  static SparseGrid from_dense(GridView<const T> dense) {
+    SparseGrid grid(dense.rows(), dense.cols());
+    for (int y = 0; y < dense.rows(); ++y) {
+      const T* row = dense.row(y);
+      for (int x = 0; x < dense.cols(); ++x) {
+        if (row[x] != T()) {
+          grid.columns_.push_back(x);
+          grid.values_.push_back(row[x]);
+        }
+      }
+      grid.row_offsets_[y + 1] = grid.values_.size();
+    }
+    return grid;
+  }
+
+  /**
+    * @brief Copy into a dense array, with zero everywhere no element is stored
+    */
+  Grid<T> to_dense() const {
+    Grid<T> dense(rows_, cols_);
+    for (int y = 0; y < rows_; ++y) {
+      T* row = dense.row(y);
+      for (size_t i = row_offsets_[y]; i < row_offsets_[y + 1]; ++i) {
+        row[columns_[i]] = values_[i];
+      }
+    }
+    return dense;
+  }
+
+  /**
+    * @brief Coordinate list with one (y, x, value) row per stored element, in row-major order
+    *
+    * Meant for export, so written files also scale with the number of non-zero elements.
+    */
+  Grid<double> to_coordinates() const {
+    Grid<double> coordinates(static_cast<int>(values_.size()), 3);
+    for (int y = 0; y < rows_; ++y) {
+      for (size_t i = row_offsets_[y]; i < row_offsets_[y + 1]; ++i) {
+        double* row = coordinates.row(static_cast<int>(i));
+        row[0] = y;
+        row[1] = columns_[i];
+        row[2] = static_cast<double>(values_[i]);
+      }
+    }
+    return coordinates;
+  }
+
+  int rows() const { return rows_; }
+  int cols() const { return cols_; }
+
+  /**
+    * @brief Number of stored elements
+    */
+  size_t nonzeros() const { return values_.size(); }
+
+  const std::vector<size_t>& row_offsets() const { return row_offsets_; }
+  const std::vector<int>& columns() const { return columns_; }
+  const std::vector<T>& values() const { return values_; }
+
+  bool operator==(const SparseGrid& other) const {
+    return rows_ == other.rows_ && cols_ == other.cols_ && row_offsets_ == other.row_offsets_ &&
+           columns_ == other.columns_ && values_ == other.values_;
+  }
+  bool operator!=(const SparseGrid& other) const { return !(*this == other); }
+
+private:
+  int rows_ = 0;
+  int cols_ = 0;
+  std::vector<size_t> row_offsets_; ///< Start of each row in columns_ and values_, plus the end
+  std::vector<int> columns_; ///< Column of each stored element
+  std::vector<T> values_; ///< Value of each stored element
+}; // class SparseGrid
+} // namespace nucleusforce
+
+#endif // SPARSE_GRID_H
@@ -0,0 +1,68 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nucleusforce {
+/**
+  * @brief Fixed set of worker threads that split loops between themselves and the caller
+  */
+class ThreadPool {
+public:
+  /**
+    * @brief Start a pool
+    *
+    * @param threads total number of threads working on each loop, including the calling
+    *        thread. 0 uses one thread per hardware core.
+    */
+  explicit ThreadPool(unsigned threads = 0);
+
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /**
+    * @brief Number of threads working on each loop, including the calling thread
+    */
+  unsigned size() const { return static_cast<unsigned>(workers_.size()) + 1; }
+
+  /**
+    * @brief Run body over [begin, end) split into chunks of at least grain indices
+    *
+    * Blocks until every chunk is done. Ranges no larger than grain run on the calling
+    * thread. Calls must not be nested.
+    *
+    * @param body function called with the [chunk_begin, chunk_end) of each chunk
+    * @throws the first exception thrown by body, after every chunk already started has
+    *         finished. Chunks not yet started are skipped.
+    */
+  void parallel_for(int begin, int end, const std::function<void(int, int)>& body, int grain = 1024);
+
+private:
+  void worker_loop();
+  void run_chunks();
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  bool stop_ = false;
+  unsigned long generation_ = 0; ///< Incremented each time a loop is published
+  unsigned active_ = 0; ///< Workers still running chunks of the current loop
+
+  const std::function<void(int, int)>* body_ = nullptr;
+  int end_ = 0;
+  int chunk_ = 0;
+  std::atomic<int> next_{0}; ///< Start of the next unclaimed chunk
+  std::exception_ptr error_; ///< First exception thrown by body in the current loop
+}; // class ThreadPool
+} // namespace nucleusforce
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,142 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <chrono>
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace nucleusforce::trace {
+using Clock = std::chrono::steady_clock;
+
+/**
+  * @brief One timed stage
+  */
+struct Span {
+  std::string name;
+  double start_us = 0; ///< Microseconds since the first trace of the process started
+  double duration_us = 0;
+};
+
+/**
+  * @brief Timings and counters of the stages run while a Session was open, usually one frame
+  *
+  * Stages and counters are only recorded when the library is built with
+  * NUCLEUSFORCE_TRACE. Otherwise the NF_TRACE_* macros compile to nothing and every
+  * Trace stays empty.
+  */
+class Trace {
+public:
+  explicit Trace(std::string name = "") : name(std::move(name)) {}
+
+  std::string name; ///< Shown as the thread name in Chrome traces
+
+  void add_span(const char* stage, Clock::time_point start, Clock::time_point end);
+  void add_count(const char* counter, long long value) { counters_[counter] += value; }
+
+  const std::vector<Span>& spans() const { return spans_; }
+  const std::map<std::string, long long>& counters() const { return counters_; }
+
+  /**
+    * @brief JSON object with the total time and calls of each stage, every span and every counter
+    */
+  std::string to_json() const;
+
+private:
+  std::vector<Span> spans_;
+  std::map<std::string, long long> counters_;
+}; // class Trace
+
+/**
+  * @brief Record the stages run on this thread into trace until destroyed
+  *
+  * Sessions nest, restoring the previous trace when they end. Work that a stage hands
+  * to other threads is timed as part of the stage but its counters are not recorded.
+  */
+class Session {
+public:
+  explicit Session(Trace& trace);
+  ~Session();
+
+  Session(const Session&) = delete;
+  Session& operator=(const Session&) = delete;
+
+private:
+  Trace* previous_;
+}; // class Session
+
+/**
+  * @brief Trace of the current thread's open session, nullptr if there is none
+  */
+Trace* current();
+
+/**
+  * @brief Times a stage from construction to destruction into the current session
+  */
+class Scope {
+public:
+  explicit Scope(const char* stage) : trace_(current()), stage_(stage) {
+    if (trace_ != nullptr) start_ = Clock::now();
+  }
+  ~Scope() {
+    if (trace_ != nullptr) trace_->add_span(stage_, start_, Clock::now());
+  }
+
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+private:
+  Trace* trace_;
+  const char* stage_;
+  Clock::time_point start_;
+}; // class Scope
+
+/**
+  * @brief Add value to a counter of the current session
+  */
+inline void count(const char* counter, long long value) {
+  if (Trace* trace = current()) trace->add_count(counter, value);
+}
+
+/**
+  * @brief Add a stage that ran from start to end to the current session
+  */
+inline void span(const char* stage, Clock::time_point start, Clock::time_point end) {
+  if (Trace* trace = current()) trace->add_span(stage, start, end);
+}
+
+/**
+  * @brief Write traces in Chrome trace-event format, one thread per trace
+  *
+  * Spans become complete ("X") events and the counters of each trace one counter ("C")
+  * event at its end, so the output loads in chrome://tracing and Perfetto.
+  */
+void write_chrome_trace(std::ostream& out, const std::vector<const Trace*>& traces);
+
+/**
+  * @brief Write traces in Chrome trace-event format to filepath
+  *
+  * @throws std::runtime_error if the file cannot be opened
+  */
+void write_chrome_trace(const std::string& filepath, const std::vector<const Trace*>& traces);
+} // namespace nucleusforce::trace
+
+#define NF_TRACE_CONCAT_(a, b) a##b
+#define NF_TRACE_CONCAT(a, b) NF_TRACE_CONCAT_(a, b)
+
+#ifdef NUCLEUSFORCE_TRACE
+/// Time the rest of the enclosing block as stage
+#define NF_TRACE_SCOPE(stage) ::nucleusforce::trace::Scope NF_TRACE_CONCAT(nf_trace_scope_, __LINE__)(stage)
+/// Add value to counter
+#define NF_TRACE_COUNT(counter, value) ::nucleusforce::trace::count(counter, value)
+/// Record stage as having run from start to end, for work timed elsewhere
+#define NF_TRACE_SPAN(stage, start, end) ::nucleusforce::trace::span(stage, start, end)
+#else
+#define NF_TRACE_SCOPE(stage) static_cast<void>(0)
+#define NF_TRACE_COUNT(counter, value) static_cast<void>(0)
+#define NF_TRACE_SPAN(stage, start, end) static_cast<void>(0)
+#endif
+
+#endif // TRACE_H
@@ -0,0 +1,81 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nucleusforce {
+/**
+  * @brief Fixed set of worker threads that run independent tasks of uneven cost
+  *
+  * Each thread, including the caller, starts with its own queue of tasks and takes work
+  * from the front of it. A thread whose queue runs dry steals from the back of the
+  * others', so one expensive task does not leave the rest of the threads idle behind
+  * a static split. Tasks are expected to be coarse, such as one cell of an image, so
+  * each queue is guarded by a plain mutex.
+  */
+class WorkStealingPool {
+public:
+  /**
+    * @brief Start a pool
+    *
+    * @param threads total number of threads running tasks, including the calling thread.
+    *        0 uses one thread per hardware core.
+    */
+  explicit WorkStealingPool(unsigned threads = 0);
+
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  /**
+    * @brief Number of threads running tasks, including the calling thread
+    */
+  unsigned size() const { return static_cast<unsigned>(workers_.size()) + 1; }
+
+  /**
+    * @brief Run task(i) for every i in [0, count)
+    *
+    * Tasks are dealt to the threads in turn, so listing the most expensive tasks first
+    * spreads them between threads before any stealing is needed. Blocks until every
+    * task is done. Calls must not be nested.
+    *
+    * @throws the first exception thrown by a task, after every other task has finished
+    */
+  void run(int count, const std::function<void(int)>& task);
+
+private:
+  /**
+    * @brief Tasks dealt to one thread
+    */
+  struct Queue {
+    std::mutex mutex;
+    std::deque<int> tasks;
+  };
+
+  void worker_loop(unsigned self);
+  void run_tasks(unsigned self);
+  bool take(unsigned self, int& task);
+
+  std::vector<std::thread> workers_;
+  std::vector<std::unique_ptr<Queue>> queues_; ///< One per thread, the caller's first
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  bool stop_ = false;
+  unsigned long generation_ = 0; ///< Incremented each time a batch of tasks is published
+  unsigned active_ = 0; ///< Workers still running tasks of the current batch
+
+  const std::function<void(int)>* task_ = nullptr;
+  std::exception_ptr error_; ///< First exception thrown by a task of the current batch
+}; // class WorkStealingPool
+} // namespace nucleusforce
+
+#endif // WORK_STEALING_POOL_H
@@ -0,0 +1,210 @@
+#include <common/kernels.h>
+#include <common/simd.h>
+
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NUCLEUS_FORCE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace nucleusforce::kernels {
+// Scalar versions, also used for the leftover columns of the vector versions
+
+static void select_equal_row_scalar(const int* in, int begin, int n, int value, int* out) {
+  for (int x = begin; x < n; ++x) {
+    out[x] = in[x] == value;
+  }
+}
+
+static void boundary_row_scalar(const int* const cell[3], const int* const nucleus[3],
+                                int begin, int end, int* out) {
+  auto background = [&](int r, int x) { return cell[r][x] == 0 && nucleus[r][x] == 0; };
+  for (int x = begin; x < end; ++x) {
+    out[x] = cell[1][x] == 1 &&
+             (background(1, x + 1) || background(2, x) || background(1, x - 1) ||
+              background(0, x) || background(2, x + 1) || background(0, x - 1));
+  }
+}
+
+static void accumulate_force_row_scalar(const int* nucleus, const double* force, int begin, int n, int y,
+                                        double cx, double cy, double& fx, double& fy) {
+  for (int x = begin; x < n; ++x) {
+    if (nucleus[x] && force[x] != 0.0) {
+      double dy = cy - y;
+      double dx = cx - x;
+      double mag = std::sqrt(dy * dy + dx * dx);
+      fx += dx / mag * force[x];
+      fy += dy / mag * force[x];
+    }
+  }
+}
+
+#ifdef NUCLEUS_FORCE_X86_SIMD
+// SSE4.1 versions, 4 ints or 2 doubles at a time
+
+__attribute__((target("sse4.1")))
+static void select_equal_row_sse41(const int* in, int n, int value, int* out) {
+  const __m128i target = _mm_set1_epi32(value);
+  const __m128i one = _mm_set1_epi32(1);
+  int x = 0;
+  for (; x + 4 <= n; x += 4) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_and_si128(_mm_cmpeq_epi32(v, target), one));
+  }
+  select_equal_row_scalar(in, x, n, value, out);
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i background_sse41(const int* cell, const int* nucleus) {
+  __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cell));
+  __m128i n = _mm_loadu_si128(reinterpret_cast<const __m128i*>(nucleus));
+  return _mm_cmpeq_epi32(_mm_or_si128(c, n), _mm_setzero_si128());
+}
+
+__attribute__((target("sse4.1")))
+static void boundary_row_sse41(const int* const cell[3], const int* const nucleus[3], int cols, int* out) {
+  const __m128i one = _mm_set1_epi32(1);
+  int x = 1;
+  for (; x + 4 <= cols - 1; x += 4) {
+    __m128i edge = _mm_or_si128(
+      _mm_or_si128(background_sse41(cell[1] + x + 1, nucleus[1] + x + 1), background_sse41(cell[2] + x, nucleus[2] + x)),
+      _mm_or_si128(background_sse41(cell[1] + x - 1, nucleus[1] + x - 1), background_sse41(cell[0] + x, nucleus[0] + x)));
+    edge = _mm_or_si128(edge, _mm_or_si128(background_sse41(cell[2] + x + 1, nucleus[2] + x + 1),
+                                           background_sse41(cell[0] + x - 1, nucleus[0] + x - 1)));
+    __m128i is_cell = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(cell[1] + x)), one);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_and_si128(_mm_and_si128(edge, is_cell), one));
+  }
+  boundary_row_scalar(cell, nucleus, x, cols - 1, out);
+}
+
+__attribute__((target("sse4.1")))
+static void accumulate_force_row_sse41(const int* nucleus, const double* force, int n, int y,
+                                       double cx, double cy, double& fx, double& fy) {
+  const __m128d zero = _mm_setzero_pd();
+  const __m128d dy = _mm_set1_pd(cy - y);
+  const __m128d dy2 = _mm_mul_pd(dy, dy);
+  __m128d sum_x = _mm_setzero_pd();
+  __m128d sum_y = _mm_setzero_pd();
+  __m128d dx = _mm_set_pd(cx - 1, cx);
+  const __m128d step = _mm_set1_pd(2);
+  int x = 0;
+  for (; x + 2 <= n; x += 2, dx = _mm_sub_pd(dx, step)) {
+    __m128d f = _mm_loadu_pd(force + x);
+    __m128d has_force = _mm_cmpneq_pd(f, zero);
+    if (_mm_movemask_pd(has_force) == 0) continue;
+    __m128d in_nucleus = _mm_cvtepi32_pd(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(nucleus + x)));
+    __m128d active = _mm_and_pd(_mm_cmpneq_pd(in_nucleus, zero), has_force);
+    __m128d scale = _mm_div_pd(f, _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(dx, dx), dy2)));
+    sum_x = _mm_add_pd(sum_x, _mm_and_pd(_mm_mul_pd(dx, scale), active));
+    sum_y = _mm_add_pd(sum_y, _mm_and_pd(_mm_mul_pd(dy, scale), active));
+  }
+  double lanes_x[2], lanes_y[2];
+  _mm_storeu_pd(lanes_x, sum_x);
+  _mm_storeu_pd(lanes_y, sum_y);
+  fx += lanes_x[0] + lanes_x[1];
+  fy += lanes_y[0] + lanes_y[1];
+  accumulate_force_row_scalar(nucleus, force, x, n, y, cx, cy, fx, fy);
+}
+
+// AVX2 versions, 8 ints or 4 doubles at a time
+
+__attribute__((target("avx2")))
+static void select_equal_row_avx2(const int* in, int n, int value, int* out) {
+  const __m256i target = _mm256_set1_epi32(value);
+  const __m256i one = _mm256_set1_epi32(1);
+  int x = 0;
+  for (; x + 8 <= n; x += 8) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + x));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), _mm256_and_si256(_mm256_cmpeq_epi32(v, target), one));
+  }
+  select_equal_row_scalar(in, x, n, value, out);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i background_avx2(const int* cell, const int* nucleus) {
+  __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cell));
+  __m256i n = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(nucleus));
+  return _mm256_cmpeq_epi32(_mm256_or_si256(c, n), _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2")))
+static void boundary_row_avx2(const int* const cell[3], const int* const nucleus[3], int cols, int* out) {
+  const __m256i one = _mm256_set1_epi32(1);
+  int x = 1;
+  for (; x + 8 <= cols - 1; x += 8) {
+    __m256i edge = _mm256_or_si256(
+      _mm256_or_si256(background_avx2(cell[1] + x + 1, nucleus[1] + x + 1), background_avx2(cell[2] + x, nucleus[2] + x)),
+      _mm256_or_si256(background_avx2(cell[1] + x - 1, nucleus[1] + x - 1), background_avx2(cell[0] + x, nucleus[0] + x)));
+    edge = _mm256_or_si256(edge, _mm256_or_si256(background_avx2(cell[2] + x + 1, nucleus[2] + x + 1),
+                                                 background_avx2(cell[0] + x - 1, nucleus[0] + x - 1)));
+    __m256i is_cell = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(cell[1] + x)), one);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), _mm256_and_si256(_mm256_and_si256(edge, is_cell), one));
+  }
+  boundary_row_scalar(cell, nucleus, x, cols - 1, out);
+}
+
+__attribute__((target("avx2")))
+static void accumulate_force_row_avx2(const int* nucleus, const double* force, int n, int y,
+                                      double cx, double cy, double& fx, double& fy) {
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d dy = _mm256_set1_pd(cy - y);
+  const __m256d dy2 = _mm256_mul_pd(dy, dy);
+  __m256d sum_x = _mm256_setzero_pd();
+  __m256d sum_y = _mm256_setzero_pd();
+  __m256d dx = _mm256_set_pd(cx - 3, cx - 2, cx - 1, cx);
+  const __m256d step = _mm256_set1_pd(4);
+  int x = 0;
+  for (; x + 4 <= n; x += 4, dx = _mm256_sub_pd(dx, step)) {
+    __m256d f = _mm256_loadu_pd(force + x);
+    __m256d has_force = _mm256_cmp_pd(f, zero, _CMP_NEQ_UQ);
+    if (_mm256_movemask_pd(has_force) == 0) continue;
+    __m256d in_nucleus = _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(nucleus + x)));
+    __m256d active = _mm256_and_pd(_mm256_cmp_pd(in_nucleus, zero, _CMP_NEQ_UQ), has_force);
+    __m256d scale = _mm256_div_pd(f, _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), dy2)));
+    sum_x = _mm256_add_pd(sum_x, _mm256_and_pd(_mm256_mul_pd(dx, scale), active));
+    sum_y = _mm256_add_pd(sum_y, _mm256_and_pd(_mm256_mul_pd(dy, scale), active));
+  }
+  double lanes_x[4], lanes_y[4];
+  _mm256_storeu_pd(lanes_x, sum_x);
+  _mm256_storeu_pd(lanes_y, sum_y);
+  fx += (lanes_x[0] + lanes_x[1]) + (lanes_x[2] + lanes_x[3]);
+  fy += (lanes_y[0] + lanes_y[1]) + (lanes_y[2] + lanes_y[3]);
+  accumulate_force_row_scalar(nucleus, force, x, n, y, cx, cy, fx, fy);
+}
+#endif // NUCLEUS_FORCE_X86_SIMD
+
+void select_equal_row(const int* in, int n, int value, int* out) {
+#ifdef NUCLEUS_FORCE_X86_SIMD
+  switch (simd_level()) {
+    case SimdLevel::AVX2: select_equal_row_avx2(in, n, value, out); return;
+    case SimdLevel::SSE41: select_equal_row_sse41(in, n, value, out); return;
+    default: break;
+  }
+#endif
+  select_equal_row_scalar(in, 0, n, value, out);
+}
+
+void boundary_row(const int* const cell[3], const int* const nucleus[3], int cols, int* out) {
+#ifdef NUCLEUS_FORCE_X86_SIMD
+  switch (simd_level()) {
+    case SimdLevel::AVX2: boundary_row_avx2(cell, nucleus, cols, out); return;
+    case SimdLevel::SSE41: boundary_row_sse41(cell, nucleus, cols, out); return;
+    default: break;
+  }
+#endif
+  boundary_row_scalar(cell, nucleus, 1, cols - 1, out);
+}
+
+void accumulate_force_row(const int* nucleus, const double* force, int n, int y,
+                          double cx, double cy, double& fx, double& fy) {
+#ifdef NUCLEUS_FORCE_X86_SIMD
+  switch (simd_level()) {
+    case SimdLevel::AVX2: accumulate_force_row_avx2(nucleus, force, n, y, cx, cy, fx, fy); return;
+    case SimdLevel::SSE41: accumulate_force_row_sse41(nucleus, force, n, y, cx, cy, fx, fy); return;
+    default: break;
+  }
+#endif
+  accumulate_force_row_scalar(nucleus, force, 0, n, y, cx, cy, fx, fy);
+}
+} // namespace nucleusforce::kernels
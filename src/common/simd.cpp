@@ -0,0 +1,41 @@
+#include <common/simd.h>
+
+#include <algorithm>
+#include <atomic>
+
+namespace nucleusforce {
+static SimdLevel detect_simd_level() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+  if (__builtin_cpu_supports("sse4.1")) return SimdLevel::SSE41;
+#endif
+  return SimdLevel::Scalar;
+}
+
+static std::atomic<SimdLevel>& active_level() {
+  static std::atomic<SimdLevel> level(supported_simd_level());
+  return level;
+}
+
+SimdLevel supported_simd_level() {
+  static const SimdLevel level = detect_simd_level();
+  return level;
+}
+
+SimdLevel simd_level() {
+  return active_level().load(std::memory_order_relaxed);
+}
+
+void set_simd_level(SimdLevel level) {
+  active_level().store(std::min(level, supported_simd_level()), std::memory_order_relaxed);
+}
+
+const char* simd_level_name(SimdLevel level) {
+  switch (level) {
+    case SimdLevel::AVX2: return "avx2";
+    case SimdLevel::SSE41: return "sse4.1";
+    default: return "scalar";
+  }
+}
+} // namespace nucleusforce
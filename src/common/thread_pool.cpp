@@ -0,0 +1,91 @@
+#include <common/thread_pool.h>
+
+#include <algorithm>
+
+namespace nucleusforce {
+ThreadPool::ThreadPool(unsigned threads) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (unsigned i = 1; i < threads; ++i) {
+    workers_.emplace_back([this] { worker_loop(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  start_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::parallel_for(int begin, int end, const std::function<void(int, int)>& body, int grain) {
+  if (end <= begin) return;
+  if (workers_.empty() || end - begin <= grain) {
+    body(begin, end);
+    return;
+  }
+
+  // Several chunks per thread so uneven chunks still balance
+  int chunks = static_cast<int>(size()) * 4;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    body_ = &body;
+    end_ = end;
+    chunk_ = std::max(grain, (end - begin + chunks - 1) / chunks);
+    next_.store(begin);
+    active_ = static_cast<unsigned>(workers_.size());
+    ++generation_;
+  }
+  start_.notify_all();
+
+  run_chunks();
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return active_ == 0; });
+  body_ = nullptr;
+  if (error_) {
+    std::exception_ptr error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void ThreadPool::worker_loop() {
+  unsigned long seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_.wait(lock, [&] { return stop_ || generation_ != seen; });
+      if (stop_) return;
+      seen = generation_;
+    }
+
+    run_chunks();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--active_ == 0) {
+      done_.notify_one();
+    }
+  }
+}
+
+void ThreadPool::run_chunks() {
+  while (true) {
+    int chunk_begin = next_.fetch_add(chunk_);
+    if (chunk_begin >= end_) return;
+    try {
+      (*body_)(chunk_begin, std::min(end_, chunk_begin + chunk_));
+    } catch (...) {
+      // Leave the rest of the loop unclaimed so every thread stops after its current chunk
+      next_.store(end_);
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!error_) error_ = std::current_exception();
+    }
+  }
+}
+} // namespace nucleusforce
@@ -0,0 +1,138 @@
+#include <common/trace.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace nucleusforce::trace {
+static thread_local Trace* current_trace = nullptr;
+
+/**
+  * @brief Start of the first trace, so spans of every thread share one time axis
+  */
+static Clock::time_point epoch() {
+  static const Clock::time_point start = Clock::now();
+  return start;
+}
+
+Trace* current() {
+  return current_trace;
+}
+
+Session::Session(Trace& trace) : previous_(current_trace) {
+  epoch();
+  current_trace = &trace;
+}
+
+Session::~Session() {
+  current_trace = previous_;
+}
+
+void Trace::add_span(const char* stage, Clock::time_point start, Clock::time_point end) {
+  using Micros = std::chrono::duration<double, std::micro>;
+  spans_.push_back({stage, Micros(start - epoch()).count(), Micros(end - start).count()});
+}
+
+/**
+  * @brief Quote a JSON string, escaping quotes, backslashes and control characters
+  */
+static std::string quote_json(const std::string& text) {
+  std::ostringstream quoted;
+  quoted << '"';
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      quoted << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      quoted << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+    } else {
+      quoted << c;
+    }
+  }
+  quoted << '"';
+  return quoted.str();
+}
+
+std::string Trace::to_json() const {
+  struct Total {
+    long long calls = 0;
+    double us = 0;
+  };
+  std::map<std::string, Total> stages;
+  for (const Span& span : spans_) {
+    stages[span.name].calls++;
+    stages[span.name].us += span.duration_us;
+  }
+
+  std::ostringstream out;
+  out << std::setprecision(17);
+  out << "{\"name\":" << quote_json(name) << ",\"stages\":{";
+  bool first = true;
+  for (const auto& [stage, total] : stages) {
+    out << (first ? "" : ",") << quote_json(stage) << ":{\"calls\":" << total.calls << ",\"total_us\":" << total.us << "}";
+    first = false;
+  }
+  out << "},\"spans\":[";
+  first = true;
+  for (const Span& span : spans_) {
+    out << (first ? "" : ",") << "{\"name\":" << quote_json(span.name) << ",\"start_us\":" << span.start_us
+        << ",\"duration_us\":" << span.duration_us << "}";
+    first = false;
+  }
+  out << "],\"counters\":{";
+  first = true;
+  for (const auto& [counter, value] : counters_) {
+    out << (first ? "" : ",") << quote_json(counter) << ":" << value;
+    first = false;
+  }
+  out << "}}";
+  return out.str();
+}
+
+void write_chrome_trace(std::ostream& out, const std::vector<const Trace*>& traces) {
+  out << std::setprecision(17);
+  out << "{\"traceEvents\":[";
+  bool first = true;
+  auto separator = [&] {
+    out << (first ? "\n" : ",\n");
+    first = false;
+  };
+
+  for (size_t tid = 0; tid < traces.size(); ++tid) {
+    const Trace& trace = *traces[tid];
+    separator();
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+        << ",\"args\":{\"name\":" << quote_json(trace.name) << "}}";
+
+    double end = 0;
+    for (const Span& span : trace.spans()) {
+      separator();
+      out << "{\"name\":" << quote_json(span.name) << ",\"cat\":\"stage\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+          << ",\"ts\":" << span.start_us << ",\"dur\":" << span.duration_us << "}";
+      end = std::max(end, span.start_us + span.duration_us);
+    }
+
+    if (!trace.counters().empty()) {
+      separator();
+      out << "{\"name\":" << quote_json(trace.name) << ",\"ph\":\"C\",\"pid\":1,\"tid\":" << tid
+          << ",\"ts\":" << end << ",\"args\":{";
+      bool first_counter = true;
+      for (const auto& [counter, value] : trace.counters()) {
+        out << (first_counter ? "" : ",") << quote_json(counter) << ":" << value;
+        first_counter = false;
+      }
+      out << "}}";
+    }
+  }
+  out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+void write_chrome_trace(const std::string& filepath, const std::vector<const Trace*>& traces) {
+  std::ofstream file(filepath);
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open file for writing: " + filepath);
+  }
+  write_chrome_trace(file, traces);
+}
+} // namespace nucleusforce::trace
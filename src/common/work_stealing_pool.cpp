@@ -0,0 +1,116 @@
+#include <common/work_stealing_pool.h>
+
+#include <algorithm>
+
+namespace nucleusforce {
+WorkStealingPool::WorkStealingPool(unsigned threads) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (unsigned i = 0; i < threads; ++i) {
+    queues_.push_back(std::make_unique<Queue>());
+  }
+  for (unsigned i = 1; i < threads; ++i) {
+    workers_.emplace_back([this, i] { worker_loop(i); });
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  start_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+void WorkStealingPool::run(int count, const std::function<void(int)>& task) {
+  if (count <= 0) return;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int i = 0; i < count; ++i) {
+      Queue& queue = *queues_[i % queues_.size()];
+      std::lock_guard<std::mutex> queue_lock(queue.mutex);
+      queue.tasks.push_back(i);
+    }
+    task_ = &task;
+    error_ = nullptr;
+    active_ = static_cast<unsigned>(workers_.size());
+    ++generation_;
+  }
+  start_.notify_all();
+
+  run_tasks(0);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return active_ == 0; });
+  task_ = nullptr;
+  if (error_) {
+    std::exception_ptr error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void WorkStealingPool::worker_loop(unsigned self) {
+  unsigned long seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_.wait(lock, [&] { return stop_ || generation_ != seen; });
+      if (stop_) return;
+      seen = generation_;
+    }
+
+    run_tasks(self);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--active_ == 0) {
+      done_.notify_one();
+    }
+  }
+}
+
+void WorkStealingPool::run_tasks(unsigned self) {
+  int task;
+  while (take(self, task)) {
+    try {
+      (*task_)(task);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!error_) error_ = std::current_exception();
+    }
+  }
+}
+
+/**
+  * @brief Take the next task of this thread, or steal the last task of another
+  *
+  * Tasks are only ever removed once a batch is published, so a thread that finds every
+  * queue empty can stop.
+  */
+bool WorkStealingPool::take(unsigned self, int& task) {
+  {
+    Queue& own = *queues_[self];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task = own.tasks.front();
+      own.tasks.pop_front();
+      return true;
+    }
+  }
+  for (size_t k = 1; k < queues_.size(); ++k) {
+    Queue& victim = *queues_[(self + k) % queues_.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      task = victim.tasks.back();
+      victim.tasks.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+} // namespace nucleusforce
@@ -1,26 +1,122 @@
 #include <image/image_parse.h>
 
+#include <common/kernels.h>
+#include <common/trace.h>
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
 #include <unordered_map>
 #include <vector>
 
 namespace nucleusforce::image {
-std::vector<std::vector<int>> isolate_color(ColorMap cm, cv::Vec3b color) {
-  std::vector<std::vector<int>> complete_map = cm.get_color_map();
-  std::vector<std::vector<int>> isolated_map(complete_map.size(), 
-                                             std::vector<int>(complete_map[0].size(), 0));
-  const std::unordered_map<cv::Vec3b, int> color_mapping = cm.get_color_mapping();
-  auto color_it = color_mapping.find(color);
-  if (color_it == color_mapping.end()) {
-    return isolated_map;
+/**
+  * @brief Number of each color in the color map, or nothing for colors it does not contain
+  */
+static std::vector<std::optional<int>> color_numbers(const ColorMap& cm, const std::vector<cv::Vec3b>& colors) {
+  const std::unordered_map<cv::Vec3b, int>& color_mapping = cm.get_color_mapping();
+  std::vector<std::optional<int>> numbers;
+  for (cv::Vec3b color : colors) {
+    auto color_it = color_mapping.find(color);
+    numbers.push_back(color_it == color_mapping.end() ? std::nullopt : std::optional<int>(color_it->second));
   }
-  int target_color = color_it->second;
+  return numbers;
+}
+
+std::vector<Grid<int>> isolate_colors(const ColorMap& cm, const std::vector<cv::Vec3b>& colors) {
+  const Grid<int>& complete_map = cm.get_color_grid();
+  return isolate_colors(cm, colors, Region{0, 0, complete_map.rows(), complete_map.cols()});
+}
+
+std::vector<Grid<int>> isolate_colors(const ColorMap& cm, const std::vector<cv::Vec3b>& colors, const Region& region) {
+  NF_TRACE_SCOPE("isolate_colors");
+  GridView<const int> complete_map = cm.get_color_grid().view().subview(region);
+  std::vector<std::optional<int>> numbers = color_numbers(cm, colors);
+  std::vector<Grid<int>> isolated_maps(colors.size(), Grid<int>(region.rows, region.cols, 0));
+
+  for (int y = 0; y < complete_map.rows(); ++y) {
+    const int* in = complete_map.row(y);
+    for (size_t i = 0; i < colors.size(); ++i) {
+      if (numbers[i]) {
+        kernels::select_equal_row(in, complete_map.cols(), *numbers[i], isolated_maps[i].row(y));
+      }
+    }
+  }
+
+  return isolated_maps;
+}
+
+Region find_colors_bounding_box(const ColorMap& cm, const std::vector<cv::Vec3b>& colors, int halo) {
+  NF_TRACE_SCOPE("find_colors_bounding_box");
+  if (halo < 0) {
+    throw std::invalid_argument("Bounding box halo must not be negative.");
+  }
+  const Grid<int>& complete_map = cm.get_color_grid();
+  std::vector<int> numbers;
+  for (const std::optional<int>& number : color_numbers(cm, colors)) {
+    if (number) numbers.push_back(*number);
+  }
+  auto wanted = [&](int label) { return std::find(numbers.begin(), numbers.end(), label) != numbers.end(); };
 
-  for (int y = 0; y < complete_map.size(); ++y) {
-    for (int x = 0; x < complete_map[0].size(); ++x) {
-      isolated_map[y][x] = complete_map[y][x] == target_color;
+  const int cols = complete_map.cols();
+  int top = complete_map.rows();
+  int bottom = -1;
+  int left = cols;
+  int right = -1;
+  for (int y = 0; y < complete_map.rows(); ++y) {
+    const int* in = complete_map.row(y);
+    // Only the ends of each row can move the box sideways
+    int first = 0;
+    while (first < cols && !wanted(in[first])) ++first;
+    if (first == cols) continue;
+    int last = cols - 1;
+    while (!wanted(in[last])) --last;
+
+    top = std::min(top, y);
+    bottom = y;
+    left = std::min(left, first);
+    right = std::max(right, last);
+  }
+  if (bottom < 0) return Region();
+
+  return grow_region(top, bottom, left, right, halo, complete_map.rows(), cols);
+}
+
+std::vector<BitMask> isolate_color_masks(const ColorMap& cm, const std::vector<cv::Vec3b>& colors) {
+  NF_TRACE_SCOPE("isolate_colors");
+  const Grid<int>& complete_map = cm.get_color_grid();
+  std::vector<std::optional<int>> numbers = color_numbers(cm, colors);
+  std::vector<BitMask> masks(colors.size(), BitMask(complete_map.rows(), complete_map.cols()));
+  const int words = masks.empty() ? 0 : masks[0].words_per_row();
+
+  for (int y = 0; y < complete_map.rows(); ++y) {
+    const int* in = complete_map.row(y);
+    for (int w = 0; w < words; ++w) {
+      int begin = w * 64;
+      int end = std::min(begin + 64, complete_map.cols());
+      for (size_t i = 0; i < colors.size(); ++i) {
+        if (!numbers[i]) continue;
+        uint64_t word = 0;
+        for (int x = begin; x < end; ++x) {
+          word |= uint64_t(in[x] == *numbers[i]) << (x - begin);
+        }
+        masks[i].row(y)[w] = word;
+      }
     }
   }
 
-  return isolated_map;
+  return masks;
+}
+
+Grid<int> isolate_color_grid(const ColorMap& cm, cv::Vec3b color) {
+  return std::move(isolate_colors(cm, {color})[0]);
+}
+
+BitMask isolate_color_mask(const ColorMap& cm, cv::Vec3b color) {
+  return std::move(isolate_color_masks(cm, {color})[0]);
+}
+
+std::vector<std::vector<int>> isolate_color(const ColorMap& cm, cv::Vec3b color) {
+  return isolate_color_grid(cm, color).to_vector();
 }
 }
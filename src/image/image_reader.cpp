@@ -1,14 +1,170 @@
 #include <image/image_reader.h>
 
+#include <common/thread_pool.h>
+#include <common/trace.h>
 #include <opencv2/core/matx.hpp>
 #include <opencv2/opencv.hpp>
 #include <opencv2/core.hpp>
 #include <opencv2/imgcodecs.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <stdexcept>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace nucleusforce::image {
+/**
+  * @brief Pack a BGR pixel into a 24-bit number
+  */
+static inline uint32_t pack_bgr(const uchar* pixel) {
+  return uint32_t(pixel[0]) | (uint32_t(pixel[1]) << 8) | (uint32_t(pixel[2]) << 16);
+}
+
+static cv::Vec3b unpack_bgr(uint32_t key) {
+  return cv::Vec3b(key & 0xff, (key >> 8) & 0xff, (key >> 16) & 0xff);
+}
+
+/**
+  * @brief Open-addressing hash table from packed BGR colors to numbers
+  *
+  * Images rarely have more than a handful of colors, so the table stays small enough
+  * to live in cache.
+  */
+class PaletteTable {
+public:
+  static constexpr uint32_t empty_key = 0xffffffff; ///< Never a packed 24-bit color
+
+  PaletteTable() : keys_(16, empty_key), values_(16) {}
+
+  /**
+    * @brief Table of the colors of a color mapping
+    */
+  explicit PaletteTable(const std::unordered_map<cv::Vec3b, int>& color_mapping) : PaletteTable() {
+    for (const auto& color : color_mapping) {
+      uint32_t key = uint32_t(color.first[0]) | (uint32_t(color.first[1]) << 8) |
+                     (uint32_t(color.first[2]) << 16);
+      insert(key, color.second);
+    }
+  }
+
+  /**
+    * @brief Look up key, setting value if it is in the table
+    */
+  bool find(uint32_t key, int& value) const {
+    for (size_t i = slot(key);; i = (i + 1) & (keys_.size() - 1)) {
+      if (keys_[i] == key) {
+        value = values_[i];
+        return true;
+      }
+      if (keys_[i] == empty_key) return false;
+    }
+  }
+
+  /**
+    * @brief Add key, which must not be in the table yet
+    */
+  void insert(uint32_t key, int value) {
+    if ((size_ + 1) * 2 > keys_.size()) grow();
+    size_t i = slot(key);
+    while (keys_[i] != empty_key) i = (i + 1) & (keys_.size() - 1);
+    keys_[i] = key;
+    values_[i] = value;
+    size_++;
+  }
+
+private:
+  size_t slot(uint32_t key) const {
+    // Fibonacci hashing, so nearby colors spread over the table
+    return static_cast<size_t>((uint64_t(key) * 0x9e3779b97f4a7c15ull) >> 40) & (keys_.size() - 1);
+  }
+
+  void grow() {
+    std::vector<uint32_t> keys = std::move(keys_);
+    std::vector<int> values = std::move(values_);
+    keys_.assign(keys.size() * 2, empty_key);
+    values_.assign(keys.size() * 2, 0);
+    size_ = 0;
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (keys[i] != empty_key) insert(keys[i], values[i]);
+    }
+  }
+
+  std::vector<uint32_t> keys_;
+  std::vector<int> values_;
+  size_t size_ = 0;
+};
+
+/**
+  * @brief Check that image is a non-empty 8-bit BGR image
+  */
+static void check_image(const cv::Mat& image, const std::string& source) {
+  if (image.empty()) {
+    throw std::invalid_argument("Could not load an empty image from: " + source);
+  }
+  if (image.type() != CV_8UC3) {
+    throw std::invalid_argument("Image must be 8-bit BGR: " + source);
+  }
+}
+
+/**
+  * @brief Invert a color mapping
+  *
+  * @throws std::invalid_argument if two colors map to the same number
+  */
+static std::unordered_map<int, cv::Vec3b> index_colors(const std::unordered_map<cv::Vec3b, int>& color_mapping) {
+  std::unordered_map<int, cv::Vec3b> color_index;
+  for (auto color : color_mapping) {
+    if (color_index.find(color.second) != color_index.end()) {
+      throw std::invalid_argument("color_mapping cannot contain any repeated numbers");
+    }
+    color_index[color.second] = color.first;
+  }
+  return color_index;
+}
+
+/**
+  * @brief Number every pixel of image with table, splitting the rows across pool
+  *
+  * @throws std::invalid_argument naming the first pixel, in row-major order, whose color is not in table
+  */
+static void map_colors(const cv::Mat& image, const PaletteTable& table, Grid<int>& color_map, ThreadPool& pool) {
+  const long long no_missing = static_cast<long long>(image.rows) * image.cols;
+  std::atomic<long long> first_missing{no_missing};
+
+  pool.parallel_for(0, image.rows, [&](int begin, int end) {
+    // Neighbouring pixels usually share a color
+    uint32_t last = PaletteTable::empty_key;
+    int last_value = 0;
+    for (int y = begin; y < end; ++y) {
+      const uchar* pixel = image.ptr<uchar>(y);
+      int* out = color_map.row(y);
+      for (int x = 0; x < image.cols; ++x, pixel += 3) {
+        uint32_t key = pack_bgr(pixel);
+        if (key != last) {
+          if (!table.find(key, last_value)) {
+            long long missing = static_cast<long long>(y) * image.cols + x;
+            long long current = first_missing.load();
+            while (missing < current && !first_missing.compare_exchange_weak(current, missing)) {}
+            return;
+          }
+          last = key;
+        }
+        out[x] = last_value;
+      }
+    }
+  }, 16);
+
+  if (first_missing.load() != no_missing) {
+    int y = static_cast<int>(first_missing.load() / image.cols);
+    int x = static_cast<int>(first_missing.load() % image.cols);
+    cv::Vec3b color = image.at<cv::Vec3b>(y, x);
+    throw std::invalid_argument("Missing color: (" + std::to_string(color[0]) + "," +
+                                std::to_string(color[1]) + "," + std::to_string(color[2]) + ")");
+  }
+}
+
 ColorMap::ColorMap() {
   return;
 }
@@ -26,86 +182,148 @@ void ColorMap::load(const std::string& filepath) {
   if (image.empty()) {
     throw std::invalid_argument("Could not load the image at: " + filepath);
   }
+  load(image, filepath);
+}
+
+void ColorMap::load(const cv::Mat& image, const std::string& source) {
+  NF_TRACE_SCOPE("ColorMap::load");
+  check_image(image, source);
 
-  // Create color map
-  std::vector<std::vector<int>> color_map(image.rows,
-                                          std::vector<int>(image.cols));
+  ThreadPool pool(threads_);
+  const int rows = image.rows;
+
+  // Distinct colors of each block of rows in order of first appearance. Merging the
+  // blocks in order numbers the colors by their first appearance in the whole image.
+  const int blocks = std::max(1, std::min(rows, static_cast<int>(pool.size()) * 4));
+  std::vector<std::vector<uint32_t>> block_colors(blocks);
+  pool.parallel_for(0, blocks, [&](int b_begin, int b_end) {
+    for (int b = b_begin; b < b_end; ++b) {
+      PaletteTable seen;
+      uint32_t last = PaletteTable::empty_key;
+      int unused;
+      for (int y = rows * b / blocks; y < rows * (b + 1) / blocks; ++y) {
+        const uchar* pixel = image.ptr<uchar>(y);
+        for (int x = 0; x < image.cols; ++x, pixel += 3) {
+          uint32_t key = pack_bgr(pixel);
+          if (key == last) continue;
+          last = key;
+          if (!seen.find(key, unused)) {
+            seen.insert(key, 0);
+            block_colors[b].push_back(key);
+          }
+        }
+      }
+    }
+  }, 1);
+
+  PaletteTable table;
   std::unordered_map<int, cv::Vec3b> color_index;
   std::unordered_map<cv::Vec3b, int> color_mapping;
-
   int index = 0;
-  for (int y = 0; y < image.rows; ++y) {
-    for (int x = 0; x < image.cols; ++x) {
-      cv::Vec3b color = image.at<cv::Vec3b>(y, x);
-      if (color_mapping.find(color) == color_mapping.end()) {
-        color_index[index++] = color;
-        color_mapping[color] = color_index.size() - 1;
-      }
-      color_map[y][x] = color_mapping[color];
+  int unused;
+  for (const std::vector<uint32_t>& colors : block_colors) {
+    for (uint32_t key : colors) {
+      if (table.find(key, unused)) continue;
+      table.insert(key, index);
+      color_index[index] = unpack_bgr(key);
+      color_mapping[unpack_bgr(key)] = index;
+      index++;
     }
   }
 
+  Grid<int> color_map(image.rows, image.cols);
+  map_colors(image, table, color_map, pool);
+
   // Assign color map to variables
-  filepath_ = filepath;
+  filepath_ = source;
   image_ = image;
-  color_map_ = color_map;
+  color_map_ = std::move(color_map);
   color_index_ = color_index;
   color_mapping_ = color_mapping;
 }
 
 void ColorMap::load(const std::string& filepath, const std::unordered_map<cv::Vec3b, int> &color_mapping) {
-  load(filepath);
-  recolor(color_mapping);
+  cv::Mat image = cv::imread(filepath, cv::IMREAD_COLOR);
+  if (image.empty()) {
+    throw std::invalid_argument("Could not load the image at: " + filepath);
+  }
+  load(image, filepath, color_mapping);
+}
+
+void ColorMap::load(const cv::Mat& image, const std::string& source,
+                    const std::unordered_map<cv::Vec3b, int> &color_mapping) {
+  NF_TRACE_SCOPE("ColorMap::load");
+  check_image(image, source);
+
+  // Number the pixels with the given mapping directly rather than discovering the
+  // colors and then recoloring
+  std::unordered_map<int, cv::Vec3b> color_index = index_colors(color_mapping);
+  PaletteTable table(color_mapping);
+  ThreadPool pool(threads_);
+  Grid<int> color_map(image.rows, image.cols);
+  map_colors(image, table, color_map, pool);
+
+  filepath_ = source;
+  image_ = image;
+  color_map_ = std::move(color_map);
+  color_index_ = std::move(color_index);
+  color_mapping_ = color_mapping;
 }
 
 void ColorMap::recolor(const std::unordered_map<cv::Vec3b, int> color_mapping) {
+  NF_TRACE_SCOPE("ColorMap::recolor");
   if (image_.empty()) {
     throw std::invalid_argument("Image must be loaded before recoloring color map");
   }
 
-  std::unordered_map<int, cv::Vec3b> color_index;
-  for (auto color : color_mapping) {
-    if (color_index.find(color.second) != color_index.end()) {
-      throw std::invalid_argument("color_mapping cannot contain any repeated numbers");
-    }
-    color_index[color.second] = color.first;
-  }
-
-  std::vector<std::vector<int>> color_map(image_.rows,
-                                          std::vector<int>(image_.cols));
-  for (int y = 0; y < image_.rows; ++y) {
-    for (int x = 0; x < image_.cols; ++x) {
-      cv::Vec3b color = image_.at<cv::Vec3b>(y, x);
-      auto it = color_mapping.find(color);
-      if (it == color_mapping.end()) {
-        throw std::invalid_argument("Missing color: (" + std::to_string(color[0]) + "," +
-                                    std::to_string(color[1]) + "," + std::to_string(color[2]) + ")");
-      }
-      color_map[y][x] = it->second;
-    }
-  }
+  std::unordered_map<int, cv::Vec3b> color_index = index_colors(color_mapping);
+  PaletteTable table(color_mapping);
+  ThreadPool pool(threads_);
+  Grid<int> color_map(image_.rows, image_.cols);
+  map_colors(image_, table, color_map, pool);
 
   color_mapping_ = color_mapping;
-  color_map_ = color_map;
-  color_index_ = color_index;
+  color_map_ = std::move(color_map);
+  color_index_ = std::move(color_index);
+}
+
+void ColorMap::set_threads(unsigned threads) {
+  threads_ = threads;
+}
+
+const std::vector<std::vector<int>> ColorMap::get_color_map() const {
+  if (image_.empty()) {
+    throw std::invalid_argument("Image must be loaded before getting color map.");
+  }
+  return color_map_.to_vector();
 }
 
-const std::vector<std::vector<int>> ColorMap::get_color_map() {
-  if (filepath_.empty()) {
+const Grid<int>& ColorMap::get_color_grid() const {
+  if (image_.empty()) {
     throw std::invalid_argument("Image must be loaded before getting color map.");
   }
   return color_map_;
 }
 
-const std::unordered_map<int, cv::Vec3b> ColorMap::get_color_index() {
-  if (filepath_.empty()) {
+GridView<const int> ColorMap::get_color_view() const {
+  return get_color_grid().view();
+}
+
+cv::Mat ColorMap::get_label_mat() const {
+  const Grid<int>& color_map = get_color_grid();
+  // Copy so that writing to the matrix cannot change a ColorMap other threads may be reading
+  return cv::Mat(color_map.rows(), color_map.cols(), CV_32S, const_cast<int*>(color_map.data())).clone();
+}
+
+const std::unordered_map<int, cv::Vec3b>& ColorMap::get_color_index() const {
+  if (image_.empty()) {
     throw std::invalid_argument("Image must be loaded before getting color mapping.");
   }
   return color_index_;
 }
 
-const std::unordered_map<cv::Vec3b, int> ColorMap::get_color_mapping() {
-  if (filepath_.empty()) {
+const std::unordered_map<cv::Vec3b, int>& ColorMap::get_color_mapping() const {
+  if (image_.empty()) {
     throw std::invalid_argument("Image must be loaded before getting color mapping.");
   }
   return color_mapping_;
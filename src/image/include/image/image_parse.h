@@ -1,18 +1,73 @@
 #ifndef IMAGE_PARSE_H
 #define IMAGE_PARSE_H
 
+#include <common/bit_mask.h>
+#include <common/grid.h>
 #include <image/image_reader.h>
 #include <opencv2/core.hpp>
 #include <vector>
 
 namespace nucleusforce::image {
+/**
+  * @brief Isolates a single color in the color map
+  *
+  * @return 2D grid where the target color is filled with 1 and everything else is 0
+  */
+Grid<int> isolate_color_grid(const ColorMap& cm, cv::Vec3b color);
+
+/**
+  * @brief Isolates a single color in the color map as a packed mask
+  *
+  * @return mask where the pixels of the target color are set
+  */
+BitMask isolate_color_mask(const ColorMap& cm, cv::Vec3b color);
+
 /**
   * @brief Isolates a single color in the color map
   *
   * @return 2D array (vector of vectors) where the target color is filled
   *         with 1 and everything else is 0
   */
-std::vector<std::vector<int>> isolate_color(ColorMap cm, cv::Vec3b color);
+std::vector<std::vector<int>> isolate_color(const ColorMap& cm, cv::Vec3b color);
+
+/**
+  * @brief Isolates several colors in the color map with a single pass over it
+  *
+  * Each row of the color map is compared against every color while it is still in
+  * cache, so extracting the cell and nucleus together costs about as much as
+  * extracting one of them.
+  *
+  * @return one 2D grid per color, in the order given, where the pixels of that color
+  *         are filled with 1 and everything else is 0
+  */
+std::vector<Grid<int>> isolate_colors(const ColorMap& cm, const std::vector<cv::Vec3b>& colors);
+
+/**
+  * @brief Isolates several colors in one region of the color map with a single pass over it
+  *
+  * @return one 2D grid the size of region per color, in the order given, where the
+  *         pixels of that color are filled with 1 and everything else is 0
+  * @throws std::out_of_range if region is not inside the color map
+  */
+std::vector<Grid<int>> isolate_colors(const ColorMap& cm, const std::vector<cv::Vec3b>& colors, const Region& region);
+
+/**
+  * @brief Finds the smallest region of the color map holding any of the colors, grown by halo pixels on every side
+  *
+  * Isolating the cell and nucleus colors in this region with a halo of 1 gives masks
+  * that find_bounding_box would cut to the same region, without allocating full-size
+  * masks first.
+  *
+  * @return region clipped to the color map, empty if none of the colors is present
+  */
+Region find_colors_bounding_box(const ColorMap& cm, const std::vector<cv::Vec3b>& colors, int halo = 1);
+
+/**
+  * @brief Isolates several colors in the color map as packed masks with a single pass over it
+  *
+  * @return one mask per color, in the order given, where the pixels of that color are set
+  */
+std::vector<BitMask> isolate_color_masks(const ColorMap& cm, const std::vector<cv::Vec3b>& colors);
 }
 
 #endif
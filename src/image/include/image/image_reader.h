@@ -1,6 +1,8 @@
 #ifndef IMAGE_READER_H
 #define IMAGE_READER_H
 
+#include <common/grid.h>
+#include <cstdint>
 #include <string>
 #include <opencv2/opencv.hpp>
 #include <unordered_map>
@@ -9,11 +11,13 @@
 namespace std {
   /**
    * @brief Implementation of hash code for cv::Vec3b object
+   *
+   * The three channels are packed into one 24-bit number, so distinct colors never share a hash.
    */
   template <>
   struct hash<cv::Vec3b> {
     size_t operator()(const cv::Vec3b& color) const {
-      return (hash<int>()(color[0]) ^ (hash<int>()(color[1]) << 1) ^ (hash<int>()(color[2]) << 2));
+      return hash<uint32_t>()(uint32_t(color[0]) | (uint32_t(color[1]) << 8) | (uint32_t(color[2]) << 16));
     }
   };
 }
@@ -21,6 +25,12 @@ namespace std {
 namespace nucleusforce::image {
 /**
   * @brief A class that converts a png image to a 2D color map.
+  *
+  * The numbers of all pixels are kept in one contiguous buffer. Apart from
+  * get_color_map and get_label_mat, which return copies, the const accessors return
+  * references or views into it without copying. None of them modify the ColorMap,
+  * so one loaded ColorMap can be read by any number of threads at once, as long as
+  * none of them calls load, recolor or set_threads at the same time.
   */
 class ColorMap {
 public:
@@ -61,25 +71,66 @@ public:
   void load(const std::string& filepath, const std::unordered_map<cv::Vec3b, int> &color_mapping);
 
   /**
-    * @brief Get the color map associated with the image
+    * @brief Load ColorMap from an image that is already decoded, such as a page of a multi-page TIFF
+    *
+    * @param image 8-bit BGR image, kept by reference like an image read from a file
+    * @param source name of where the image came from, used in error messages
+    */
+  void load(const cv::Mat& image, const std::string& source);
+
+  /**
+    * @brief Load ColorMap from an image that is already decoded
+    *
+    * @param image 8-bit BGR image
+    * @param source name of where the image came from, used in error messages
+    * @param color_mapping unordered_map containing all of the numbers that each color should map to
+    */
+  void load(const cv::Mat& image, const std::string& source,
+            const std::unordered_map<cv::Vec3b, int> &color_mapping);
+
+  /**
+    * @brief Get a copy of the color map associated with the image
     *
     * @return vector of vectors (2D array) with each color
     */
-  const std::vector<std::vector<int>> get_color_map();
+  const std::vector<std::vector<int>> get_color_map() const;
+
+  /**
+    * @brief Get a read-only view of the color map associated with the image
+    *
+    * @return view of the contiguous 2D array with each color, valid until the next load or recolor
+    */
+  GridView<const int> get_color_view() const;
+
+  /**
+    * @brief Get a copy of the color map as an OpenCV matrix
+    *
+    * Use get_color_view to read the color map without copying it.
+    *
+    * @return CV_32S matrix with each color, owning its own buffer
+    */
+  cv::Mat get_label_mat() const;
+
+  /**
+    * @brief Get the color map associated with the image without copying it
+    *
+    * @return contiguous 2D grid with each color
+    */
+  const Grid<int>& get_color_grid() const;
 
   /**
     * @brief Get the color mapping (int to color)
     *
     * @return vector of cv::Vec3b of which color each number represents
     */
-  const std::unordered_map<int, cv::Vec3b> get_color_index();
+  const std::unordered_map<int, cv::Vec3b>& get_color_index() const;
 
   /**
     * @brief Get the color mapping (int to color)
     *
     * @return unordered map mapping colors to their respective numbers
     */
-  const std::unordered_map<cv::Vec3b, int> get_color_mapping();
+  const std::unordered_map<cv::Vec3b, int>& get_color_mapping() const;
 
   /**
     * @brief recolor the color map with the provided color_mapping
@@ -88,12 +139,20 @@ public:
     */
   void recolor(const std::unordered_map<cv::Vec3b, int> color_mapping);
 
+  /**
+    * @brief Set the number of threads that decode the rows of each image
+    *
+    * @param threads number of threads, 0 for one per hardware core
+    */
+  void set_threads(unsigned threads);
+
 private:
-  std::string filepath_; ///< Path to the input image file
+  std::string filepath_; ///< Path to the input image file, or a description of where the image came from
   cv::Mat image_; ///< OpenCV matrix storing the image
-  std::vector<std::vector<int>> color_map_; ///< 2D int array storing each type of pixel
+  Grid<int> color_map_; ///< 2D int array storing each type of pixel
   std::unordered_map<int, cv::Vec3b> color_index_; ///< Mappings from int in array to BGR color
   std::unordered_map<cv::Vec3b, int> color_mapping_; ///< int number associated with each color
+  unsigned threads_ = 1; ///< Threads that decode the rows of each image
 }; // Class ColorMap
 } // namespace img
 
@@ -0,0 +1,150 @@
+#include <nucleus_force/cells.h>
+
+#include <common/work_stealing_pool.h>
+#include <algorithm>
+#include <numeric>
+#include <optional>
+#include <queue>
+#include <utility>
+
+namespace nucleusforce {
+const int dy[4] = {0, 1, 0, -1};
+const int dx[4] = {1, 0, -1, 0};
+
+Labels label_components(GridView<const int> mask) {
+  const int rows = mask.rows();
+  const int cols = mask.cols();
+  Labels labels{Grid<int>(rows, cols, 0), 0};
+  std::vector<int> stack;
+
+  for (int y = 0; y < rows; ++y) {
+    for (int x = 0; x < cols; ++x) {
+      if (mask(y, x) == 0 || labels.grid(y, x) != 0) continue;
+
+      const int label = ++labels.count;
+      labels.grid(y, x) = label;
+      stack.push_back(y * cols + x);
+      while (!stack.empty()) {
+        int py = stack.back() / cols;
+        int px = stack.back() % cols;
+        stack.pop_back();
+        for (int i = 0; i < 4; ++i) {
+          int ny = py + dy[i];
+          int nx = px + dx[i];
+          if (ny < 0 || ny >= rows || nx < 0 || nx >= cols || mask(ny, nx) == 0 || labels.grid(ny, nx) != 0) {
+            continue;
+          }
+          labels.grid(ny, nx) = label;
+          stack.push_back(ny * cols + nx);
+        }
+      }
+    }
+  }
+
+  return labels;
+}
+
+CellLabels label_cells(GridView<const int> cell, GridView<const int> nucleus) {
+  check_same_shape(cell, nucleus, "cell and nucleus arrays should have the same dimensions");
+
+  const int rows = cell.rows();
+  const int cols = cell.cols();
+  Labels nuclei = label_components(nucleus);
+  CellLabels labels{std::move(nuclei.grid), Grid<int>(rows, cols, 0), nuclei.count};
+
+  // Breadth-first search from every nucleus at once, so each cell pixel is claimed by
+  // the first nucleus to reach it
+  std::queue<int> q;
+  for (int y = 0; y < rows; ++y) {
+    for (int x = 0; x < cols; ++x) {
+      const int label = labels.nuclei(y, x);
+      if (label == 0) continue;
+      q.push(y * cols + x);
+      if (cell(y, x) != 0) labels.cells(y, x) = label;
+    }
+  }
+
+  while (!q.empty()) {
+    int y = q.front() / cols;
+    int x = q.front() % cols;
+    q.pop();
+    const int label = labels.nuclei(y, x) != 0 ? labels.nuclei(y, x) : labels.cells(y, x);
+
+    for (int i = 0; i < 4; ++i) {
+      int ny = y + dy[i];
+      int nx = x + dx[i];
+      if (ny < 0 || ny >= rows || nx < 0 || nx >= cols || cell(ny, nx) == 0 ||
+          labels.cells(ny, nx) != 0 || labels.nuclei(ny, nx) != 0) {
+        continue;
+      }
+      labels.cells(ny, nx) = label;
+      q.push(ny * cols + nx);
+    }
+  }
+
+  return labels;
+}
+
+std::vector<CellForce> find_cell_forces(GridView<const int> cell, GridView<const int> nucleus, unsigned threads) {
+  return find_cell_forces(label_cells(cell, nucleus), threads);
+}
+
+std::vector<CellForce> find_cell_forces(const CellLabels& labels, unsigned threads) {
+  check_same_shape(labels.cells.view(), labels.nuclei.view(), "cell and nucleus arrays should have the same dimensions");
+
+  const int rows = labels.cells.rows();
+  const int cols = labels.cells.cols();
+  const int count = labels.count;
+
+  // Bounding box and area of every cell in one pass over the labels
+  std::vector<int> top(count + 1, rows), bottom(count + 1, -1);
+  std::vector<int> left(count + 1, cols), right(count + 1, -1);
+  std::vector<long> area(count + 1, 0);
+  for (int y = 0; y < rows; ++y) {
+    for (int x = 0; x < cols; ++x) {
+      for (int label : {labels.cells(y, x), labels.nuclei(y, x)}) {
+        if (label == 0) continue;
+        top[label] = std::min(top[label], y);
+        bottom[label] = y;
+        left[label] = std::min(left[label], x);
+        right[label] = std::max(right[label], x);
+        area[label]++;
+      }
+    }
+  }
+
+  std::vector<int> order(count);
+  std::iota(order.begin(), order.end(), 1);
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return area[a] > area[b]; });
+
+  std::vector<std::optional<CellForce>> results(count);
+  WorkStealingPool pool(threads);
+  pool.run(count, [&](int i) {
+    const int label = order[i];
+    const Region region = grow_region(top[label], bottom[label], left[label], right[label], 1, rows, cols);
+
+    // Other cells and nuclei in the box are background to this one
+    Grid<int> cell(region.rows, region.cols, 0);
+    Grid<int> nucleus(region.rows, region.cols, 0);
+    for (int y = 0; y < region.rows; ++y) {
+      const int* cells_row = labels.cells.row(region.y + y) + region.x;
+      const int* nuclei_row = labels.nuclei.row(region.y + y) + region.x;
+      for (int x = 0; x < region.cols; ++x) {
+        cell(y, x) = cells_row[x] == label;
+        nucleus(y, x) = nuclei_row[x] == label;
+      }
+    }
+
+    ForceMap force_map(cell, nucleus, region);
+    std::vector<double> force_vector = force_map.force_vector();
+    results[label - 1].emplace(CellForce{label, std::move(force_map), std::move(force_vector)});
+  });
+
+  std::vector<CellForce> forces;
+  forces.reserve(count);
+  for (std::optional<CellForce>& result : results) {
+    forces.push_back(std::move(*result));
+  }
+  return forces;
+}
+} // namespace nucleusforce
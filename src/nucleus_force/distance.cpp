@@ -0,0 +1,446 @@
+#include <nucleus_force/distance.h>
+
+#include <common/trace.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace nucleusforce {
+/**
+  * @brief Split [0, n) into blocks and run body(begin, end, out) on each block in parallel
+  *
+  * Each block appends to its own buffer, so the buffers can be concatenated in block
+  * order afterwards and the result does not depend on the number of threads.
+  */
+template <typename Body>
+static void for_blocks(ThreadPool& pool, int n, std::vector<std::vector<int>>& out, Body body) {
+  const int min_block = 512;
+  int blocks = std::max(1, std::min(n / min_block, static_cast<int>(pool.size()) * 4));
+  out.resize(blocks);
+  pool.parallel_for(0, blocks, [&](int b_begin, int b_end) {
+    for (int b = b_begin; b < b_end; ++b) {
+      out[b].clear();
+      body(static_cast<int>(static_cast<long long>(n) * b / blocks),
+           static_cast<int>(static_cast<long long>(n) * (b + 1) / blocks), out[b]);
+    }
+  }, 1);
+}
+
+/**
+  * @brief Concatenate the block buffers into frontier
+  */
+static void concat_blocks(const std::vector<std::vector<int>>& blocks, std::vector<int>& frontier) {
+  size_t total = 0;
+  for (const std::vector<int>& block : blocks) total += block.size();
+  frontier.clear();
+  frontier.reserve(total);
+  for (const std::vector<int>& block : blocks) {
+    frontier.insert(frontier.end(), block.begin(), block.end());
+  }
+}
+
+Grid<int> find_dist(GridView<const int> cell, GridView<const int> nucleus, ThreadPool& pool) {
+  NF_TRACE_SCOPE("find_dist");
+  check_same_shape(cell, nucleus, "cell and nucleus arrays should have the same dimensions");
+
+  const int rows = cell.rows();
+  const int cols = cell.cols();
+  const long long pixels = static_cast<long long>(rows) * cols;
+  Grid<int> dist(rows, cols, -1); // -1 means not reached
+  int* d_data = dist.data();
+
+  std::vector<std::vector<int>> blocks;
+  std::vector<int> frontier;
+
+  // Seed the frontier with the nucleus
+  for_blocks(pool, rows, blocks, [&](int begin, int end, std::vector<int>& out) {
+    for (int y = begin; y < end; ++y) {
+      for (int x = 0; x < cols; ++x) {
+        if (nucleus(y, x) == 1) {
+          d_data[y * cols + x] = 0;
+          out.push_back(y * cols + x);
+        }
+      }
+    }
+  });
+  concat_blocks(blocks, frontier);
+
+  auto on_level = [&](int y, int x, int d) {
+    return y >= 0 && y < rows && x >= 0 && x < cols && d_data[y * cols + x] == d;
+  };
+
+  for (int d = 0; !frontier.empty(); ++d) {
+    // Find the next level without writing to dist, so every read is race-free
+    if (static_cast<long long>(frontier.size()) * 16 > pixels) {
+      // Bottom-up: unreached cell pixels with a neighbour on the frontier
+      for_blocks(pool, rows, blocks, [&](int begin, int end, std::vector<int>& out) {
+        for (int y = begin; y < end; ++y) {
+          for (int x = 0; x < cols; ++x) {
+            if (cell(y, x) == 1 && d_data[y * cols + x] == -1 &&
+              (on_level(y - 1, x, d) || on_level(y, x - 1, d) || on_level(y, x + 1, d) || on_level(y + 1, x, d))) {
+              out.push_back(y * cols + x);
+            }
+          }
+        }
+      });
+    } else {
+      // Top-down: each unreached neighbour is claimed by the first of its own
+      // neighbours (up, left, right, down) that is on the frontier
+      for_blocks(pool, frontier.size(), blocks, [&](int begin, int end, std::vector<int>& out) {
+        for (int i = begin; i < end; ++i) {
+          int p = frontier[i];
+          int y = p / cols;
+          int x = p - y * cols;
+          const int ny[4] = {y - 1, y, y, y + 1};
+          const int nx[4] = {x, x - 1, x + 1, x};
+          for (int k = 0; k < 4; ++k) {
+            if (ny[k] < 0 || ny[k] >= rows || nx[k] < 0 || nx[k] >= cols ||
+              d_data[ny[k] * cols + nx[k]] != -1 || cell(ny[k], nx[k]) == 0) {
+              continue;
+            }
+            // Neighbours of the candidate before p in (up, left, right, down) order
+            // have smaller indices, so p owns it only if none of those are on the frontier
+            int cy = ny[k], cx = nx[k];
+            bool owned = true;
+            if (k == 0) owned = !on_level(cy - 1, cx, d) && !on_level(cy, cx - 1, d) && !on_level(cy, cx + 1, d);
+            if (k == 1) owned = !on_level(cy - 1, cx, d) && !on_level(cy, cx - 1, d);
+            if (k == 2) owned = !on_level(cy - 1, cx, d);
+            if (owned) out.push_back(cy * cols + cx);
+          }
+        }
+      });
+    }
+
+    concat_blocks(blocks, frontier);
+
+    // Every pixel of the next level appears exactly once, so the writes do not overlap
+    for_blocks(pool, frontier.size(), blocks, [&](int begin, int end, std::vector<int>&) {
+      for (int i = begin; i < end; ++i) {
+        d_data[frontier[i]] = d + 1;
+      }
+    });
+  }
+
+  return dist;
+}
+
+/**
+  * @brief Add pixel to the bucket for distance d, growing the buckets as needed
+  */
+static void push_bucket(std::vector<std::vector<int>>& buckets, int d, int pixel) {
+  if (d >= static_cast<int>(buckets.size())) {
+    buckets.resize(d + 1);
+  }
+  buckets[d].push_back(pixel);
+}
+
+std::vector<int> update_dist(GridView<const int> cell,
+                             GridView<const int> nucleus,
+                             const std::vector<int>& changed,
+                             GridView<int> dist) {
+  std::vector<unsigned char> marks(static_cast<size_t>(dist.rows()) * dist.cols(), 0);
+  return update_dist(cell, nucleus, changed, dist, marks);
+}
+
+std::vector<int> update_dist(GridView<const int> cell,
+                             GridView<const int> nucleus,
+                             const std::vector<int>& changed,
+                             GridView<int> dist,
+                             std::vector<unsigned char>& marks) {
+  check_same_shape(cell, nucleus, "cell and nucleus arrays should have the same dimensions");
+  check_same_shape(cell, dist, "cell and distance arrays should have the same dimensions");
+  if (marks.size() != static_cast<size_t>(dist.rows()) * dist.cols()) {
+    throw std::invalid_argument("marks should have one element per pixel");
+  }
+
+  const int rows = dist.rows();
+  const int cols = dist.cols();
+  const int dy[4] = {0, 1, 0, -1};
+  const int dx[4] = {1, 0, -1, 0};
+
+  // Pixels whose distance may have grown, with their old distance. Every marked pixel is
+  // in touched, which is how the marks are cleared again.
+  std::vector<unsigned char>& invalid = marks;
+  std::vector<std::pair<int, int>> touched;
+  std::vector<std::vector<int>> buckets;
+
+  for (int p : changed) {
+    if (invalid[p]) continue;
+    int y = p / cols;
+    int x = p - y * cols;
+    invalid[p] = 1;
+    touched.emplace_back(p, dist(y, x));
+    if (dist(y, x) >= 0) push_bucket(buckets, dist(y, x), p);
+  }
+
+  // A pixel at distance d + 1 keeps its distance while any neighbour at distance d
+  // survives. Going up from the nearest level, every level's losses are known before
+  // the level above it is checked.
+  for (size_t d = 0; d < buckets.size(); ++d) {
+    for (size_t i = 0; i < buckets[d].size(); ++i) {
+      int p = buckets[d][i];
+      int y = p / cols;
+      int x = p - y * cols;
+      for (int k = 0; k < 4; ++k) {
+        int ny = y + dy[k];
+        int nx = x + dx[k];
+        if (ny < 0 || ny >= rows || nx < 0 || nx >= cols) continue;
+        int q = ny * cols + nx;
+        if (invalid[q] || dist(ny, nx) != static_cast<int>(d) + 1) continue;
+
+        bool supported = false;
+        for (int j = 0; j < 4 && !supported; ++j) {
+          int sy = ny + dy[j];
+          int sx = nx + dx[j];
+          supported = sy >= 0 && sy < rows && sx >= 0 && sx < cols &&
+                      dist(sy, sx) == static_cast<int>(d) && !invalid[sy * cols + sx];
+        }
+        if (!supported) {
+          invalid[q] = 1;
+          touched.emplace_back(q, dist(ny, nx));
+          push_bucket(buckets, d + 1, q);
+        }
+      }
+    }
+  }
+
+  for (const std::pair<int, int>& t : touched) {
+    int y = t.first / cols;
+    dist(y, t.first - y * cols) = -1;
+  }
+
+  // Seed the search from the new nucleus pixels and from the surviving distances
+  // around the invalidated region
+  buckets.clear();
+  for (const std::pair<int, int>& t : touched) {
+    int p = t.first;
+    int y = p / cols;
+    int x = p - y * cols;
+    if (nucleus(y, x) == 1) {
+      dist(y, x) = 0;
+      push_bucket(buckets, 0, p);
+      continue;
+    }
+    if (cell(y, x) == 0) continue;
+
+    int best = -1;
+    for (int k = 0; k < 4; ++k) {
+      int ny = y + dy[k];
+      int nx = x + dx[k];
+      if (ny < 0 || ny >= rows || nx < 0 || nx >= cols || invalid[ny * cols + nx]) continue;
+      if (dist(ny, nx) >= 0 && (best == -1 || dist(ny, nx) < best)) best = dist(ny, nx);
+    }
+    if (best >= 0) {
+      dist(y, x) = best + 1;
+      push_bucket(buckets, best + 1, p);
+    }
+  }
+
+  // Breadth-first search over the seeds in order of distance. It can also pass into
+  // surviving pixels that a new pixel has brought closer to the nucleus.
+  for (size_t d = 0; d < buckets.size(); ++d) {
+    for (size_t i = 0; i < buckets[d].size(); ++i) {
+      int p = buckets[d][i];
+      int y = p / cols;
+      int x = p - y * cols;
+      if (dist(y, x) != static_cast<int>(d)) continue;
+      for (int k = 0; k < 4; ++k) {
+        int ny = y + dy[k];
+        int nx = x + dx[k];
+        if (ny < 0 || ny >= rows || nx < 0 || nx >= cols || cell(ny, nx) == 0) continue;
+        int& next = dist(ny, nx);
+        if (next != -1 && next <= static_cast<int>(d) + 1) continue;
+        int q = ny * cols + nx;
+        if (!invalid[q]) {
+          invalid[q] = 1;
+          touched.emplace_back(q, next);
+        }
+        next = static_cast<int>(d) + 1;
+        push_bucket(buckets, d + 1, q);
+      }
+    }
+  }
+
+  std::vector<int> moved;
+  for (const std::pair<int, int>& t : touched) {
+    int y = t.first / cols;
+    if (dist(y, t.first - y * cols) != t.second) moved.push_back(t.first);
+    invalid[t.first] = 0;
+  }
+  std::sort(moved.begin(), moved.end());
+  return moved;
+}
+/**
+  * @brief Squared distance transform of one line of n samples by the lower envelope of parabolas
+  *
+  * v and z are scratch of at least n and n + 1 elements. Samples of f that are infinite are not sources; if every sample
+  * is, d is left infinite.
+  */
+static void squared_distance_line(const double* f, double* d, int n, int* v, double* z) {
+  const double inf = std::numeric_limits<double>::infinity();
+  int k = -1;
+  for (int q = 0; q < n; ++q) {
+    const double fq = f[q];
+    if (fq == inf) continue;
+    double s = -inf;
+    while (k >= 0) {
+      const double fv = f[v[k]];
+      s = ((fq + double(q) * q) - (fv + double(v[k]) * v[k])) / (2.0 * (q - v[k]));
+      if (s > z[k]) break;
+      --k;
+    }
+    ++k;
+    v[k] = q;
+    z[k] = k == 0 ? -inf : s;
+  }
+  if (k < 0) {
+    std::fill(d, d + n, inf);
+    return;
+  }
+  z[k + 1] = inf;
+
+  for (int q = 0, j = 0; q < n; ++q) {
+    while (z[j + 1] < q) ++j;
+    const double offset = q - v[j];
+    d[q] = offset * offset + f[v[j]];
+  }
+}
+
+Grid<double> find_euclidean_dist(GridView<const int> cell, GridView<const int> nucleus, ThreadPool& pool) {
+  NF_TRACE_SCOPE("find_euclidean_dist");
+  check_same_shape(cell, nucleus, "cell and nucleus arrays should have the same dimensions");
+
+  const int rows = cell.rows();
+  const int cols = cell.cols();
+  const double inf = std::numeric_limits<double>::infinity();
+
+  // The squared distance separates into a pass down every column and then one along
+  // every row, and the lines of each pass are independent. Each column is copied into
+  // a contiguous line first so the envelope is built without striding through memory.
+  Grid<double> columns(rows, cols);
+  pool.parallel_for(0, cols, [&](int begin, int end) {
+    std::vector<double> f(rows);
+    std::vector<double> d(rows);
+    std::vector<int> v(rows);
+    std::vector<double> z(rows + 1);
+    for (int x = begin; x < end; ++x) {
+      for (int y = 0; y < rows; ++y) {
+        f[y] = nucleus(y, x) == 1 ? 0 : inf;
+      }
+      squared_distance_line(f.data(), d.data(), rows, v.data(), z.data());
+      for (int y = 0; y < rows; ++y) {
+        columns(y, x) = d[y];
+      }
+    }
+  }, 16);
+
+  Grid<double> dist(rows, cols);
+  pool.parallel_for(0, rows, [&](int begin, int end) {
+    std::vector<int> v(cols);
+    std::vector<double> z(cols + 1);
+    for (int y = begin; y < end; ++y) {
+      squared_distance_line(columns.row(y), dist.row(y), cols, v.data(), z.data());
+      double* out = dist.row(y);
+      for (int x = 0; x < cols; ++x) {
+        bool inside = cell(y, x) == 1 || nucleus(y, x) == 1;
+        out[x] = inside && out[x] != inf ? std::sqrt(out[x]) : -1;
+      }
+    }
+  }, 16);
+
+  return dist;
+}
+
+Grid<double> find_euclidean_dist(GridView<const int> cell, GridView<const int> nucleus, unsigned threads) {
+  ThreadPool pool(threads);
+  return find_euclidean_dist(cell, nucleus, pool);
+}
+
+/**
+  * @brief First-order fast marching update of a pixel from the accepted values of its neighbours
+  */
+static double eikonal_update(GridView<const double> t, GridView<const int> accepted, int y, int x) {
+  const double inf = std::numeric_limits<double>::infinity();
+  auto value = [&](int ny, int nx) {
+    if (ny < 0 || ny >= t.rows() || nx < 0 || nx >= t.cols() || !accepted(ny, nx)) return inf;
+    return t(ny, nx);
+  };
+  double a = std::min(value(y, x - 1), value(y, x + 1));
+  double b = std::min(value(y - 1, x), value(y + 1, x));
+  if (a > b) std::swap(a, b);
+  if (b - a >= 1) return a + 1;
+  return (a + b + std::sqrt(2 - (b - a) * (b - a))) / 2;
+}
+
+Grid<double> find_geodesic_dist(GridView<const int> cell, GridView<const int> nucleus) {
+  NF_TRACE_SCOPE("find_geodesic_dist");
+  check_same_shape(cell, nucleus, "cell and nucleus arrays should have the same dimensions");
+
+  const int rows = cell.rows();
+  const int cols = cell.cols();
+  const int dy[4] = {0, 1, 0, -1};
+  const int dx[4] = {1, 0, -1, 0};
+  Grid<double> t(rows, cols, std::numeric_limits<double>::infinity());
+  Grid<int> accepted(rows, cols, 0);
+
+  // Trial pixels are kept in buckets of width 1/2 rather than a heap. An update is at
+  // most 1 above the accepted value that caused it, so the band never spans more than
+  // the current bucket and the two after it, and a ring of 4 buckets is enough. Pixels
+  // within a bucket are accepted in the order they arrive, which moves the result by
+  // a small fraction of a pixel from exact fast marching.
+  const double width = 0.5;
+  const int ring = 4;
+  std::vector<int> buckets[ring];
+  long long pending = 0;
+  for (int y = 0; y < rows; ++y) {
+    for (int x = 0; x < cols; ++x) {
+      if (nucleus(y, x) == 1) {
+        t(y, x) = 0;
+        buckets[0].push_back(y * cols + x);
+        ++pending;
+      }
+    }
+  }
+
+  [[maybe_unused]] long long accepted_pixels = 0;
+  for (long long k = 0; pending > 0; ++k) {
+    std::vector<int>& bucket = buckets[k % ring];
+    // Updates can land in the bucket being accepted, so it may grow while it is walked
+    for (size_t i = 0; i < bucket.size(); ++i) {
+      int y = bucket[i] / cols;
+      int x = bucket[i] - y * cols;
+      if (accepted(y, x)) continue;
+      accepted(y, x) = 1;
+      ++accepted_pixels;
+
+      for (int j = 0; j < 4; ++j) {
+        int ny = y + dy[j];
+        int nx = x + dx[j];
+        if (ny < 0 || ny >= rows || nx < 0 || nx >= cols || accepted(ny, nx) || cell(ny, nx) == 0) {
+          continue;
+        }
+        double candidate = eikonal_update(t, accepted, ny, nx);
+        if (candidate < t(ny, nx)) {
+          t(ny, nx) = candidate;
+          long long target = std::max(k, static_cast<long long>(candidate / width));
+          buckets[target % ring].push_back(ny * cols + nx);
+          ++pending;
+        }
+      }
+    }
+    pending -= static_cast<long long>(bucket.size());
+    bucket.clear();
+  }
+  NF_TRACE_COUNT("geodesic_pixels_accepted", accepted_pixels);
+
+  for (int y = 0; y < rows; ++y) {
+    for (int x = 0; x < cols; ++x) {
+      if (!accepted(y, x)) t(y, x) = -1;
+    }
+  }
+  return t;
+}
+} // namespace nucleusforce
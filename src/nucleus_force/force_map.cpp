@@ -0,0 +1,131 @@
+#include <nucleus_force/force_map.h>
+
+#include <common/thread_pool.h>
+#include <nucleus_force/distance.h>
+#include <nucleus_force/nucleus_force.h>
+#include <mutex>
+#include <stdexcept>
+
+namespace nucleusforce {
+/**
+  * @brief Pool a ForceMap keeps, with the lock a call holds while it uses it
+  */
+struct ForceMap::Workers {
+  explicit Workers(unsigned threads) : pool(threads) {}
+
+  ThreadPool pool;
+  std::mutex mutex; ///< Held while a call runs loops on pool, which runs one loop at a time
+};
+
+ForceMap::ForceMap(GridView<const int> cell, GridView<const int> nucleus, unsigned threads)
+    : ForceMap(cell, nucleus, Region{0, 0, cell.rows(), cell.cols()}, threads) {}
+
+ForceMap::ForceMap(GridView<const int> cell, GridView<const int> nucleus, const Region& region, unsigned threads)
+    : cell_(cell), nucleus_(nucleus), region_(region), threads_(threads) {
+  check_same_shape(cell, nucleus, "cell and nucleus arrays should have the same dimensions");
+  if (cell.rows() != region.rows || cell.cols() != region.cols) {
+    throw std::invalid_argument("Cell and nucleus arrays must be the size of their region.");
+  }
+
+  workers_ = std::make_shared<Workers>(threads);
+  boundary_ = find_boundary(cell_, nucleus_);
+  if (workers_->pool.size() == 1) {
+    workers_.reset();
+    dist_ = find_dist(cell_, nucleus_);
+  } else {
+    dist_ = find_dist(cell_, nucleus_, workers_->pool);
+  }
+  levels_ = build_levels(dist_);
+}
+
+void ForceMap::with_pool(const std::function<void(ThreadPool&)>& body) const {
+  if (workers_) {
+    std::unique_lock<std::mutex> lock(workers_->mutex, std::try_to_lock);
+    if (lock.owns_lock()) {
+      body(workers_->pool);
+      return;
+    }
+  }
+  ThreadPool serial(1);
+  body(serial);
+}
+
+ForceMap ForceMap::cropped(GridView<const int> cell, GridView<const int> nucleus, unsigned threads) {
+  Region region = find_bounding_box(cell, nucleus);
+  return ForceMap(cell.subview(region), nucleus.subview(region), region, threads);
+}
+
+Grid<double> ForceMap::nucleus_force() const {
+  Grid<double> force(rows(), cols());
+  for (size_t i = 0; i < force.size(); ++i) {
+    force.data()[i] = boundary_.data()[i];
+  }
+  return nucleus_force(force);
+}
+
+Grid<double> ForceMap::nucleus_force(GridView<const double> force) const {
+  check_same_shape(cell_.view(), force, "Cell, nucleus, and force array dimensions must be identical.");
+
+  Grid<double> f(force);
+  with_pool([&](ThreadPool& pool) {
+    if (pool.size() == 1) {
+      propagate_force(cell_, nucleus_, dist_, levels_, f);
+    } else {
+      propagate_force(cell_, nucleus_, dist_, levels_, f, pool);
+    }
+  });
+  return f;
+}
+
+Grid<double> ForceMap::nucleus_force(const SparseGrid<double>& force) const {
+  if (force.rows() != rows() || force.cols() != cols()) {
+    throw std::invalid_argument("Cell, nucleus, and force array dimensions must be identical.");
+  }
+  return nucleus_force(force.to_dense());
+}
+
+SparseGrid<double> ForceMap::sparse_nucleus_force() const {
+  return SparseGrid<double>::from_dense(nucleus_force());
+}
+
+TransferOperator ForceMap::transfer_operator() const {
+  return TransferOperator(cell_, nucleus_, dist_, boundary_, threads_);
+}
+
+std::vector<double> ForceMap::centroid() const {
+  std::vector<double> centroid = find_nucleus_centroid(nucleus_);
+  centroid[0] += region_.x;
+  centroid[1] += region_.y;
+  return centroid;
+}
+
+ForceMoments ForceMap::moments_of(GridView<const double> propagated) const {
+  const int* begin = levels_.count() > 0 ? levels_.begin(0) : nullptr;
+  const int* end = levels_.count() > 0 ? levels_.end(0) : nullptr;
+  ForceMoments moments;
+  with_pool([&](ThreadPool& pool) { moments = find_force_moments(begin, end, propagated, pool); });
+  moments.centroid_x += region_.x;
+  moments.centroid_y += region_.y;
+  return moments;
+}
+
+ForceMoments ForceMap::force_moments() const {
+  return moments_of(nucleus_force());
+}
+
+ForceMoments ForceMap::force_moments(GridView<const double> force) const {
+  return moments_of(nucleus_force(force));
+}
+
+std::vector<double> ForceMap::force_vector() const {
+  return find_force_vector(nucleus_, nucleus_force());
+}
+
+std::vector<double> ForceMap::force_vector(GridView<const double> force) const {
+  return find_force_vector(nucleus_, nucleus_force(force));
+}
+
+std::vector<double> ForceMap::force_vector(const SparseGrid<double>& force) const {
+  return find_force_vector(nucleus_, nucleus_force(force));
+}
+} // namespace nucleusforce
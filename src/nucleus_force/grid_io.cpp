@@ -0,0 +1,283 @@
+#include <nucleus_force/grid_io.h>
+
+#include <common/trace.h>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "Binary grid files are written in host byte order, which must be little-endian"
+#endif
+
+static_assert(sizeof(int) == sizeof(int32_t), "Grid files store ints as 32-bit integers");
+
+namespace nucleusforce {
+static const char raw_magic[8] = {'N', 'F', 'G', 'R', 'I', 'D', '\0', '\0'};
+static const uint32_t raw_version = 1;
+static const size_t raw_header_size = 64;
+
+static const char npy_magic[6] = {'\x93', 'N', 'U', 'M', 'P', 'Y'};
+static const size_t npy_alignment = 64;
+
+static size_t element_size(GridType type) {
+  return type == GridType::Int32 ? sizeof(int32_t) : sizeof(double);
+}
+
+/**
+  * @brief Write header then the elements of array with large buffered writes
+  */
+template <typename T>
+static void write_grid_file(const std::string& filepath, const std::string& header, GridView<const T> array) {
+  NF_TRACE_SCOPE("export");
+  std::unique_ptr<std::FILE, int (*)(std::FILE*)> file(std::fopen(filepath.c_str(), "wb"), &std::fclose);
+  if (!file) {
+    throw std::runtime_error("Could not open file for writing: " + filepath);
+  }
+  std::setvbuf(file.get(), nullptr, _IOFBF, size_t(1) << 20);
+
+  bool ok = std::fwrite(header.data(), 1, header.size(), file.get()) == header.size();
+  if (array.is_contiguous()) {
+    size_t count = static_cast<size_t>(array.rows()) * array.cols();
+    ok = ok && std::fwrite(array.data(), sizeof(T), count, file.get()) == count;
+  } else {
+    for (int y = 0; ok && y < array.rows(); ++y) {
+      ok = std::fwrite(array.row(y), sizeof(T), array.cols(), file.get()) == static_cast<size_t>(array.cols());
+    }
+  }
+  ok = std::fflush(file.get()) == 0 && ok;
+
+  if (!ok) {
+    throw std::runtime_error("Could not write file: " + filepath);
+  }
+  NF_TRACE_COUNT("bytes_written", static_cast<long long>(header.size() + sizeof(T) * array.rows() * array.cols()));
+}
+
+static std::string npy_header(const char* descr, int rows, int cols) {
+  std::string dict = std::string("{'descr': '") + descr + "', 'fortran_order': False, 'shape': (" +
+                     std::to_string(rows) + ", " + std::to_string(cols) + "), }";
+
+  // Pad with spaces and a newline so the data starts on an aligned offset
+  size_t unpadded = sizeof(npy_magic) + 2 + 2 + dict.size() + 1;
+  dict.append((npy_alignment - unpadded % npy_alignment) % npy_alignment, ' ');
+  dict += '\n';
+
+  std::string header(npy_magic, sizeof(npy_magic));
+  header += '\x01';
+  header += '\x00';
+  header += static_cast<char>(dict.size() & 0xff);
+  header += static_cast<char>(dict.size() >> 8);
+  return header + dict;
+}
+
+static std::string raw_header(GridType type, int rows, int cols) {
+  std::string header(raw_header_size, '\0');
+  uint32_t type_value = static_cast<uint32_t>(type);
+  int64_t rows_value = rows;
+  int64_t cols_value = cols;
+  std::memcpy(&header[0], raw_magic, sizeof(raw_magic));
+  std::memcpy(&header[8], &raw_version, sizeof(raw_version));
+  std::memcpy(&header[12], &type_value, sizeof(type_value));
+  std::memcpy(&header[16], &rows_value, sizeof(rows_value));
+  std::memcpy(&header[24], &cols_value, sizeof(cols_value));
+  return header;
+}
+
+void export_npy(const std::string& filepath, GridView<const int> array) {
+  write_grid_file(filepath, npy_header("<i4", array.rows(), array.cols()), array);
+}
+
+void export_npy(const std::string& filepath, GridView<const double> array) {
+  write_grid_file(filepath, npy_header("<f8", array.rows(), array.cols()), array);
+}
+
+void export_raw(const std::string& filepath, GridView<const int> array) {
+  write_grid_file(filepath, raw_header(GridType::Int32, array.rows(), array.cols()), array);
+}
+
+void export_raw(const std::string& filepath, GridView<const double> array) {
+  write_grid_file(filepath, raw_header(GridType::Float64, array.rows(), array.cols()), array);
+}
+
+/**
+  * @brief Value that follows key in an npy header dictionary, up to the next comma outside brackets
+  */
+static std::string npy_field(const std::string& dict, const std::string& key) {
+  size_t pos = dict.find("'" + key + "'");
+  if (pos == std::string::npos) {
+    throw std::invalid_argument("npy header is missing " + key);
+  }
+  pos = dict.find(':', pos);
+  if (pos == std::string::npos) {
+    throw std::invalid_argument("npy header is missing the value of " + key);
+  }
+  size_t end = pos + 1;
+  int depth = 0;
+  while (end < dict.size() && (depth > 0 || (dict[end] != ',' && dict[end] != '}'))) {
+    if (dict[end] == '(') depth++;
+    if (dict[end] == ')') depth--;
+    end++;
+  }
+  std::string value = dict.substr(pos + 1, end - pos - 1);
+  size_t first = value.find_first_not_of(" ");
+  size_t last = value.find_last_not_of(" ");
+  return first == std::string::npos ? "" : value.substr(first, last - first + 1);
+}
+
+/**
+  * @brief Check that a dimension read from a file fits in an int
+  */
+static int to_dimension(long long value) {
+  if (value < 0 || value > std::numeric_limits<int>::max()) {
+    throw std::invalid_argument("Grid file has invalid dimensions");
+  }
+  return static_cast<int>(value);
+}
+
+MappedGrid::MappedGrid(const std::string& filepath) {
+  int fd = ::open(filepath.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Could not open file for reading: " + filepath);
+  }
+  struct stat info;
+  if (::fstat(fd, &info) != 0) {
+    ::close(fd);
+    throw std::runtime_error("Could not read file: " + filepath);
+  }
+  size_ = static_cast<size_t>(info.st_size);
+  if (size_ > 0) {
+    mapping_ = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  ::close(fd);
+  if (size_ == 0 || mapping_ == MAP_FAILED) {
+    mapping_ = nullptr;
+    throw std::runtime_error("Could not map file: " + filepath);
+  }
+
+  const unsigned char* bytes = static_cast<const unsigned char*>(mapping_);
+  size_t offset = 0;
+  try {
+    if (size_ >= raw_header_size && std::memcmp(bytes, raw_magic, sizeof(raw_magic)) == 0) {
+      uint32_t version, type;
+      int64_t rows, cols;
+      std::memcpy(&version, bytes + 8, sizeof(version));
+      std::memcpy(&type, bytes + 12, sizeof(type));
+      std::memcpy(&rows, bytes + 16, sizeof(rows));
+      std::memcpy(&cols, bytes + 24, sizeof(cols));
+      if (version != raw_version) {
+        throw std::invalid_argument("Unsupported grid file version: " + std::to_string(version));
+      }
+      if (type != static_cast<uint32_t>(GridType::Int32) && type != static_cast<uint32_t>(GridType::Float64)) {
+        throw std::invalid_argument("Unsupported grid element type: " + std::to_string(type));
+      }
+      type_ = static_cast<GridType>(type);
+      rows_ = to_dimension(rows);
+      cols_ = to_dimension(cols);
+      offset = raw_header_size;
+    } else if (size_ >= 10 && std::memcmp(bytes, npy_magic, sizeof(npy_magic)) == 0) {
+      // Version 1 has a 2-byte header length, versions 2 and 3 a 4-byte one
+      size_t header_length = bytes[8] | (bytes[9] << 8);
+      offset = 10;
+      if (bytes[6] >= 2) {
+        if (size_ < 12) throw std::invalid_argument("Truncated npy header");
+        header_length |= (size_t(bytes[10]) << 16) | (size_t(bytes[11]) << 24);
+        offset = 12;
+      }
+      if (offset + header_length > size_) {
+        throw std::invalid_argument("Truncated npy header");
+      }
+      std::string dict(reinterpret_cast<const char*>(bytes + offset), header_length);
+      offset += header_length;
+
+      std::string descr = npy_field(dict, "descr");
+      if (descr == "'<i4'") {
+        type_ = GridType::Int32;
+      } else if (descr == "'<f8'") {
+        type_ = GridType::Float64;
+      } else {
+        throw std::invalid_argument("Unsupported npy element type: " + descr);
+      }
+      if (npy_field(dict, "fortran_order") != "False") {
+        throw std::invalid_argument("Only C-ordered npy arrays are supported");
+      }
+
+      std::string shape = npy_field(dict, "shape");
+      long long rows = 0, cols = 0;
+      if (std::sscanf(shape.c_str(), "(%lld, %lld)", &rows, &cols) != 2) {
+        throw std::invalid_argument("Only 2D npy arrays are supported, found shape " + shape);
+      }
+      rows_ = to_dimension(rows);
+      cols_ = to_dimension(cols);
+    } else {
+      throw std::invalid_argument("Not a grid file: " + filepath);
+    }
+
+    // Divide rather than multiply, since the product of two crafted dimensions can overflow
+    size_t capacity = (size_ - offset) / element_size(type_);
+    if (cols_ != 0 && static_cast<size_t>(rows_) > capacity / cols_) {
+      throw std::invalid_argument("Grid file is shorter than its dimensions: " + filepath);
+    }
+    if (offset % element_size(type_) != 0) {
+      throw std::invalid_argument("Grid file data is not aligned: " + filepath);
+    }
+  } catch (...) {
+    unmap();
+    throw;
+  }
+
+  data_ = bytes + offset;
+}
+
+MappedGrid::~MappedGrid() {
+  unmap();
+}
+
+MappedGrid::MappedGrid(MappedGrid&& other) noexcept {
+  *this = std::move(other);
+}
+
+MappedGrid& MappedGrid::operator=(MappedGrid&& other) noexcept {
+  if (this != &other) {
+    unmap();
+    mapping_ = std::exchange(other.mapping_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    data_ = std::exchange(other.data_, nullptr);
+    type_ = other.type_;
+    rows_ = std::exchange(other.rows_, 0);
+    cols_ = std::exchange(other.cols_, 0);
+  }
+  return *this;
+}
+
+void MappedGrid::unmap() {
+  if (mapping_ != nullptr) {
+    ::munmap(mapping_, size_);
+    mapping_ = nullptr;
+  }
+}
+
+template <>
+GridView<const int> MappedGrid::view<int>() const {
+  if (type_ != GridType::Int32) {
+    throw std::invalid_argument("Grid file does not hold ints");
+  }
+  return GridView<const int>(reinterpret_cast<const int*>(data_), rows_, cols_);
+}
+
+template <>
+GridView<const double> MappedGrid::view<double>() const {
+  if (type_ != GridType::Float64) {
+    throw std::invalid_argument("Grid file does not hold doubles");
+  }
+  return GridView<const double>(reinterpret_cast<const double*>(data_), rows_, cols_);
+}
+} // namespace nucleusforce
@@ -0,0 +1,84 @@
+#ifndef CELLS_H
+#define CELLS_H
+
+#include <common/grid.h>
+#include <nucleus_force/force_map.h>
+#include <vector>
+
+namespace nucleusforce {
+/**
+  * @brief Connected regions of a mask, numbered from 1
+  */
+struct Labels {
+  Grid<int> grid; ///< Number of the region of each pixel, 0 outside the mask
+  int count = 0; ///< Number of regions
+};
+
+/**
+  * @brief Cells of an image with several cells, each paired with its nucleus
+  */
+struct CellLabels {
+  Grid<int> nuclei; ///< Number of the cell each nucleus pixel belongs to, 0 elsewhere
+  Grid<int> cells; ///< Number of the cell each cell pixel belongs to, 0 elsewhere
+  int count = 0; ///< Number of cells
+};
+
+/**
+  * @brief Force map and net force of one cell of an image with several cells
+  */
+struct CellForce {
+  int label; ///< Number of the cell in CellLabels
+  ForceMap force_map; ///< Geometry of the cell, cropped to its bounding box
+  std::vector<double> force_vector; ///< (x, y) net force on the nucleus due to an equal force on every boundary pixel
+};
+
+/**
+  * @brief Number the 4-connected regions of non-zero pixels of a mask
+  *
+  * Regions are numbered in the row-major order of their first pixel.
+  *
+  * @param mask 2D array that is non-zero on the pixels to label
+  */
+Labels label_components(GridView<const int> mask);
+
+/**
+  * @brief Split the cell and nucleus masks of an image into one cell per nucleus
+  *
+  * Every 4-connected region of the nucleus mask is the nucleus of one cell. Each cell
+  * pixel belongs to the nucleus it is nearest to along paths through the cell, the same
+  * paths the distance map follows, so cells that touch are split where the distances
+  * from their nuclei meet. Cell pixels no nucleus can reach are left unlabelled, since
+  * none of their force would reach a nucleus.
+  *
+  * @param cell 2D array where 1 is a cell and 0 is everything else
+  * @param nucleus 2D array where 1 is a nucleus and 0 is everything else
+  */
+CellLabels label_cells(GridView<const int> cell, GridView<const int> nucleus);
+
+/**
+  * @brief Find the force map and net force of every cell of an image
+  *
+  * Each cell is cut to its own bounding box and processed on its own, so the search from
+  * one nucleus never crosses into a neighbouring cell. Cells are spread between threads
+  * with work stealing, largest first, since their sizes vary widely.
+  *
+  * @param cell 2D array where 1 is a cell and 0 is everything else
+  * @param nucleus 2D array where 1 is a nucleus and 0 is everything else
+  * @param threads number of threads to process cells with, 0 for one per hardware core
+  *
+  * @return one result per cell, in the order of their labels
+  */
+std::vector<CellForce> find_cell_forces(GridView<const int> cell, GridView<const int> nucleus, unsigned threads = 1);
+
+/**
+  * @brief Find the force map and net force of every labelled cell of an image
+  *
+  * @param labels cells and nuclei as found by label_cells
+  * @param threads number of threads to process cells with, 0 for one per hardware core
+  *
+  * @return one result per cell, in the order of their labels
+  */
+std::vector<CellForce> find_cell_forces(const CellLabels& labels, unsigned threads = 1);
+} // namespace nucleusforce
+
+#endif // CELLS_H
@@ -0,0 +1,56 @@
+#ifndef CONNECTIVITY_H
+#define CONNECTIVITY_H
+
+#include <cstddef>
+#include <utility>
+
+namespace nucleusforce {
+/**
+  * @brief Which neighbours of a pixel the distance search and force propagation step to
+  */
+enum class Connectivity {
+  Four = 4, ///< Right, down, left and up
+  Eight = 8 ///< The four of Four, then the diagonals
+};
+
+/**
+  * @brief Offsets of the neighbours of a pixel for one connectivity
+  *
+  * The first four neighbours are right, down, left and up, the order the 4-connected
+  * engine has always visited them in, so Four reproduces its results exactly.
+  */
+template <Connectivity C>
+struct Stencil {
+  static constexpr int size = static_cast<int>(C);
+  static constexpr int dy[8] = {0, 1, 0, -1, 1, 1, -1, -1};
+  static constexpr int dx[8] = {1, 0, -1, 0, 1, -1, 1, -1};
+};
+
+template <Connectivity C, typename F, size_t... I>
+inline void for_each_neighbour(F&& f, std::index_sequence<I...>) {
+  (f(Stencil<C>::dy[I], Stencil<C>::dx[I]), ...);
+}
+
+/**
+  * @brief Call f(dy, dx) for every neighbour offset of the stencil in order
+  *
+  * The calls are expanded at compile time, so each instantiation is fully unrolled and
+  * bounds checks on offsets of 0 fold away.
+  */
+template <Connectivity C, typename F>
+inline void for_each_neighbour(F&& f) {
+  for_each_neighbour<C>(std::forward<F>(f), std::make_index_sequence<Stencil<C>::size>());
+}
+
+/**
+  * @brief Distance of pixels that the distance search does not reach
+  *
+  * -1 for signed types, and the largest value for unsigned ones.
+  */
+template <typename Dist>
+constexpr Dist unreached_distance() {
+  return static_cast<Dist>(-1);
+}
+} // namespace nucleusforce
+
+#endif // CONNECTIVITY_H
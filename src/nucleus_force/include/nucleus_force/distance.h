@@ -0,0 +1,111 @@
+#ifndef DISTANCE_H
+#define DISTANCE_H
+
+#include <common/grid.h>
+#include <common/thread_pool.h>
+#include <vector>
+
+namespace nucleusforce {
+/**
+  * @brief Find the distance from any point on the nucleus to all points in the cell with
+  *        a level-synchronous breadth-first search split across a thread pool
+  *
+  * Each level expands the previous frontier in parallel. Small frontiers are expanded
+  * top-down from the frontier pixels; once the frontier covers a large part of the image
+  * the level is found bottom-up instead, by scanning the unreached cell pixels for a
+  * neighbour on the frontier. The distance map is identical to find_dist.
+  *
+  * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+  * @param pool threads to split each level across
+  */
+Grid<int> find_dist(GridView<const int> cell, GridView<const int> nucleus, ThreadPool& pool);
+
+/**
+  * @brief Find the straight-line distance from the nucleus to every point of the cell
+  *
+  * Exact Euclidean distance transform in linear time: the squared distance to the nearest
+  * nucleus pixel is found down every column and then along every row as the lower
+  * envelope of parabolas, with the lines of each pass split across the pool. The
+  * distance ignores the shape of the cell, so it follows the cell only where the cell is
+  * convex around the nucleus.
+  *
+  * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+  * @param pool threads to split the columns and rows across
+  *
+  * @return distance of every cell and nucleus pixel, -1 elsewhere or if there is no nucleus
+  */
+Grid<double> find_euclidean_dist(GridView<const int> cell, GridView<const int> nucleus, ThreadPool& pool);
+
+/**
+  * @brief Find the straight-line distance from the nucleus to every point of the cell
+  *
+  * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+  * @param threads number of threads to split the columns and rows across, 0 for one per hardware core
+  *
+  * @return distance of every cell and nucleus pixel, -1 elsewhere or if there is no nucleus
+  */
+Grid<double> find_euclidean_dist(GridView<const int> cell, GridView<const int> nucleus, unsigned threads = 1);
+
+/**
+  * @brief Find the distance from the nucleus to every point of the cell along paths inside the cell
+  *
+  * Solves the eikonal equation with unit speed on the cell by fast marching, keeping the
+  * narrow band in buckets half a pixel wide instead of a heap so each pixel costs a
+  * constant amount of work. Unlike find_dist the distance is not biased along the axes,
+  * and unlike find_euclidean_dist it goes around holes and bends in the cell.
+  *
+  * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+  *
+  * @return distance of every cell pixel the nucleus reaches and 0 on the nucleus, -1 elsewhere
+  */
+Grid<double> find_geodesic_dist(GridView<const int> cell, GridView<const int> nucleus);
+
+/**
+  * @brief Repair a distance map after some pixels of the cell or nucleus changed
+  *
+  * Pixels whose shortest path to the nucleus ran through a changed pixel are invalidated
+  * first, then the invalidated region and everything a new shortcut brings closer are
+  * searched again outwards from the surviving distances. Only pixels near the change
+  * are visited, and the result is identical to running find_dist on the new masks.
+  *
+  * @param cell new 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus new 2D array where 1 is the nucleus and 0 is everything else
+  * @param changed row-major linear indices (y * cols + x) of the pixels whose cell or
+  *        nucleus value differs from the masks dist was found for
+  * @param dist distance map of the old masks, replaced with the distance map of the new ones
+  *
+  * @return sorted linear indices of the pixels whose distance changed
+  */
+std::vector<int> update_dist(GridView<const int> cell,
+                             GridView<const int> nucleus,
+                             const std::vector<int>& changed,
+                             GridView<int> dist);
+
+/**
+  * @brief Repair a distance map after some pixels changed, marking pixels in a buffer the caller keeps
+  *
+  * Same as update_dist without marks, but only writes and clears the marks of the pixels
+  * it visits, so repeated updates cost nothing per pixel of the image.
+  *
+  * @param cell new 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus new 2D array where 1 is the nucleus and 0 is everything else
+  * @param changed row-major linear indices (y * cols + x) of the pixels whose cell or
+  *        nucleus value differs from the masks dist was found for
+  * @param dist distance map of the old masks, replaced with the distance map of the new ones
+  * @param marks one zero element per pixel, left all zero again
+  *
+  * @return sorted linear indices of the pixels whose distance changed
+  * @throws std::invalid_argument if marks does not have one element per pixel
+  */
+std::vector<int> update_dist(GridView<const int> cell,
+                             GridView<const int> nucleus,
+                             const std::vector<int>& changed,
+                             GridView<int> dist,
+                             std::vector<unsigned char>& marks);
+} // namespace nucleusforce
+
+#endif // DISTANCE_H
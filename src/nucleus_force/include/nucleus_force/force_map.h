@@ -0,0 +1,207 @@
+#ifndef FORCE_MAP_H
+#define FORCE_MAP_H
+
+#include <common/grid.h>
+#include <common/sparse_grid.h>
+#include <nucleus_force/moments.h>
+#include <nucleus_force/propagation.h>
+#include <nucleus_force/transfer.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace nucleusforce {
+/**
+  * @brief Cell geometry with its boundary, distance map and distance levels computed once
+  *
+  * Force fields and net force vectors for any number of force distributions can then be
+  * requested without repeating the boundary scan or the breadth-first search. A ForceMap
+  * is immutable after construction, so it can be shared between threads.
+  *
+  * A ForceMap on more than one thread starts its threads once and keeps them, shared
+  * with its copies. A call made while another thread is using them runs on the calling
+  * thread alone instead, with the same result.
+  *
+  * A ForceMap may cover only a region of the image, usually the bounding box of the cell
+  * and nucleus, in which case every array it takes or returns is the size of region()
+  * and only the centroid is given in image coordinates. embed places such arrays back
+  * into the full image. The arrays match those of the whole image exactly, but the
+  * centroid and net force are summed in crop coordinates and can differ from the
+  * whole-image ones in the last bits.
+  */
+class ForceMap {
+public:
+  /**
+    * @brief Compute the boundary, distance map and distance levels of a cell
+    *
+    * @param cell 2D array where 1 is the cell and 0 is everything else
+    * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+    * @param threads number of threads to search and propagate with, 0 for one per hardware core
+    */
+  ForceMap(GridView<const int> cell, GridView<const int> nucleus, unsigned threads = 1);
+
+  /**
+    * @brief Compute the boundary, distance map and distance levels of a cell cut to region of the image
+    *
+    * @param cell 2D array the size of region where 1 is the cell and 0 is everything else
+    * @param nucleus 2D array the size of region where 1 is the nucleus and 0 is everything else
+    * @param region where cell and nucleus sit in the image
+    * @param threads number of threads to search and propagate with, 0 for one per hardware core
+    * @throws std::invalid_argument if cell is not the size of region
+    */
+  ForceMap(GridView<const int> cell, GridView<const int> nucleus, const Region& region, unsigned threads = 1);
+
+  /**
+    * @brief Compute the boundary, distance map and distance levels on the bounding box of the cell and nucleus
+    *
+    * @param cell 2D array of the whole image where 1 is the cell and 0 is everything else
+    * @param nucleus 2D array of the whole image where 1 is the nucleus and 0 is everything else
+    * @param threads number of threads to search and propagate with, 0 for one per hardware core
+    */
+  static ForceMap cropped(GridView<const int> cell, GridView<const int> nucleus, unsigned threads = 1);
+
+  int rows() const { return cell_.rows(); }
+  int cols() const { return cell_.cols(); }
+
+  /**
+    * @brief Region of the image the arrays cover, all of it unless constructed on a crop
+    */
+  const Region& region() const { return region_; }
+
+  /**
+    * @brief 2D array where 1 is the cell and 0 is everything else
+    */
+  const Grid<int>& cell() const { return cell_; }
+
+  /**
+    * @brief 2D array where 1 is the nucleus and 0 is everything else
+    */
+  const Grid<int>& nucleus() const { return nucleus_; }
+
+  /**
+    * @brief Outer boundary of the cell, as found by find_boundary
+    */
+  const Grid<int>& boundary() const { return boundary_; }
+
+  /**
+    * @brief Distance from the nucleus to every point in the cell, as found by find_dist
+    */
+  const Grid<int>& dist() const { return dist_; }
+
+  /**
+    * @brief Pixels of the distance map bucketed by distance
+    */
+  const DistanceLevels& levels() const { return levels_; }
+
+  /**
+    * @brief Find the force on the nucleus due to an equal force on every boundary pixel
+    *
+    * @return 2D double array of the force on each pixel on nucleus
+    */
+  Grid<double> nucleus_force() const;
+
+  /**
+    * @brief Find the force on the nucleus due to the pixels with applied force
+    *
+    * @param force 2D array containing the force exerted on the nucleus due to each pixel
+    *
+    * @return 2D double array of the force on each pixel on nucleus
+    */
+  Grid<double> nucleus_force(GridView<const double> force) const;
+
+  /**
+    * @brief Find the force on the nucleus due to the pixels with applied force
+    *
+    * @param force force exerted on the nucleus due to each pixel, stored only where it is non-zero
+    *
+    * @return 2D double array of the force on each pixel on nucleus
+    */
+  Grid<double> nucleus_force(const SparseGrid<double>& force) const;
+
+  /**
+    * @brief Find the force on the nucleus due to an equal force on every boundary pixel, keeping only non-zero pixels
+    *
+    * @return force on each pixel on nucleus, identical to nucleus_force
+    */
+  SparseGrid<double> sparse_nucleus_force() const;
+
+  /**
+    * @brief Build the linear operator from force on the boundary to force on the nucleus
+    *
+    * Meant for evaluating many boundary force distributions on the same geometry. Boundary
+    * pixels that are also nucleus need force in every field it is applied to.
+    */
+  TransferOperator transfer_operator() const;
+
+  /**
+    * @brief Find the nucleus centroid
+    *
+    * @return vector of 2 elements (x, y) of the centroid in image coordinates
+    */
+  std::vector<double> centroid() const;
+
+  /**
+    * @brief Find the net force on the nucleus due to an equal force on every boundary pixel
+    *
+    * @return vector of 2 elements (x, y) of the net force on the nucleus
+    */
+  std::vector<double> force_vector() const;
+
+  /**
+    * @brief Find the net force on the nucleus due to the pixels with applied force
+    *
+    * @param force 2D array containing the force exerted on the nucleus due to each pixel
+    *
+    * @return vector of 2 elements (x, y) of the net force on the nucleus
+    */
+  std::vector<double> force_vector(GridView<const double> force) const;
+
+  /**
+    * @brief Find the net force on the nucleus due to the pixels with applied force
+    *
+    * @param force force exerted on the nucleus due to each pixel, stored only where it is non-zero
+    *
+    * @return vector of 2 elements (x, y) of the net force on the nucleus
+    */
+  std::vector<double> force_vector(const SparseGrid<double>& force) const;
+
+  /**
+    * @brief Find the centroid, net force and force moments of the nucleus due to an equal force on every boundary pixel
+    *
+    * The nucleus pixels are already listed as the first distance level, so only they are
+    * read. The centroid is in image coordinates.
+    */
+  ForceMoments force_moments() const;
+
+  /**
+    * @brief Find the centroid, net force and force moments of the nucleus due to the pixels with applied force
+    *
+    * @param force 2D array containing the force exerted on the nucleus due to each pixel
+    */
+  ForceMoments force_moments(GridView<const double> force) const;
+
+private:
+  struct Workers;
+
+  /**
+    * @brief Moments of force that has already been propagated
+    */
+  ForceMoments moments_of(GridView<const double> propagated) const;
+
+  /**
+    * @brief Run body with the kept threads, or with the calling thread alone if they are busy
+    */
+  void with_pool(const std::function<void(ThreadPool&)>& body) const;
+
+  Grid<int> cell_; ///< Copy of the cell mask
+  Grid<int> nucleus_; ///< Copy of the nucleus mask
+  Grid<int> boundary_; ///< Outer boundary of the cell
+  Grid<int> dist_; ///< Distance from the nucleus, -1 where unreached
+  DistanceLevels levels_; ///< Pixels of dist_ bucketed by distance
+  Region region_; ///< Region of the image covered by the arrays
+  unsigned threads_; ///< Threads used for each propagation
+  std::shared_ptr<Workers> workers_; ///< Threads kept between calls, null on one thread
+}; // class ForceMap
+} // namespace nucleusforce
+
+#endif // FORCE_MAP_H
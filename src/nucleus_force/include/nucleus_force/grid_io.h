@@ -0,0 +1,117 @@
+#ifndef GRID_IO_H
+#define GRID_IO_H
+
+#include <common/grid.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace nucleusforce {
+/**
+  * @brief Element type stored in a binary grid file
+  */
+enum class GridType : uint32_t {
+  Int32 = 1, ///< int, written as little-endian 32-bit integers
+  Float64 = 2, ///< double, written as little-endian IEEE 754 doubles
+};
+
+/**
+  * @brief Output the array as a NumPy .npy file at filepath
+  *
+  * The file holds a C-ordered 2D array of '<i4' that numpy.load can read, including
+  * with mmap_mode. The data starts on a 64-byte boundary.
+  *
+  * @param filepath string of the filepath for the .npy file
+  * @param array array to export
+  */
+void export_npy(const std::string& filepath, GridView<const int> array);
+
+/**
+  * @brief Output the array as a NumPy .npy file of '<f8' at filepath
+  *
+  * @param filepath string of the filepath for the .npy file
+  * @param array array to export
+  */
+void export_npy(const std::string& filepath, GridView<const double> array);
+
+/**
+  * @brief Output the array as a raw binary grid at filepath
+  *
+  * The file is a 64-byte header followed by the elements in row-major order:
+  *
+  *   bytes 0-7   magic "NFGRID\0\0"
+  *   bytes 8-11  format version, currently 1 (uint32)
+  *   bytes 12-15 element type, a GridType (uint32)
+  *   bytes 16-23 rows (int64)
+  *   bytes 24-31 columns (int64)
+  *   bytes 32-63 zero
+  *
+  * All numbers are little-endian.
+  *
+  * @param filepath string of the filepath for the grid file
+  * @param array array to export
+  */
+void export_raw(const std::string& filepath, GridView<const int> array);
+
+/**
+  * @brief Output the array as a raw binary grid of doubles at filepath
+  *
+  * @param filepath string of the filepath for the grid file
+  * @param array array to export
+  */
+void export_raw(const std::string& filepath, GridView<const double> array);
+
+/**
+  * @brief Grid file written by export_npy or export_raw, memory-mapped read-only
+  *
+  * Nothing is parsed or copied past the header; the pages of the file are read in as
+  * the view is used.
+  */
+class MappedGrid {
+public:
+  /**
+    * @brief Map the file at filepath
+    *
+    * @throws std::runtime_error if the file cannot be opened or mapped
+    * @throws std::invalid_argument if it is not a 2D grid written by export_npy or export_raw
+    */
+  explicit MappedGrid(const std::string& filepath);
+
+  ~MappedGrid();
+
+  MappedGrid(const MappedGrid&) = delete;
+  MappedGrid& operator=(const MappedGrid&) = delete;
+  MappedGrid(MappedGrid&& other) noexcept;
+  MappedGrid& operator=(MappedGrid&& other) noexcept;
+
+  GridType type() const { return type_; }
+  int rows() const { return rows_; }
+  int cols() const { return cols_; }
+
+  /**
+    * @brief View of the elements, which are valid while the MappedGrid is alive
+    *
+    * @throws std::invalid_argument if T does not match type()
+    */
+  template <typename T>
+  GridView<const T> view() const;
+
+private:
+  void unmap();
+
+  void* mapping_ = nullptr; ///< Start of the mapped file
+  size_t size_ = 0; ///< Length of the mapping in bytes
+  const unsigned char* data_ = nullptr; ///< First element
+  GridType type_ = GridType::Int32;
+  int rows_ = 0;
+  int cols_ = 0;
+}; // class MappedGrid
+
+template <>
+GridView<const int> MappedGrid::view<int>() const;
+
+template <>
+GridView<const double> MappedGrid::view<double>() const;
+} // namespace nucleusforce
+
+#endif // GRID_IO_H
@@ -0,0 +1,135 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <common/grid.h>
+#include <vector>
+
+namespace nucleusforce {
+/**
+  * @brief How much of the geometry an IncrementalForceMap::update had to recompute
+  */
+struct UpdateStats {
+  int changed = 0; ///< Pixels whose cell or nucleus value changed
+  int dist_changed = 0; ///< Pixels whose distance changed
+  int flux_changed = 0; ///< Pixels whose flux changed
+  bool full = false; ///< Whether the force had to be propagated over the whole cell
+};
+
+/**
+  * @brief New cell and nucleus value of one pixel between frames
+  */
+struct PixelChange {
+  int y;
+  int x;
+  int cell; ///< 1 if the pixel is now cell, 0 otherwise
+  int nucleus; ///< 1 if the pixel is now nucleus, 0 otherwise
+};
+
+/**
+  * @brief Boundary force on a nucleus, kept up to date as the cell and nucleus change
+  *
+  * Meant for consecutive frames of a time-lapse, where only small parts of the masks
+  * change between frames. Each update repairs the boundary and distance map around the
+  * changed pixels and re-propagates force only below the pixels whose flux (the total
+  * force passing through them) changed. The results are identical to find_boundary,
+  * find_dist and find_nucleus_force on the new masks.
+  *
+  * Force that starts on a pixel that is both cell and nucleus can move along the
+  * nucleus, so while any such pixel is on the boundary the force is propagated over the
+  * whole cell instead.
+  */
+class IncrementalForceMap {
+public:
+  /**
+    * @brief Compute the boundary, distance map and boundary force of the first frame
+    *
+    * @param cell 2D array where 1 is the cell and 0 is everything else
+    * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+    */
+  IncrementalForceMap(GridView<const int> cell, GridView<const int> nucleus);
+
+  /**
+    * @brief Move on to the next frame
+    *
+    * Compares every pixel with the current frame to find the changes, so use the
+    * overload taking the changed pixels when they are already known.
+    *
+    * @param cell 2D array where 1 is the cell and 0 is everything else, the same size as the first frame
+    * @param nucleus 2D array where 1 is the nucleus and 0 is everything else, the same size as the first frame
+    *
+    * @return how much had to be recomputed
+    */
+  UpdateStats update(GridView<const int> cell, GridView<const int> nucleus);
+
+  /**
+    * @brief Move on to the next frame given only the pixels that changed
+    *
+    * Costs time in proportion to the pixels near the changes and the force below them,
+    * not to the size of the image. Changes that leave a pixel as it was are ignored,
+    * and the last change of a pixel listed more than once wins.
+    *
+    * @param changes new cell and nucleus values of the changed pixels
+    *
+    * @return how much had to be recomputed
+    * @throws std::invalid_argument if a change is outside the frame
+    */
+  UpdateStats update(const std::vector<PixelChange>& changes);
+
+  int rows() const { return cell_.rows(); }
+  int cols() const { return cell_.cols(); }
+
+  const Grid<int>& cell() const { return cell_; }
+  const Grid<int>& nucleus() const { return nucleus_; }
+
+  /**
+    * @brief Outer boundary of the cell, as found by find_boundary
+    */
+  const Grid<int>& boundary() const { return boundary_; }
+
+  /**
+    * @brief Distance from the nucleus to every point in the cell, as found by find_dist
+    */
+  const Grid<int>& dist() const { return dist_; }
+
+  /**
+    * @brief Total boundary force passing through each pixel, as found by find_flux
+    */
+  const Grid<double>& flux() const { return flux_; }
+
+  /**
+    * @brief Force on each pixel of the nucleus, as found by find_nucleus_force
+    */
+  const Grid<double>& nucleus_force() const { return force_; }
+
+  /**
+    * @brief Find the nucleus centroid
+    *
+    * @return vector of 2 elements (x, y) of the centroid
+    */
+  std::vector<double> centroid() const;
+
+  /**
+    * @brief Find the net force on the nucleus
+    *
+    * @return vector of 2 elements (x, y) of the net force on the nucleus
+    */
+  std::vector<double> force_vector() const;
+
+private:
+  void propagate_all();
+  bool overlap_force(int y, int x) const;
+
+  Grid<int> cell_; ///< Cell mask of the current frame
+  Grid<int> nucleus_; ///< Nucleus mask of the current frame
+  Grid<int> boundary_; ///< Outer boundary of the cell
+  Grid<double> boundary_force_; ///< Force of 1 on every boundary pixel
+  Grid<int> dist_; ///< Distance from the nucleus, -1 where unreached
+  Grid<double> flux_; ///< Boundary force passing through each pixel
+  Grid<double> force_; ///< Force on each pixel of the nucleus
+  int overlap_ = 0; ///< Boundary pixels that are also nucleus
+  bool force_from_flux_ = true; ///< Whether force_ is the flux on the nucleus
+  std::vector<unsigned char> marks_; ///< One zero element per pixel, set and cleared again by each update
+}; // class IncrementalForceMap
+} // namespace nucleusforce
+
+#endif // INCREMENTAL_H
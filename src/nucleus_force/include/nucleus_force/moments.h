@@ -0,0 +1,68 @@
+#ifndef MOMENTS_H
+#define MOMENTS_H
+
+#include <common/grid.h>
+#include <common/thread_pool.h>
+#include <vector>
+
+namespace nucleusforce {
+/**
+  * @brief Centroid of the nucleus and the moments of the force on it
+  *
+  * Each nucleus pixel p with force f is pulled by f along the unit vector from p to the
+  * centroid c, F(p) = f (c - p) / |c - p|, as in find_force_vector. With r = p - c,
+  * moment_ab is the sum of r_a F_b over the nucleus, the first moment of the force
+  * (the force dipole, or the stress the nucleus carries times its area).
+  */
+struct ForceMoments {
+  int pixels = 0; ///< Number of nucleus pixels
+  double centroid_x = 0; ///< x of the centroid
+  double centroid_y = 0; ///< y of the centroid
+  double force_x = 0; ///< x of the net force, find_force_vector's first element up to rounding
+  double force_y = 0; ///< y of the net force, find_force_vector's second element up to rounding
+  double moment_xx = 0; ///< Sum of r_x F_x
+  double moment_xy = 0; ///< Sum of r_x F_y
+  double moment_yx = 0; ///< Sum of r_y F_x
+  double moment_yy = 0; ///< Sum of r_y F_y
+
+  std::vector<double> centroid() const { return {centroid_x, centroid_y}; }
+  std::vector<double> force_vector() const { return {force_x, force_y}; }
+
+  /**
+    * @brief Net torque about the centroid, r_x F_y - r_y F_x summed over the nucleus
+    *
+    * Every pixel's force points at the centroid, so under this model it is zero up to
+    * rounding.
+    */
+  double torque() const { return moment_xy - moment_yx; }
+};
+
+/**
+  * @brief Find the centroid, net force and force moments of the nucleus from a list of its pixels
+  *
+  * The centroid is summed exactly in integers, then one pass over the pixels finds the
+  * rest. The pixels are cut into fixed blocks of 1024, which are split across the pool and
+  * each summed in order. The block sums are then added in pairs, so the result is the same
+  * for any number of threads.
+  *
+  * @param begin first of the row-major linear indices (y * cols + x) of the nucleus pixels,
+  *        such as levels.begin(0) of build_levels
+  * @param end one past the last nucleus pixel
+  * @param force 2D array of the force exerted on each pixel on the outer surface of the nucleus
+  * @param pool threads to split the blocks across
+  */
+ForceMoments find_force_moments(const int* begin, const int* end, GridView<const double> force, ThreadPool& pool);
+
+/**
+  * @brief Find the centroid, net force and force moments of the nucleus
+  *
+  * The nucleus is scanned once to list its pixels, and the force is only read on them.
+  *
+  * @param nucleus 2D array where 1 is the nucleus and 0 is anything else
+  * @param force 2D array of the force exerted on each pixel on the outer surface of the nucleus
+  * @param threads number of threads to sum with, 0 for one per hardware core
+  */
+ForceMoments find_force_moments(GridView<const int> nucleus, GridView<const double> force, unsigned threads = 1);
+} // namespace nucleusforce
+
+#endif // MOMENTS_H
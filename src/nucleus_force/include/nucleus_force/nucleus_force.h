@@ -1,8 +1,15 @@
 #ifndef NUCLEUS_FORCE_H
 #define NUCLEUS_FORCE_H
 
+#include <common/bit_mask.h>
+#include <common/grid.h>
+#include <common/sparse_grid.h>
+#include <nucleus_force/connectivity.h>
+#include <nucleus_force/workspace.h>
+#include <cstdint>
 #include <vector>
 #include <string>
+#include <utility>
 
 namespace nucleusforce {
 /**
@@ -11,16 +18,134 @@ namespace nucleusforce {
   * @param cell 2D array where 1 is the cell and 0 is everything else
   * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
   */
-std::vector<std::vector<int>> find_dist(std::vector<std::vector<int>> cell,
-                                        std::vector<std::vector<int>> nucleus);
+Grid<int> find_dist(GridView<const int> cell, GridView<const int> nucleus);
+
+/**
+  * @brief Find the distance from any point on the nucleus to all points in the cell
+  *
+  * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+  */
+std::vector<std::vector<int>> find_dist(const std::vector<std::vector<int>>& cell,
+                                        const std::vector<std::vector<int>>& nucleus);
+
+/**
+  * @brief Find the distance from any point on the nucleus to all points in the cell using several threads
+  *
+  * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+  * @param threads number of threads to search with, 0 for one per hardware core
+  */
+Grid<int> find_dist(GridView<const int> cell, GridView<const int> nucleus, unsigned threads);
+
+/**
+  * @brief Find the distance from any point on the nucleus to all points in the cell, reusing a workspace
+  *
+  * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+  * @param workspace buffers to search in, reused from earlier calls
+  *
+  * @return workspace.dist, identical to find_dist without a workspace
+  */
+const Grid<int>& find_dist(GridView<const int> cell, GridView<const int> nucleus, Workspace& workspace);
+
+/**
+  * @brief Find the distance from the nucleus to all points in the cell stepping to the neighbours of connectivity C
+  *
+  * Unreached pixels hold unreached_distance<Dist>(). Instantiated for Four and Eight with
+  * int and uint16_t distances; find_dist<Connectivity::Four, int> is find_dist.
+  *
+  * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+  * @throws std::invalid_argument if a distance does not fit in Dist
+  */
+template <Connectivity C, typename Dist = int>
+Grid<Dist> find_dist(GridView<const int> cell, GridView<const int> nucleus);
 
 /**
   * @brief Find the outer boundary of the cell
   *
   * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
   */
-std::vector<std::vector<int>> find_boundary(std::vector<std::vector<int>> cell,
-                                            std::vector<std::vector<int>> nucleus);
+Grid<int> find_boundary(GridView<const int> cell, GridView<const int> nucleus);
+
+/**
+  * @brief Find the outer boundary of the cell
+  *
+  * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+  */
+std::vector<std::vector<int>> find_boundary(const std::vector<std::vector<int>>& cell,
+                                            const std::vector<std::vector<int>>& nucleus);
+
+/**
+  * @brief Find the outer boundary of the cell, reusing a workspace
+  *
+  * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+  * @param workspace buffers to find the boundary in
+  *
+  * @return workspace.boundary, identical to find_boundary without a workspace
+  */
+const Grid<int>& find_boundary(GridView<const int> cell, GridView<const int> nucleus, Workspace& workspace);
+
+/**
+  * @brief Find the outer boundary of the cell for connectivity C
+  *
+  * Four is find_boundary, which tests six of the eight neighbours of each pixel for
+  * background; Eight tests all of them.
+  *
+  * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+  */
+template <Connectivity C>
+Grid<int> find_boundary(GridView<const int> cell, GridView<const int> nucleus);
+
+/**
+  * @brief Whether one pixel is on the outer boundary of the cell, as found by find_boundary
+  *
+  * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+  * @param y row of the pixel
+  * @param x column of the pixel
+  */
+bool is_boundary(GridView<const int> cell, GridView<const int> nucleus, int y, int x);
+
+/**
+  * @brief Find the smallest region holding the cell and nucleus, grown by halo pixels on every side
+  *
+  * With a halo of at least 1 the boundary, distance map and force found on the region are
+  * those of the full arrays cut to the region, since everything outside it is background.
+  * The region is clipped to the arrays, and is empty if there is no cell or nucleus.
+  *
+  * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+  * @param halo pixels of background kept around the cell and nucleus
+  */
+Region find_bounding_box(GridView<const int> cell, GridView<const int> nucleus, int halo = 1);
+
+/**
+  * @brief Find the outer boundary of the cell 64 pixels at a time
+  *
+  * Same boundary as the 2D array version, found with shifts, ANDs and ORs of whole
+  * rows of packed pixels.
+  *
+  * @param cell mask of the cell
+  * @param nucleus mask of the nucleus
+  */
+BitMask find_boundary(const BitMask& cell, const BitMask& nucleus);
+
+/**
+ * @brief Find the force on the nucleus due to the outer boundary of the cell
+ *        Note: This method assumes an equal force is exerted on all points on the outer boundary of the cell.
+ *
+ * @param cell 2D array where 1 is the cell and 0 is everything else
+ * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+ *
+ * @return 2D double array of the force on each pixel on nucleus
+ */
+Grid<double> find_nucleus_force(GridView<const int> cell, GridView<const int> nucleus);
 
 /**
  * @brief Find the force on the nucleus due to the outer boundary of the cell
@@ -31,8 +156,21 @@ std::vector<std::vector<int>> find_boundary(std::vector<std::vector<int>> cell,
  *
  * @return 2D double array of the force on each pixel on nucleus
  */
-std::vector<std::vector<double>> find_nucleus_force(std::vector<std::vector<int>> cell, 
-                                                    std::vector<std::vector<int>> nucleus);
+std::vector<std::vector<double>> find_nucleus_force(const std::vector<std::vector<int>>& cell,
+                                                    const std::vector<std::vector<int>>& nucleus);
+
+/**
+ * @brief Find the force on the nucleus due to the pixels with applied force
+ *
+ * @param cell 2D array where 1 is the cell and 0 is everything else
+ * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+ * @param force 2D array containing the force exerted on the nucleus due to each pixel
+ *
+ * @return 2D double array of the force on each pixel on nucleus
+ */
+Grid<double> find_nucleus_force(GridView<const int> cell,
+                                GridView<const int> nucleus,
+                                GridView<const double> force);
 
 /**
  * @brief Find the force on the nucleus due to the pixels with applied force
@@ -43,9 +181,173 @@ std::vector<std::vector<double>> find_nucleus_force(std::vector<std::vector<int>
  *
  * @return 2D double array of the force on each pixel on nucleus
  */
-std::vector<std::vector<double>> find_nucleus_force(std::vector<std::vector<int>> cell, 
-                                                    std::vector<std::vector<int>> nucleus, 
-                                                    std::vector<std::vector<double>> force);
+std::vector<std::vector<double>> find_nucleus_force(const std::vector<std::vector<int>>& cell,
+                                                    const std::vector<std::vector<int>>& nucleus,
+                                                    const std::vector<std::vector<double>>& force);
+
+/**
+ * @brief Find the force on the nucleus due to the outer boundary of the cell using several threads
+ *
+ * @param cell 2D array where 1 is the cell and 0 is everything else
+ * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+ * @param threads number of threads to propagate with, 0 for one per hardware core
+ *
+ * @return 2D double array of the force on each pixel on nucleus, identical for any thread count
+ */
+Grid<double> find_nucleus_force(GridView<const int> cell, GridView<const int> nucleus, unsigned threads);
+
+/**
+ * @brief Find the force on the nucleus due to the pixels with applied force using several threads
+ *
+ * @param cell 2D array where 1 is the cell and 0 is everything else
+ * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+ * @param force 2D array containing the force exerted on the nucleus due to each pixel
+ * @param threads number of threads to propagate with, 0 for one per hardware core
+ *
+ * @return 2D double array of the force on each pixel on nucleus, identical for any thread count
+ */
+Grid<double> find_nucleus_force(GridView<const int> cell,
+                                GridView<const int> nucleus,
+                                GridView<const double> force,
+                                unsigned threads);
+
+/**
+ * @brief Find the force on the nucleus due to the outer boundary of the cell, reusing a workspace
+ *
+ * The boundary, distance map and force are all left in the workspace, so a caller that
+ * needs them too does not have to find them again.
+ *
+ * @param cell 2D array where 1 is the cell and 0 is everything else
+ * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+ * @param workspace buffers to propagate in, reused from earlier calls
+ *
+ * @return workspace.force, identical to find_nucleus_force without a workspace
+ */
+const Grid<double>& find_nucleus_force(GridView<const int> cell, GridView<const int> nucleus, Workspace& workspace);
+
+/**
+ * @brief Find the force on the nucleus due to the pixels with applied force, reusing a workspace
+ *
+ * @param cell 2D array where 1 is the cell and 0 is everything else
+ * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+ * @param force 2D array containing the force exerted on the nucleus due to each pixel; must
+ *        not be a view of the workspace's own buffers
+ * @param workspace buffers to propagate in
+ *
+ * @return workspace.force, identical to find_nucleus_force without a workspace
+ */
+const Grid<double>& find_nucleus_force(GridView<const int> cell,
+                                       GridView<const int> nucleus,
+                                       GridView<const double> force,
+                                       Workspace& workspace);
+
+/**
+ * @brief Find the force on the nucleus due to the pixels with applied force
+ *
+ * @param cell 2D array where 1 is the cell and 0 is everything else
+ * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+ * @param force force exerted on the nucleus due to each pixel, stored only where it is non-zero
+ *
+ * @return 2D double array of the force on each pixel on nucleus
+ */
+Grid<double> find_nucleus_force(GridView<const int> cell,
+                                GridView<const int> nucleus,
+                                const SparseGrid<double>& force);
+
+/**
+ * @brief Find the force on the nucleus due to the outer boundary of the cell, keeping only non-zero pixels
+ *
+ * The result holds one element per nucleus pixel that the force reaches, so it scales
+ * with the size of the nucleus rather than of the image.
+ *
+ * @param cell 2D array where 1 is the cell and 0 is everything else
+ * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+ * @param threads number of threads to propagate with, 0 for one per hardware core
+ *
+ * @return force on each pixel on nucleus, identical to find_nucleus_force
+ */
+SparseGrid<double> find_sparse_nucleus_force(GridView<const int> cell, GridView<const int> nucleus,
+                                             unsigned threads = 1);
+
+/**
+ * @brief How the distance from the nucleus that force follows is measured
+ */
+enum class DistanceMetric {
+  CityBlock, ///< 4-connected steps, as find_dist
+  Euclidean, ///< Straight lines, as find_euclidean_dist
+  Geodesic ///< Shortest paths inside the cell, as find_geodesic_dist
+};
+
+/**
+ * @brief Find the force on the nucleus due to the outer boundary of the cell with a chosen distance metric
+ *
+ * CityBlock is find_nucleus_force. The other metrics carry the force down their distance
+ * maps with propagate_force_downhill, so it no longer favours paths along the axes.
+ *
+ * @param cell 2D array where 1 is the cell and 0 is everything else
+ * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+ * @param metric distance the force follows to the nucleus
+ * @param threads number of threads, 0 for one per hardware core; only CityBlock and Euclidean use them
+ *
+ * @return 2D double array of the force on each pixel on nucleus
+ */
+Grid<double> find_nucleus_force(GridView<const int> cell,
+                                GridView<const int> nucleus,
+                                DistanceMetric metric,
+                                unsigned threads = 1);
+
+/**
+ * @brief Find the force on the nucleus due to the outer boundary of the cell for a chosen connectivity and precision
+ *
+ * The boundary, distance search and propagation all use the neighbours of C. uint16_t
+ * distances and float force halve the memory the search and propagation stream through,
+ * for cells less than 65535 pixels deep. Instantiated for Four and Eight, int and
+ * uint16_t distances and float and double force; Four with int and double is
+ * find_nucleus_force.
+ *
+ * @param cell 2D array where 1 is the cell and 0 is everything else
+ * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+ *
+ * @return 2D array of the force on each pixel on nucleus
+ */
+template <Connectivity C, typename Dist = int, typename Force = double>
+Grid<Force> find_nucleus_force(GridView<const int> cell, GridView<const int> nucleus);
+
+/**
+ * @brief Find the force on the nucleus due to the pixels with applied force for a chosen connectivity and precision
+ *
+ * @param cell 2D array where 1 is the cell and 0 is everything else
+ * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+ * @param force 2D array containing the force exerted on the nucleus due to each pixel
+ *
+ * @return 2D array of the force on each pixel on nucleus
+ */
+template <Connectivity C, typename Dist = int, typename Force = double>
+Grid<Force> find_nucleus_force(GridView<const int> cell, GridView<const int> nucleus, GridView<const Force> force);
+
+/**
+ * @brief Find the force on the nucleus due to the pixels with applied force, keeping only non-zero pixels
+ *
+ * @param cell 2D array where 1 is the cell and 0 is everything else
+ * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+ * @param force force exerted on the nucleus due to each pixel, stored only where it is non-zero
+ * @param threads number of threads to propagate with, 0 for one per hardware core
+ *
+ * @return force on each pixel on nucleus, identical to find_nucleus_force
+ */
+SparseGrid<double> find_sparse_nucleus_force(GridView<const int> cell,
+                                             GridView<const int> nucleus,
+                                             const SparseGrid<double>& force,
+                                             unsigned threads = 1);
+
+/**
+ * @brief Find the nucleus centroid
+ *
+ * @param nucleus nucleus
+ *
+ * @return vector of 2 elements (x, y) of the centroid
+ */
+std::vector<double> find_nucleus_centroid(GridView<const int> nucleus);
 
 /**
  * @brief Find the nucleus centroid
@@ -54,7 +356,18 @@ std::vector<std::vector<double>> find_nucleus_force(std::vector<std::vector<int>
  *
  * @return vector of 2 elements (x, y) of the centroid
  */
-std::vector<double> find_nucleus_centroid(std::vector<std::vector<int>> nucleus);
+std::vector<double> find_nucleus_centroid(const std::vector<std::vector<int>>& nucleus);
+
+/**
+ * @brief Find the force vector on the nucleus
+ *
+ * @param nucleus 2D array where 1 is the nucleus and 0 is anything else
+ * @param force 2D array of the force exerted on each pixel on the outer surface of the nucleus
+ *
+ * @return vector of 2 elements (x, y) of the net force on the nucleus
+ */
+std::vector<double> find_force_vector(GridView<const int> nucleus,
+                                      GridView<const double> force);
 
 /**
  * @brief Find the force vector on the nucleus
@@ -64,8 +377,113 @@ std::vector<double> find_nucleus_centroid(std::vector<std::vector<int>> nucleus)
  *
  * @return vector of 2 elements (x, y) of the net force on the nucleus
  */
-std::vector<double> find_force_vector(std::vector<std::vector<int>> nucleus,
-                                      std::vector<std::vector<double>> force);
+std::vector<double> find_force_vector(const std::vector<std::vector<int>>& nucleus,
+                                      const std::vector<std::vector<double>>& force);
+
+/**
+ * @brief Find the force vector on the nucleus, visiting only the pixels with force
+ *
+ * Matches find_force_vector of the dense force up to rounding, since the terms are
+ * added in a different order.
+ *
+ * @param nucleus 2D array where 1 is the nucleus and 0 is anything else
+ * @param force force exerted on each pixel on the outer surface of the nucleus, stored only where it is non-zero
+ *
+ * @return vector of 2 elements (x, y) of the net force on the nucleus
+ */
+std::vector<double> find_force_vector(GridView<const int> nucleus, const SparseGrid<double>& force);
+
+/**
+ * @brief Find the force vector on the nucleus from single-precision force, summed in double
+ *
+ * @param nucleus 2D array where 1 is the nucleus and 0 is anything else
+ * @param force 2D array of the force exerted on each pixel on the outer surface of the nucleus
+ *
+ * @return vector of 2 elements (x, y) of the net force on the nucleus
+ */
+std::vector<double> find_force_vector(GridView<const int> nucleus, GridView<const float> force);
+
+/**
+ * @brief Find the force vector on the nucleus into a workspace
+ *
+ * @param nucleus 2D array where 1 is the nucleus and 0 is anything else
+ * @param force 2D array of the force exerted on each pixel on the outer surface of the nucleus,
+ *        such as the workspace's own force
+ * @param workspace workspace to hold the result
+ *
+ * @return workspace.force_vector, identical to find_force_vector without a workspace
+ */
+const std::vector<double>& find_force_vector(GridView<const int> nucleus,
+                                             GridView<const double> force,
+                                             Workspace& workspace);
+
+/**
+ * @brief Find the net force on the nucleus due to the outer boundary of the cell without building the force field
+ *
+ * Same result as find_force_vector of find_nucleus_force up to rounding, for jobs that
+ * only need the vector. The centroid is found while seeding the distance search, the
+ * boundary is tested as each distance level is loaded, and force is carried one level
+ * at a time, so no grid of doubles is ever allocated.
+ *
+ * @param cell 2D array where 1 is the cell and 0 is everything else
+ * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+ *
+ * @return vector of 2 elements (x, y) of the net force on the nucleus
+ */
+std::vector<double> find_net_force(GridView<const int> cell, GridView<const int> nucleus);
+
+/**
+ * @brief Find the net force on the nucleus due to the pixels with applied force without building the force field
+ *
+ * @param cell 2D array where 1 is the cell and 0 is everything else
+ * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+ * @param force 2D array containing the force exerted on the nucleus due to each pixel
+ *
+ * @return vector of 2 elements (x, y) of the net force on the nucleus
+ */
+std::vector<double> find_net_force(GridView<const int> cell,
+                                   GridView<const int> nucleus,
+                                   GridView<const double> force);
+
+/**
+ * @brief How much a unit of force on each pixel adds to the net force on the nucleus
+ */
+struct ForceSensitivity {
+  Grid<double> x; ///< Change of the x component of find_force_vector per unit of force on each pixel
+  Grid<double> y; ///< Change of the y component of find_force_vector per unit of force on each pixel
+};
+
+/**
+ * @brief Find how much force on each pixel adds to the net force on the nucleus
+ *
+ * Propagation and the net force are both linear in the force, so the net force is the
+ * sum of force times sensitivity over every pixel. The sensitivities are found with one
+ * reverse pass over the distance levels from the nucleus outwards rather than one
+ * propagation per pixel.
+ *
+ * @param cell 2D array where 1 is the cell and 0 is everything else
+ * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+ * @param force 2D array containing the force exerted on the nucleus due to each pixel; only
+ *        decides which pixels that are both cell and nucleus pass their force on
+ * @param threads number of threads to search and walk the levels with, 0 for one per hardware core
+ *
+ * @return x and y sensitivity of every pixel
+ */
+ForceSensitivity find_force_sensitivity(GridView<const int> cell,
+                                        GridView<const int> nucleus,
+                                        GridView<const double> force,
+                                        unsigned threads = 1);
+
+/**
+ * @brief Find how much force on each pixel adds to the net force on the nucleus when force is applied to the outer boundary
+ *
+ * @param cell 2D array where 1 is the cell and 0 is everything else
+ * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+ * @param threads number of threads to search and walk the levels with, 0 for one per hardware core
+ *
+ * @return x and y sensitivity of every pixel
+ */
+ForceSensitivity find_force_sensitivity(GridView<const int> cell, GridView<const int> nucleus, unsigned threads = 1);
 
 /**
  * @brief Create a coord and distance pair
@@ -74,7 +492,25 @@ std::vector<double> find_force_vector(std::vector<std::vector<int>> nucleus,
  * @param x x coordinate
  * @param d distance
  */
-inline std::pair<int, std::pair<int, int>> make_coord(int y, int x, int d);
+inline std::pair<int, std::pair<int, int>> make_coord(int y, int x, int d) {
+  return std::make_pair(d, std::make_pair(y, x));
+}
+
+/**
+  * @brief Output the array as a csv at filepath
+  *
+  * @param filepath string of the filepath for the csv
+  * @param array array to export
+  */
+void export_csv(const std::string& filepath, GridView<const int> array);
+
+/**
+  * @brief Output the array as a csv at filepath
+  *
+  * @param filepath string of the filepath for the csv
+  * @param array array to export
+  */
+void export_csv(const std::string& filepath, GridView<const double> array);
 
 /**
   * @brief Output the array as a csv at filepath
@@ -82,7 +518,7 @@ inline std::pair<int, std::pair<int, int>> make_coord(int y, int x, int d);
   * @param filepath string of the filepath for the csv
   * @param array array to export
   */
-void export_csv(std::string filepath, std::vector<std::vector<int>> array);
+void export_csv(const std::string& filepath, const std::vector<std::vector<int>>& array);
 
 /**
   * @brief Output the array as a csv at filepath
@@ -90,7 +526,7 @@ void export_csv(std::string filepath, std::vector<std::vector<int>> array);
   * @param filepath string of the filepath for the csv
   * @param array array to export
   */
-void export_csv(std::string filepath, std::vector<std::vector<double>> array);
+void export_csv(const std::string& filepath, const std::vector<std::vector<double>>& array);
 } // namespace nucleusforce
 
 #endif
@@ -0,0 +1,360 @@
+#ifndef PROPAGATION_H
+#define PROPAGATION_H
+
+#include <common/grid.h>
+#include <common/thread_pool.h>
+#include <nucleus_force/connectivity.h>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace nucleusforce {
+/**
+  * @brief Pixels of a distance map bucketed by distance
+  *
+  * Pixels are stored as row-major linear indices (y * cols + x). The pixels at
+  * distance d are pixels[offsets[d]] to pixels[offsets[d + 1] - 1], in ascending order.
+  * Unreached pixels (distance -1, or the largest value of an unsigned distance type) are
+  * not stored.
+  */
+struct DistanceLevels {
+  int rows = 0; ///< Rows of the distance map
+  int cols = 0; ///< Columns of the distance map
+  std::vector<int> offsets = {0}; ///< Start of each level in pixels, plus one past the end
+  std::vector<int> pixels; ///< Linear indices of reached pixels grouped by level
+
+  /**
+    * @brief Number of distinct levels (the largest distance plus one)
+    */
+  int count() const { return static_cast<int>(offsets.size()) - 1; }
+
+  /**
+    * @brief Number of pixels at distance d
+    */
+  int size(int d) const { return offsets[d + 1] - offsets[d]; }
+
+  const int* begin(int d) const { return pixels.data() + offsets[d]; }
+  const int* end(int d) const { return pixels.data() + offsets[d + 1]; }
+};
+
+/**
+  * @brief Bucket the pixels of a distance map by distance using a counting sort
+  *
+  * @param dist distance map from find_dist
+  */
+DistanceLevels build_levels(GridView<const int> dist);
+
+/**
+  * @brief Bucket the pixels of a distance map by distance into existing levels
+  *
+  * Same levels as build_levels(dist), but the storage of levels is reused, so nothing
+  * is allocated once it has held as many pixels and distances.
+  *
+  * @param dist distance map from find_dist
+  * @param levels replaced with the pixels of dist bucketed by distance
+  */
+void build_levels(GridView<const int> dist, DistanceLevels& levels);
+
+/**
+  * @brief Bucket the pixels of a 16-bit distance map by distance using a counting sort
+  *
+  * @param dist distance map from find_dist<C, uint16_t>
+  */
+DistanceLevels build_levels(GridView<const uint16_t> dist);
+
+/**
+  * @brief Bucket the pixels of a 16-bit distance map by distance into existing levels
+  *
+  * @param dist distance map from find_dist<C, uint16_t>
+  * @param levels replaced with the pixels of dist bucketed by distance
+  */
+void build_levels(GridView<const uint16_t> dist, DistanceLevels& levels);
+
+/**
+  * @brief Max-heap of (distance, (y, x)) entries kept with std::push_heap and std::pop_heap
+  *
+  * Pops in the same order as a std::priority_queue of the same entries, but it can be
+  * cleared and refilled without giving back its storage.
+  */
+using PixelHeap = std::vector<std::pair<int, std::pair<int, int>>>;
+
+/**
+  * @brief Propagate force from the cell towards the nucleus one distance level at a time
+  *
+  * Each level is visited once, from the farthest inwards, and every pixel holding force
+  * splits it evenly between its neighbours one level closer to the nucleus. The result
+  * is identical to the priority-queue formulation of find_nucleus_force.
+  *
+  * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+  * @param dist distance map from find_dist
+  * @param levels pixels of dist bucketed by build_levels
+  * @param f force on each pixel, replaced with the propagated force
+  */
+void propagate_force(GridView<const int> cell,
+                     GridView<const int> nucleus,
+                     GridView<const int> dist,
+                     const DistanceLevels& levels,
+                     GridView<double> f);
+
+/**
+  * @brief Propagate force one distance level at a time, queueing overlap pixels in a heap owned by the caller
+  *
+  * Identical to propagate_force, for callers that propagate many times and want to keep
+  * the queue's storage between calls.
+  *
+  * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+  * @param dist distance map from find_dist
+  * @param levels pixels of dist bucketed by build_levels
+  * @param f force on each pixel, replaced with the propagated force
+  * @param queue scratch heap, cleared before use
+  */
+void propagate_force(GridView<const int> cell,
+                     GridView<const int> nucleus,
+                     GridView<const int> dist,
+                     const DistanceLevels& levels,
+                     GridView<double> f,
+                     PixelHeap& queue);
+
+/**
+  * @brief Propagate force one distance level at a time for a chosen connectivity, distance type and force type
+  *
+  * Force is split between the neighbours one level closer in the stencil of C, which must
+  * be the connectivity dist was found with. Each combination is compiled separately with
+  * its stencil unrolled, so nothing is decided per pixel. Instantiated for Four and Eight,
+  * int and uint16_t distances and float and double force; Four with int and double is
+  * the propagate_force above.
+  *
+  * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+  * @param dist distance map from find_dist<C, Dist>
+  * @param levels pixels of dist bucketed by build_levels
+  * @param f force on each pixel, replaced with the propagated force
+  * @param queue scratch heap, cleared before use
+  */
+template <Connectivity C, typename Dist, typename Force>
+void propagate_force(GridView<const int> cell,
+                     GridView<const int> nucleus,
+                     GridView<const Dist> dist,
+                     const DistanceLevels& levels,
+                     GridView<Force> f,
+                     PixelHeap& queue);
+
+/**
+  * @brief Propagate force down any distance map, from the farthest pixel inwards
+  *
+  * Every pixel of the cell passes its force on to the 4-neighbours in the cell or
+  * nucleus with a smaller distance, in proportion to how much smaller it is, so force
+  * follows the slope of the distance map to the nucleus. This works with the real-valued
+  * distances of find_euclidean_dist and find_geodesic_dist, which propagate_force's
+  * levels cannot hold. With find_dist's distances every lower neighbour is one level
+  * closer, and the force is the same as propagate_force's except on pixels that are both
+  * cell and nucleus, whose force stays where it is here.
+  *
+  * Force on a pixel with no lower neighbour, which find_euclidean_dist can leave where
+  * the cell is not convex, is dropped, as is force on cell pixels with a distance of -1.
+  *
+  * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+  * @param dist distance of each pixel from the nucleus, 0 on the nucleus and -1 where it is not reached
+  * @param f force on each pixel, replaced with the propagated force
+  */
+void propagate_force_downhill(GridView<const int> cell,
+                              GridView<const int> nucleus,
+                              GridView<const double> dist,
+                              GridView<double> f);
+
+/**
+  * @brief Propagate force level by level with each level split across a thread pool
+  *
+  * Rather than pushing force down, every pixel one level closer to the nucleus gathers
+  * the shares of its neighbours, so threads never write to the same pixel. Shares are
+  * gathered in the order the serial engine would add them, so the result is identical
+  * to propagate_force for any number of threads.
+  *
+  * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+  * @param dist distance map from find_dist
+  * @param levels pixels of dist bucketed by build_levels
+  * @param f force on each pixel, replaced with the propagated force
+  * @param pool threads to split each level across
+  */
+void propagate_force(GridView<const int> cell,
+                     GridView<const int> nucleus,
+                     GridView<const int> dist,
+                     const DistanceLevels& levels,
+                     GridView<double> f,
+                     ThreadPool& pool);
+
+/**
+  * @brief Net force on the nucleus after propagate_force, without building the propagated force
+  *
+  * Force is carried from level to level in buffers the size of one level, and each
+  * nucleus pixel's force is added to the net force along its unit vector to the centroid
+  * as soon as the last level has been passed on. Within the levels the force on every
+  * pixel is the same as propagate_force's; only the final sum may round differently from
+  * find_force_vector.
+  *
+  * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+  * @param dist distance map from find_dist
+  * @param levels pixels of dist bucketed by build_levels
+  * @param force 2D array containing the force exerted on the nucleus due to each pixel
+  * @param centroid (x, y) centroid of the nucleus
+  *
+  * @return vector of 2 elements (x, y) of the net force on the nucleus
+  */
+std::vector<double> propagate_net_force(GridView<const int> cell,
+                                        GridView<const int> nucleus,
+                                        GridView<const int> dist,
+                                        const DistanceLevels& levels,
+                                        GridView<const double> force,
+                                        const std::vector<double>& centroid);
+
+/**
+  * @brief Net force on the nucleus due to a force of 1 on every boundary pixel, without building any force grid
+  *
+  * The boundary is tested pixel by pixel as each level is loaded.
+  *
+  * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+  * @param dist distance map from find_dist
+  * @param levels pixels of dist bucketed by build_levels
+  * @param centroid (x, y) centroid of the nucleus
+  *
+  * @return vector of 2 elements (x, y) of the net force on the nucleus
+  */
+std::vector<double> propagate_boundary_net_force(GridView<const int> cell,
+                                                 GridView<const int> nucleus,
+                                                 GridView<const int> dist,
+                                                 const DistanceLevels& levels,
+                                                 const std::vector<double>& centroid);
+
+/**
+  * @brief Pull a weight on where force ends up back to where it starts
+  *
+  * This is the transpose of propagate_force: on return weight(p) is the sum, over every
+  * pixel o, of the share of a unit of force on p that propagate_force moves to o times
+  * the weight(o) passed in. The levels are walked once from the nucleus outwards, so it
+  * costs about as much as one propagation.
+  *
+  * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+  * @param dist distance map from find_dist
+  * @param levels pixels of dist bucketed by build_levels
+  * @param force force being propagated, which only decides which pixels that are both
+  *        cell and nucleus pass their force on
+  * @param weight weight of the force ending on each pixel, replaced with the weight of
+  *        a unit of force starting on each pixel
+  */
+void propagate_adjoint(GridView<const int> cell,
+                       GridView<const int> nucleus,
+                       GridView<const int> dist,
+                       const DistanceLevels& levels,
+                       GridView<const double> force,
+                       GridView<double> weight);
+
+/**
+  * @brief Pull a weight back from where force ends up with each level split across a thread pool
+  *
+  * Identical to the serial propagate_adjoint for any number of threads.
+  *
+  * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+  * @param dist distance map from find_dist
+  * @param levels pixels of dist bucketed by build_levels
+  * @param force force being propagated, which only decides which pixels that are both
+  *        cell and nucleus pass their force on
+  * @param weight weight of the force ending on each pixel, replaced with the weight of
+  *        a unit of force starting on each pixel
+  * @param pool threads to split each level across
+  */
+void propagate_adjoint(GridView<const int> cell,
+                       GridView<const int> nucleus,
+                       GridView<const int> dist,
+                       const DistanceLevels& levels,
+                       GridView<const double> force,
+                       GridView<double> weight,
+                       ThreadPool& pool);
+
+/**
+  * @brief Where a unit of force on the overlap pixel start ends up after propagate_force
+  *
+  * Pixels that are both cell and nucleus and start with force pass it on through a
+  * priority queue once the levels are done, and that force can also pick up force left
+  * on other queued pixels. This follows the same queue for a unit of force on start alone.
+  *
+  * @param cell 2D array where 1 is the cell and 0 is everything else
+  * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+  * @param dist distance map from find_dist
+  * @param queued sorted linear indices of the overlap pixels that start with force
+  * @param start linear index of one of the queued pixels
+  *
+  * @return (linear index, share) of every pixel the force ends up on, sorted by index
+  */
+std::vector<std::pair<int, double>> drain_shares(GridView<const int> cell,
+                                                GridView<const int> nucleus,
+                                                GridView<const int> dist,
+                                                const std::vector<int>& queued,
+                                                int start);
+
+/**
+  * @brief Find the total force that passes through each pixel on its way to the nucleus
+  *
+  * The flux of a pixel is its own force plus the shares it receives from the level
+  * above, added in the same order as propagate_force. On the nucleus (distance 0) the
+  * flux is therefore the propagated force, unless a pixel that is both cell and nucleus
+  * starts with force, which propagate_force moves on separately. Unreached pixels keep
+  * their own force.
+  *
+  * @param dist distance map from find_dist
+  * @param levels pixels of dist bucketed by build_levels
+  * @param flux force on each pixel, replaced with the flux through it
+  */
+void find_flux(GridView<const int> dist, const DistanceLevels& levels, GridView<double> flux);
+
+/**
+  * @brief Recompute the flux below a set of pixels whose inputs may have changed
+  *
+  * The dirty pixels are recomputed from the top level down, and a pixel's neighbours one
+  * level closer are only recomputed in turn if its flux changed or it is dirty itself.
+  * The result is identical to running find_flux on the new distance map and force.
+  *
+  * @param dist current distance map
+  * @param force current force on each pixel
+  * @param dirty linear indices of every pixel whose force or distance changed, together
+  *        with the 4-neighbours of every pixel whose distance changed
+  * @param flux flux for the old distance map and force, replaced with the current flux
+  *
+  * @return sorted linear indices of the pixels whose flux changed
+  */
+std::vector<int> update_flux(GridView<const int> dist,
+                             GridView<const double> force,
+                             const std::vector<int>& dirty,
+                             GridView<double> flux);
+
+/**
+  * @brief Recompute the flux below a set of pixels, marking pixels in a buffer the caller keeps
+  *
+  * Same as update_flux without marks, but only writes and clears the marks of the pixels
+  * it visits, so repeated updates cost nothing per pixel of the image.
+  *
+  * @param dist current distance map
+  * @param force current force on each pixel
+  * @param dirty linear indices of every pixel whose force or distance changed, together
+  *        with the 4-neighbours of every pixel whose distance changed
+  * @param flux flux for the old distance map and force, replaced with the current flux
+  * @param marks one zero element per pixel, left all zero again
+  *
+  * @return sorted linear indices of the pixels whose flux changed
+  * @throws std::invalid_argument if marks does not have one element per pixel
+  */
+std::vector<int> update_flux(GridView<const int> dist,
+                             GridView<const double> force,
+                             const std::vector<int>& dirty,
+                             GridView<double> flux,
+                             std::vector<unsigned char>& marks);
+} // namespace nucleusforce
+
+#endif // PROPAGATION_H
@@ -0,0 +1,111 @@
+#ifndef TRANSFER_H
+#define TRANSFER_H
+
+#include <common/grid.h>
+#include <cstddef>
+#include <vector>
+
+namespace nucleusforce {
+/**
+  * @brief Linear map from the force on a set of input pixels to the propagated force
+  *
+  * For a fixed cell and nucleus, propagation only ever splits force along the same
+  * paths, so the propagated force is a fixed sparse matrix times the input force. The
+  * matrix is built once, one distance level at a time outwards from the nucleus, and
+  * then applied to any number of force fields for the cost of its non-zero elements,
+  * which grow with the number of input pixels rather than with the area of the cell.
+  *
+  * Results match find_nucleus_force up to floating point rounding, since the shares of
+  * each input are multiplied out in a different order. Pixels that are both cell and
+  * nucleus only pass their force on in find_nucleus_force when they start with force of
+  * their own, so the map is only linear while every such input pixel carries force, and
+  * applying the operator to a field with no force on one of them throws.
+  *
+  * A TransferOperator is immutable after construction, so it can be shared between
+  * threads.
+  */
+class TransferOperator {
+public:
+  /**
+    * @brief Build the operator for force applied on the input pixels
+    *
+    * @param cell 2D array where 1 is the cell and 0 is everything else
+    * @param nucleus 2D array where 1 is the nucleus and 0 is everything else
+    * @param dist distance map from find_dist
+    * @param inputs 2D array that is non-zero on the pixels that may carry force, such as the boundary
+    * @param threads number of threads to build and apply with, 0 for one per hardware core
+    */
+  TransferOperator(GridView<const int> cell,
+                   GridView<const int> nucleus,
+                   GridView<const int> dist,
+                   GridView<const int> inputs,
+                   unsigned threads = 1);
+
+  int rows() const { return rows_; }
+  int cols() const { return cols_; }
+
+  /**
+    * @brief Linear indices (y * cols + x) of the input pixels, in row-major order
+    */
+  const std::vector<int>& inputs() const { return inputs_; }
+
+  /**
+    * @brief Linear indices of the pixels that can receive force, in row-major order
+    */
+  const std::vector<int>& outputs() const { return outputs_; }
+
+  /**
+    * @brief Number of non-zero elements of the matrix
+    */
+  size_t nonzeros() const { return input_of_.size(); }
+
+  /**
+    * @brief Propagate one force field
+    *
+    * @param force 2D array of the force on each pixel, zero outside the input pixels
+    *
+    * @return 2D double array of the force on each pixel on nucleus
+    * @throws std::invalid_argument if force has the wrong dimensions, force outside the input pixels,
+    *         or no force on an input pixel that is both cell and nucleus
+    */
+  Grid<double> apply(GridView<const double> force) const;
+
+  /**
+    * @brief Propagate several force fields at once
+    *
+    * @param forces 2D arrays of the force on each pixel, zero outside the input pixels
+    *
+    * @return 2D double array of the force on each pixel on nucleus for each field
+    * @throws std::invalid_argument if a field has the wrong dimensions, force outside the input pixels,
+    *         or no force on an input pixel that is both cell and nucleus
+    */
+  std::vector<Grid<double>> apply(const std::vector<Grid<double>>& forces) const;
+
+  /**
+    * @brief Propagate force fields given only on the input pixels
+    *
+    * @param loads one row per field, holding the force on each pixel of inputs()
+    *
+    * @return one row per field, holding the propagated force on each pixel of outputs()
+    * @throws std::invalid_argument if loads does not have a column per input pixel, or a field
+    *         has no force on an input pixel that is both cell and nucleus
+    */
+  Grid<double> apply_loads(GridView<const double> loads) const;
+
+private:
+  Grid<double> loads_of(const std::vector<GridView<const double>>& forces) const;
+  Grid<double> scatter(GridView<const double> values, int field) const;
+
+  int rows_ = 0;
+  int cols_ = 0;
+  unsigned threads_; ///< Threads used for each application
+  std::vector<int> inputs_; ///< Linear index of each input pixel
+  std::vector<int> overlap_inputs_; ///< Position in inputs_ of each pixel that is both cell and nucleus
+  std::vector<int> outputs_; ///< Linear index of each output pixel
+  std::vector<size_t> row_offsets_; ///< Start of each output's elements, plus the end
+  std::vector<int> input_of_; ///< Position in inputs_ of each element
+  std::vector<double> weights_; ///< Share of the input's force each element receives
+}; // class TransferOperator
+} // namespace nucleusforce
+
+#endif // TRANSFER_H
@@ -0,0 +1,30 @@
+#ifndef WORKSPACE_H
+#define WORKSPACE_H
+
+#include <common/grid.h>
+#include <nucleus_force/propagation.h>
+#include <vector>
+
+namespace nucleusforce {
+/**
+  * @brief Buffers that find_dist, find_boundary and the force functions reuse from call to call
+  *
+  * Each buffer keeps its storage when it is resized, so once a workspace has processed the
+  * largest of a stream of similar frames, processing the rest allocates nothing. How much
+  * the search and queue buffers need depends on the shape of the cell as well as the size
+  * of the image, so a frame with a larger cell than any before it can still grow them.
+  * The functions that take a workspace return references to its buffers, which stay valid
+  * until the workspace is next used. A workspace must only be used by one thread at a time.
+  */
+struct Workspace {
+  Grid<int> dist; ///< Distance map of the last find_dist
+  Grid<int> boundary; ///< Boundary of the last find_boundary
+  Grid<double> force; ///< Propagated force of the last find_nucleus_force
+  DistanceLevels levels; ///< Pixels of dist bucketed by distance
+  std::vector<int> frontier; ///< Linear indices of the pixels the distance search has reached, in order
+  PixelHeap queue; ///< Overlap pixels waiting to pass their force on
+  std::vector<double> force_vector = std::vector<double>(2); ///< (x, y) net force of the last find_force_vector
+};
+} // namespace nucleusforce
+
+#endif // WORKSPACE_H
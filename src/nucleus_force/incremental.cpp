@@ -0,0 +1,181 @@
+#include <nucleus_force/incremental.h>
+
+#include <nucleus_force/distance.h>
+#include <nucleus_force/nucleus_force.h>
+#include <nucleus_force/propagation.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace nucleusforce {
+IncrementalForceMap::IncrementalForceMap(GridView<const int> cell, GridView<const int> nucleus)
+    : cell_(cell), nucleus_(nucleus) {
+  check_same_shape(cell, nucleus, "cell and nucleus arrays should have the same dimensions");
+
+  boundary_ = find_boundary(cell_, nucleus_);
+  boundary_force_ = Grid<double>(rows(), cols());
+  for (size_t i = 0; i < boundary_.size(); ++i) {
+    boundary_force_.data()[i] = boundary_.data()[i];
+  }
+  for (int y = 0; y < rows(); ++y) {
+    for (int x = 0; x < cols(); ++x) {
+      overlap_ += overlap_force(y, x);
+    }
+  }
+
+  marks_.assign(boundary_.size(), 0);
+  dist_ = find_dist(cell_, nucleus_);
+  flux_ = boundary_force_;
+  find_flux(dist_, build_levels(dist_), flux_);
+  propagate_all();
+}
+
+bool IncrementalForceMap::overlap_force(int y, int x) const {
+  return cell_(y, x) == 1 && nucleus_(y, x) == 1 && boundary_(y, x) == 1;
+}
+
+/**
+  * @brief Rebuild the whole force field, from the flux unless force starts on the nucleus
+  */
+void IncrementalForceMap::propagate_all() {
+  if (overlap_ > 0) {
+    force_ = boundary_force_;
+    propagate_force(cell_, nucleus_, dist_, build_levels(dist_), force_);
+    force_from_flux_ = false;
+    return;
+  }
+
+  force_ = Grid<double>(rows(), cols());
+  for (size_t i = 0; i < force_.size(); ++i) {
+    if (dist_.data()[i] == 0) force_.data()[i] = flux_.data()[i];
+  }
+  force_from_flux_ = true;
+}
+
+UpdateStats IncrementalForceMap::update(GridView<const int> cell, GridView<const int> nucleus) {
+  check_same_shape(cell, nucleus, "cell and nucleus arrays should have the same dimensions");
+  check_same_shape(cell, cell_.view(), "frames of a time-lapse should have the same dimensions");
+
+  std::vector<PixelChange> changes;
+  for (int y = 0; y < rows(); ++y) {
+    for (int x = 0; x < cols(); ++x) {
+      if (cell(y, x) != cell_(y, x) || nucleus(y, x) != nucleus_(y, x)) {
+        changes.push_back({y, x, cell(y, x), nucleus(y, x)});
+      }
+    }
+  }
+  return update(changes);
+}
+
+UpdateStats IncrementalForceMap::update(const std::vector<PixelChange>& changes) {
+  UpdateStats stats;
+  const int cols = this->cols();
+
+  for (const PixelChange& change : changes) {
+    if (change.y < 0 || change.y >= rows() || change.x < 0 || change.x >= cols) {
+      throw std::invalid_argument("Changed pixel (" + std::to_string(change.y) + ", " +
+                                  std::to_string(change.x) + ") is outside the frame.");
+    }
+  }
+
+  // Going backwards, the first change seen of each pixel is its last
+  std::vector<PixelChange> applied;
+  std::vector<int> changed;
+  std::vector<int> seen;
+  for (auto it = changes.rbegin(); it != changes.rend(); ++it) {
+    int p = it->y * cols + it->x;
+    if (marks_[p]) continue;
+    marks_[p] = 1;
+    seen.push_back(p);
+    if (it->cell != cell_(it->y, it->x) || it->nucleus != nucleus_(it->y, it->x)) {
+      applied.push_back(*it);
+      changed.push_back(p);
+    }
+  }
+  for (int p : seen) {
+    marks_[p] = 0;
+  }
+  std::sort(changed.begin(), changed.end());
+  stats.changed = static_cast<int>(changed.size());
+  if (changed.empty()) return stats;
+
+  // The boundary stencil only reaches the 8 neighbours of a pixel
+  std::vector<int> region;
+  for (int p : changed) {
+    int y = p / cols;
+    int x = p - y * cols;
+    for (int ny = std::max(0, y - 1); ny <= std::min(rows() - 1, y + 1); ++ny) {
+      for (int nx = std::max(0, x - 1); nx <= std::min(cols - 1, x + 1); ++nx) {
+        int q = ny * cols + nx;
+        if (!marks_[q]) {
+          marks_[q] = 1;
+          region.push_back(q);
+        }
+      }
+    }
+  }
+  for (int q : region) {
+    marks_[q] = 0;
+  }
+
+  for (int q : region) {
+    overlap_ -= overlap_force(q / cols, q % cols);
+  }
+  for (const PixelChange& change : applied) {
+    cell_(change.y, change.x) = change.cell;
+    nucleus_(change.y, change.x) = change.nucleus;
+  }
+
+  // Pixels whose own force changed, then the pixels below them
+  std::vector<int> dirty;
+  for (int q : region) {
+    int y = q / cols;
+    int x = q - y * cols;
+    int b = is_boundary(cell_, nucleus_, y, x);
+    if (b != boundary_(y, x)) {
+      boundary_(y, x) = b;
+      boundary_force_(y, x) = b;
+      dirty.push_back(q);
+    }
+    overlap_ += overlap_force(y, x);
+  }
+
+  std::vector<int> moved = update_dist(cell_, nucleus_, changed, dist_, marks_);
+  stats.dist_changed = static_cast<int>(moved.size());
+
+  // A pixel that moves changes how its neighbours split and receive their flux
+  for (int p : moved) {
+    int y = p / cols;
+    int x = p - y * cols;
+    dirty.push_back(p);
+    if (x + 1 < cols) dirty.push_back(p + 1);
+    if (y + 1 < rows()) dirty.push_back(p + cols);
+    if (x > 0) dirty.push_back(p - 1);
+    if (y > 0) dirty.push_back(p - cols);
+  }
+
+  std::vector<int> flux_changed = update_flux(dist_, boundary_force_, dirty, flux_, marks_);
+  stats.flux_changed = static_cast<int>(flux_changed.size());
+
+  if (overlap_ > 0 || !force_from_flux_) {
+    stats.full = overlap_ > 0;
+    propagate_all();
+    return stats;
+  }
+
+  for (const std::vector<int>* pixels : {&moved, &flux_changed}) {
+    for (int p : *pixels) {
+      force_.data()[p] = dist_.data()[p] == 0 ? flux_.data()[p] : 0;
+    }
+  }
+  return stats;
+}
+
+std::vector<double> IncrementalForceMap::centroid() const {
+  return find_nucleus_centroid(nucleus_);
+}
+
+std::vector<double> IncrementalForceMap::force_vector() const {
+  return find_force_vector(nucleus_, force_);
+}
+} // namespace nucleusforce
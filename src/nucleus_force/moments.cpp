@@ -0,0 +1,111 @@
+#include <nucleus_force/moments.h>
+
+#include <common/trace.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace nucleusforce {
+/**
+  * @brief Sums of one block of nucleus pixels
+  */
+struct MomentSums {
+  double fx = 0;
+  double fy = 0;
+  double xx = 0;
+  double xy = 0;
+  double yx = 0;
+  double yy = 0;
+
+  MomentSums& operator+=(const MomentSums& other) {
+    fx += other.fx;
+    fy += other.fy;
+    xx += other.xx;
+    xy += other.xy;
+    yx += other.yx;
+    yy += other.yy;
+    return *this;
+  }
+};
+
+ForceMoments find_force_moments(const int* begin, const int* end, GridView<const double> force, ThreadPool& pool) {
+  NF_TRACE_SCOPE("find_force_moments");
+  const int cols = force.cols();
+  const int n = static_cast<int>(end - begin);
+
+  ForceMoments moments;
+  moments.pixels = n;
+  long long sum_x = 0;
+  long long sum_y = 0;
+  for (const int* p = begin; p != end; ++p) {
+    int y = *p / cols;
+    sum_x += *p - y * cols;
+    sum_y += y;
+  }
+  moments.centroid_x = static_cast<double>(sum_x) / n;
+  moments.centroid_y = static_cast<double>(sum_y) / n;
+  const double cx = moments.centroid_x;
+  const double cy = moments.centroid_y;
+
+  // Blocks are a fixed number of pixels, so which pixels are summed together does not
+  // depend on the thread count
+  const int block = 1024;
+  std::vector<MomentSums> sums((n + block - 1) / block);
+  pool.parallel_for(0, static_cast<int>(sums.size()), [&](int b_begin, int b_end) {
+    for (int b = b_begin; b < b_end; ++b) {
+      MomentSums s;
+      const int last = std::min(n, (b + 1) * block);
+      for (int i = b * block; i < last; ++i) {
+        int y = begin[i] / cols;
+        int x = begin[i] - y * cols;
+        double f = force(y, x);
+        if (f == 0.0) continue;
+        double dy = cy - y;
+        double dx = cx - x;
+        double mag = std::sqrt(dy * dy + dx * dx);
+        double fx = dx / mag * f;
+        double fy = dy / mag * f;
+        s.fx += fx;
+        s.fy += fy;
+        // r = p - c is the opposite of (dx, dy)
+        s.xx -= dx * fx;
+        s.xy -= dx * fy;
+        s.yx -= dy * fx;
+        s.yy -= dy * fy;
+      }
+      sums[b] = s;
+    }
+  }, 1);
+
+  // Add neighbouring blocks in pairs until one is left
+  for (size_t width = 1; width < sums.size(); width *= 2) {
+    for (size_t i = 0; i + width < sums.size(); i += 2 * width) {
+      sums[i] += sums[i + width];
+    }
+  }
+  if (!sums.empty()) {
+    moments.force_x = sums[0].fx;
+    moments.force_y = sums[0].fy;
+    moments.moment_xx = sums[0].xx;
+    moments.moment_xy = sums[0].xy;
+    moments.moment_yx = sums[0].yx;
+    moments.moment_yy = sums[0].yy;
+  }
+  NF_TRACE_COUNT("moment_pixels", n);
+  return moments;
+}
+
+ForceMoments find_force_moments(GridView<const int> nucleus, GridView<const double> force, unsigned threads) {
+  check_same_shape(nucleus, force, "Nucleus and force array dimensions must be identical.");
+
+  std::vector<int> pixels;
+  for (int y = 0; y < nucleus.rows(); ++y) {
+    const int* row = nucleus.row(y);
+    for (int x = 0; x < nucleus.cols(); ++x) {
+      if (row[x] == 1) pixels.push_back(y * nucleus.cols() + x);
+    }
+  }
+  ThreadPool pool(threads);
+  return find_force_moments(pixels.data(), pixels.data() + pixels.size(), force, pool);
+}
+} // namespace nucleusforce
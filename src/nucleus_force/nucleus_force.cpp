@@ -1,172 +1,508 @@
 #include <fstream>
+#include <common/kernels.h>
+#include <common/trace.h>
 #include <nucleus_force/nucleus_force.h>
-#include <climits>
-#include <queue>
-#include <sstream>
+#include <nucleus_force/distance.h>
+#include <nucleus_force/propagation.h>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
 #include <stdexcept>
+#include <type_traits>
 #include <utility>
 
 namespace nucleusforce {
-const int dy[8] = {0, 1, 0, -1, 0, 1, 0, -1};
-const int dx[8] = {1, 0, -1, 0, 0, 1, 0, -1};
-
-std::vector<std::vector<int>> find_dist(std::vector<std::vector<int>> cell,
-                                        std::vector<std::vector<int>> nucleus) {
-  if (cell.size() != nucleus.size() || cell[0].size() != nucleus[0].size()) {
-    throw std::invalid_argument("cell and nucleus arrays should have the same dimensions");
-  }
-
-  std::vector<std::vector<int>> dist(cell.size(),
-                                     std::vector<int>(cell[0].size(), -1)); // -1 means not reached
-  std::queue<std::pair<int, std::pair<int, int>>> q;
+/**
+  * @brief Breadth-first search from the nucleus into dist, also finding the nucleus centroid if centroid is set
+  *
+  * frontier is the search's FIFO queue of linear indices; it is never popped, so it ends
+  * up holding every reached pixel, and reusing it keeps its storage.
+  */
+template <Connectivity C, typename Dist>
+static void search_dist(GridView<const int> cell, GridView<const int> nucleus, Grid<Dist>& dist,
+                        std::vector<int>& frontier, std::vector<double>* centroid) {
+  NF_TRACE_SCOPE("find_dist");
+  check_same_shape(cell, nucleus, "cell and nucleus arrays should have the same dimensions");
+
+  const int rows = cell.rows();
+  const int cols = cell.cols();
+  const Dist unreached = unreached_distance<Dist>();
+  dist.assign(rows, cols, unreached);
+  frontier.clear();
+  double mx = 0;
+  double my = 0;
+  int m = 0;
 
-  for (int y = 0; y < nucleus.size(); ++y) {
-    for (int x = 0; x < nucleus[0].size(); ++x) {
-      if (nucleus[y][x] == 1) {
-        q.push(make_coord(y, x, 0));
-        dist[y][x] = 0;
+  for (int y = 0; y < rows; ++y) {
+    for (int x = 0; x < cols; ++x) {
+      if (nucleus(y, x) == 1) {
+        frontier.push_back(y * cols + x);
+        dist(y, x) = 0;
+        mx += x;
+        my += y;
+        m++;
       }
     }
   }
+  if (centroid != nullptr) {
+    *centroid = {mx / m, my / m};
+  }
 
-  while (!q.empty()) {
-    int d = q.front().first;
-    int y = q.front().second.first;
-    int x = q.front().second.second;
-    q.pop();
-
-    for (int i = 0; i < 4; i++) {
-      int ny = y + dy[i];
-      int nx = x + dx[i];
-      if (ny < 0 || ny >= cell.size() || nx < 0 || nx >= cell[0].size() ||
-        dist[ny][nx] != -1 || cell[ny][nx] == 0) {
-        continue;
+  for (size_t head = 0; head < frontier.size(); ++head) {
+    int y = frontier[head] / cols;
+    int x = frontier[head] - y * cols;
+    Dist d = dist(y, x);
+    if constexpr (std::is_unsigned_v<Dist>) {
+      // The largest value marks unreached pixels, so it cannot be a distance
+      if (d + 1 == unreached) {
+        throw std::invalid_argument("Distances in the cell are too large for the distance type.");
       }
-      dist[ny][nx] = d + 1;
-      q.push(make_coord(ny, nx, d + 1));
     }
+
+    for_each_neighbour<C>([&](int oy, int ox) {
+      int ny = y + oy;
+      int nx = x + ox;
+      if (ny < 0 || ny >= rows || nx < 0 || nx >= cols ||
+        dist(ny, nx) != unreached || cell(ny, nx) == 0) {
+        return;
+      }
+      dist(ny, nx) = static_cast<Dist>(d + 1);
+      frontier.push_back(ny * cols + nx);
+    });
+  }
+  NF_TRACE_COUNT("dist_pixels_visited", static_cast<long long>(frontier.size()));
+}
+
+/**
+  * @brief Breadth-first search from the nucleus, also finding the nucleus centroid if centroid is set
+  */
+static Grid<int> search_dist(GridView<const int> cell, GridView<const int> nucleus, std::vector<double>* centroid) {
+  Grid<int> dist;
+  std::vector<int> frontier;
+  search_dist<Connectivity::Four>(cell, nucleus, dist, frontier, centroid);
+  return dist;
+}
+
+Grid<int> find_dist(GridView<const int> cell, GridView<const int> nucleus) {
+  return search_dist(cell, nucleus, nullptr);
+}
+
+std::vector<std::vector<int>> find_dist(const std::vector<std::vector<int>>& cell,
+                                        const std::vector<std::vector<int>>& nucleus) {
+  return find_dist(Grid<int>::from_vector(cell), Grid<int>::from_vector(nucleus)).to_vector();
+}
+
+Grid<int> find_dist(GridView<const int> cell, GridView<const int> nucleus, unsigned threads) {
+  ThreadPool pool(threads);
+  if (pool.size() == 1) {
+    return find_dist(cell, nucleus);
   }
+  return find_dist(cell, nucleus, pool);
+}
+
+const Grid<int>& find_dist(GridView<const int> cell, GridView<const int> nucleus, Workspace& workspace) {
+  search_dist<Connectivity::Four>(cell, nucleus, workspace.dist, workspace.frontier, nullptr);
+  return workspace.dist;
+}
 
+template <Connectivity C, typename Dist>
+Grid<Dist> find_dist(GridView<const int> cell, GridView<const int> nucleus) {
+  Grid<Dist> dist;
+  std::vector<int> frontier;
+  search_dist<C>(cell, nucleus, dist, frontier, nullptr);
   return dist;
 }
 
-std::vector<std::vector<int>> find_boundary(std::vector<std::vector<int>> cell, std::vector<std::vector<int>> nucleus) {
-  std::vector<std::vector<int>> boundary(cell.size(),
-                                         std::vector<int>(cell[0].size()));
-
-  for (int y = 0; y < cell.size(); ++y) {
-    for (int x = 0; x < cell.size(); ++x) {
-      if (cell[y][x] == 1) {
-        bool is_boundary = false;
-        for (int i = 0; i < 8; i++) {
-          int ny = y + dy[i];
-          int nx = x + dx[i];
-          
-          if (ny < 0 || ny >= cell.size() || nx < 0 || nx >= cell[0].size() || 
-            cell[ny][nx] == 0 && nucleus[ny][nx] == 0) {
-            is_boundary = true;
-            break;
-          }
-        }
-
-        if (is_boundary) boundary[y][x] = 1;
+template Grid<int> find_dist<Connectivity::Four, int>(GridView<const int>, GridView<const int>);
+template Grid<uint16_t> find_dist<Connectivity::Four, uint16_t>(GridView<const int>, GridView<const int>);
+template Grid<int> find_dist<Connectivity::Eight, int>(GridView<const int>, GridView<const int>);
+template Grid<uint16_t> find_dist<Connectivity::Eight, uint16_t>(GridView<const int>, GridView<const int>);
+
+/**
+  * @brief Find the outer boundary of the cell into boundary
+  */
+static void find_boundary(GridView<const int> cell, GridView<const int> nucleus, Grid<int>& boundary) {
+  NF_TRACE_SCOPE("find_boundary");
+  check_same_shape(cell, nucleus, "cell and nucleus arrays should have the same dimensions");
+
+  const int rows = cell.rows();
+  const int cols = cell.cols();
+  boundary.assign(rows, cols);
+
+  for (int y = 0; y < rows; ++y) {
+    const int* c = cell.row(y);
+    int* out = boundary.row(y);
+
+    // Every cell pixel on the edge of the image has a neighbour outside it
+    if (y == 0 || y == rows - 1 || cols <= 2) {
+      for (int x = 0; x < cols; ++x) {
+        out[x] = c[x] == 1;
       }
+      continue;
     }
+
+    const int* cell_rows[3] = {cell.row(y - 1), c, cell.row(y + 1)};
+    const int* nucleus_rows[3] = {nucleus.row(y - 1), nucleus.row(y), nucleus.row(y + 1)};
+    out[0] = c[0] == 1;
+    kernels::boundary_row(cell_rows, nucleus_rows, cols, out);
+    out[cols - 1] = c[cols - 1] == 1;
   }
+}
 
+Grid<int> find_boundary(GridView<const int> cell, GridView<const int> nucleus) {
+  Grid<int> boundary;
+  find_boundary(cell, nucleus, boundary);
   return boundary;
 }
 
-std::vector<std::vector<double>> find_nucleus_force(std::vector<std::vector<int>> cell, 
-                                                 std::vector<std::vector<int>> nucleus) {
-  std::vector<std::vector<int>> boundary = find_boundary(cell, nucleus);
-  std::vector<std::vector<double>> force(cell.size(),
-                                         std::vector<double>(cell[0].size()));
-  for (int y = 0; y < cell.size(); ++y) {
-    for(int x = 0; x < cell[0].size(); ++x) {
-      force[y][x] = boundary[y][x];
+const Grid<int>& find_boundary(GridView<const int> cell, GridView<const int> nucleus, Workspace& workspace) {
+  find_boundary(cell, nucleus, workspace.boundary);
+  return workspace.boundary;
+}
+
+/**
+  * @brief Find the cell pixels with any of their 8 neighbours in the background
+  */
+static Grid<int> find_boundary_eight(GridView<const int> cell, GridView<const int> nucleus) {
+  NF_TRACE_SCOPE("find_boundary");
+  check_same_shape(cell, nucleus, "cell and nucleus arrays should have the same dimensions");
+
+  const int rows = cell.rows();
+  const int cols = cell.cols();
+  Grid<int> boundary(rows, cols);
+  for (int y = 0; y < rows; ++y) {
+    for (int x = 0; x < cols; ++x) {
+      if (cell(y, x) != 1) continue;
+      // Every cell pixel on the edge of the image has a neighbour outside it
+      bool edge = false;
+      for_each_neighbour<Connectivity::Eight>([&](int oy, int ox) {
+        int ny = y + oy;
+        int nx = x + ox;
+        edge = edge || ny < 0 || ny >= rows || nx < 0 || nx >= cols ||
+               (cell(ny, nx) == 0 && nucleus(ny, nx) == 0);
+      });
+      boundary(y, x) = edge;
     }
   }
+  return boundary;
+}
 
-  return find_nucleus_force(cell, nucleus, force);
+template <Connectivity C>
+Grid<int> find_boundary(GridView<const int> cell, GridView<const int> nucleus) {
+  if constexpr (C == Connectivity::Four) {
+    return find_boundary(cell, nucleus);
+  } else {
+    return find_boundary_eight(cell, nucleus);
+  }
 }
 
-std::vector<std::vector<double>> find_nucleus_force(std::vector<std::vector<int>> cell, 
-                                                 std::vector<std::vector<int>> nucleus, 
-                                                 std::vector<std::vector<double>> force) {
-  if (cell.size() != nucleus.size() || cell.size() != force.size() ||
-    cell[0].size() != nucleus[0].size() || cell[0].size() != force[0].size()) {
-    throw std::invalid_argument("Cell, nucleus, and force array dimensions must be identical.");
+template Grid<int> find_boundary<Connectivity::Four>(GridView<const int>, GridView<const int>);
+template Grid<int> find_boundary<Connectivity::Eight>(GridView<const int>, GridView<const int>);
+
+std::vector<std::vector<int>> find_boundary(const std::vector<std::vector<int>>& cell,
+                                            const std::vector<std::vector<int>>& nucleus) {
+  return find_boundary(Grid<int>::from_vector(cell), Grid<int>::from_vector(nucleus)).to_vector();
+}
+
+bool is_boundary(GridView<const int> cell, GridView<const int> nucleus, int y, int x) {
+  if (cell(y, x) != 1) return false;
+  if (y == 0 || y == cell.rows() - 1 || x == 0 || x == cell.cols() - 1) return true;
+  auto background = [&](int ny, int nx) { return cell(ny, nx) == 0 && nucleus(ny, nx) == 0; };
+  return background(y, x + 1) || background(y + 1, x) || background(y, x - 1) ||
+         background(y - 1, x) || background(y + 1, x + 1) || background(y - 1, x - 1);
+}
+
+Region find_bounding_box(GridView<const int> cell, GridView<const int> nucleus, int halo) {
+  check_same_shape(cell, nucleus, "cell and nucleus arrays should have the same dimensions");
+  if (halo < 0) {
+    throw std::invalid_argument("Bounding box halo must not be negative.");
   }
 
-  std::vector<std::vector<int>> dist = find_dist(cell, nucleus);
-  std::vector<std::vector<double>> f(nucleus.size(), std::vector<double>(nucleus[0].size()));
-  std::priority_queue<std::pair<int, std::pair<int, int>>> q;
+  int top = cell.rows();
+  int bottom = -1;
+  int left = cell.cols();
+  int right = -1;
+  for (int y = 0; y < cell.rows(); ++y) {
+    const int* c = cell.row(y);
+    const int* n = nucleus.row(y);
+    // Only the ends of each row can move the box sideways
+    int first = 0;
+    while (first < cell.cols() && c[first] == 0 && n[first] == 0) ++first;
+    if (first == cell.cols()) continue;
+    int last = cell.cols() - 1;
+    while (c[last] == 0 && n[last] == 0) --last;
+
+    top = std::min(top, y);
+    bottom = y;
+    left = std::min(left, first);
+    right = std::max(right, last);
+  }
+  if (bottom < 0) return Region();
 
-  for (int y = 0; y < force.size(); ++y) {
-    for (int x = 0; x < force[0].size(); ++x) {
-      f[y][x] = force[y][x];
-      if (cell[y][x] == 1 && force[y][x] != 0) {
-        q.push(make_coord(y, x, dist[y][x]));
-      }
+  return grow_region(top, bottom, left, right, halo, cell.rows(), cell.cols());
+}
+
+/**
+  * @brief Force of 1 on every boundary pixel of the cell
+  */
+static Grid<double> boundary_force(GridView<const int> cell, GridView<const int> nucleus) {
+  Grid<int> boundary = find_boundary(cell, nucleus);
+  Grid<double> force(cell.rows(), cell.cols());
+  for (int y = 0; y < cell.rows(); ++y) {
+    for(int x = 0; x < cell.cols(); ++x) {
+      force(y, x) = boundary(y, x);
     }
   }
+  return force;
+}
 
-  while (!q.empty()) {
-    int y = q.top().second.first;
-    int x = q.top().second.second;
-    q.pop();
+/**
+  * @brief Background (neither cell nor nucleus) of row y, with everything outside the mask set
+  */
+static void background_row(const BitMask& cell, const BitMask& nucleus, int y, std::vector<uint64_t>& out) {
+  std::fill(out.begin(), out.end(), ~uint64_t(0));
+  if (y < 0 || y >= cell.rows()) return;
+  const uint64_t* c = cell.row(y);
+  const uint64_t* n = nucleus.row(y);
+  for (int w = 0; w < cell.words_per_row(); ++w) {
+    out[w] = ~(c[w] | n[w]);
+  }
+}
 
-    if (f[y][x] == 0) continue;
+BitMask find_boundary(const BitMask& cell, const BitMask& nucleus) {
+  NF_TRACE_SCOPE("find_boundary");
+  if (cell.rows() != nucleus.rows() || cell.cols() != nucleus.cols()) {
+    throw std::invalid_argument("cell and nucleus arrays should have the same dimensions");
+  }
 
-    int min_dist = INT_MAX;
-    int count = 0;
-    for (int i = 0; i < 4; i++) {
-      int ny = y + dy[i];
-      int nx = x + dx[i];
-      if (ny < 0 || ny >= cell.size() || nx < 0 || nx >= cell[0].size()) {
-        continue;
-      }
-      if (cell[ny][nx] == 1 || nucleus[ny][nx] == 1) {
-        if (dist[ny][nx] >= 0 && dist[ny][nx] < min_dist) {
-          min_dist = dist[ny][nx];
-          count = 1;
-        } else if (dist[ny][nx] == min_dist) {
-          count++;
-        }
-      }
+  const int words = cell.words_per_row();
+  BitMask boundary(cell.rows(), cell.cols());
+
+  // Background rows above, on and below the current row
+  std::vector<uint64_t> above(words), current(words), below(words);
+  background_row(cell, nucleus, -1, above);
+  background_row(cell, nucleus, 0, current);
+
+  for (int y = 0; y < cell.rows(); ++y) {
+    background_row(cell, nucleus, y + 1, below);
+    const uint64_t* c = cell.row(y);
+    uint64_t* out = boundary.row(y);
+
+    for (int w = 0; w < words; ++w) {
+      // Bit x of a shifted word is the background at x + 1 (right) or x - 1 (left),
+      // carrying bits across words and treating the outside as background
+      uint64_t next_current = w + 1 < words ? current[w + 1] : ~uint64_t(0);
+      uint64_t prev_current = w > 0 ? current[w - 1] : ~uint64_t(0);
+      uint64_t next_below = w + 1 < words ? below[w + 1] : ~uint64_t(0);
+      uint64_t prev_above = w > 0 ? above[w - 1] : ~uint64_t(0);
+
+      uint64_t right = (current[w] >> 1) | (next_current << 63);
+      uint64_t left = (current[w] << 1) | (prev_current >> 63);
+      uint64_t down_right = (below[w] >> 1) | (next_below << 63);
+      uint64_t up_left = (above[w] << 1) | (prev_above >> 63);
+
+      out[w] = c[w] & (right | below[w] | left | above[w] | down_right | up_left);
     }
 
-    for (int i = 0; i < 4; i++) {
-      int ny = y + dy[i];
-      int nx = x + dx[i];
-      if (ny < 0 || ny >= cell.size() || nx < 0 || nx >= cell[0].size()) {
-        continue;
-      }
-      if (cell[ny][nx] == 1 || nucleus[ny][nx] == 1) {
-        if (dist[ny][nx] == min_dist) {
-          f[ny][nx] += (double)f[y][x] / count;
-          if (nucleus[ny][nx] == 0) {
-            q.push(make_coord(ny, nx, dist[ny][nx]));
-          }
-        }
-      }
-    }
+    std::swap(above, current);
+    std::swap(current, below);
+  }
+
+  return boundary;
+}
 
-    f[y][x] = 0;
+Grid<double> find_nucleus_force(GridView<const int> cell, GridView<const int> nucleus) {
+  return find_nucleus_force(cell, nucleus, boundary_force(cell, nucleus));
+}
+
+Grid<double> find_nucleus_force(GridView<const int> cell, GridView<const int> nucleus, unsigned threads) {
+  return find_nucleus_force(cell, nucleus, boundary_force(cell, nucleus), threads);
+}
+
+std::vector<std::vector<double>> find_nucleus_force(const std::vector<std::vector<int>>& cell,
+                                                    const std::vector<std::vector<int>>& nucleus) {
+  return find_nucleus_force(Grid<int>::from_vector(cell), Grid<int>::from_vector(nucleus)).to_vector();
+}
+
+/**
+  * @brief Check that the cell, nucleus and force arrays all have the same dimensions
+  */
+static void check_force_shape(GridView<const int> cell, GridView<const int> nucleus, GridView<const double> force) {
+  if (cell.rows() != nucleus.rows() || cell.rows() != force.rows() ||
+    cell.cols() != nucleus.cols() || cell.cols() != force.cols()) {
+    throw std::invalid_argument("Cell, nucleus, and force array dimensions must be identical.");
   }
+}
+
+Grid<double> find_nucleus_force(GridView<const int> cell,
+                                GridView<const int> nucleus,
+                                GridView<const double> force) {
+  check_force_shape(cell, nucleus, force);
+
+  Grid<int> dist = find_dist(cell, nucleus);
+  Grid<double> f(force);
+  propagate_force(cell, nucleus, dist, build_levels(dist), f);
 
   return f;
 }
 
-std::vector<double> find_nucleus_centroid(std::vector<std::vector<int>> nucleus) {
-  // Find centroid of nucleus
-  double mx = 0;
-  double my = 0;
+Grid<double> find_nucleus_force(GridView<const int> cell,
+                                GridView<const int> nucleus,
+                                GridView<const double> force,
+                                unsigned threads) {
+  check_force_shape(cell, nucleus, force);
+
+  ThreadPool pool(threads);
+  Grid<double> f(force);
+  if (pool.size() == 1) {
+    Grid<int> dist = find_dist(cell, nucleus);
+    propagate_force(cell, nucleus, dist, build_levels(dist), f);
+  } else {
+    Grid<int> dist = find_dist(cell, nucleus, pool);
+    propagate_force(cell, nucleus, dist, build_levels(dist), f, pool);
+  }
+
+  return f;
+}
+
+std::vector<std::vector<double>> find_nucleus_force(const std::vector<std::vector<int>>& cell,
+                                                    const std::vector<std::vector<int>>& nucleus,
+                                                    const std::vector<std::vector<double>>& force) {
+  return find_nucleus_force(Grid<int>::from_vector(cell), Grid<int>::from_vector(nucleus),
+                            Grid<double>::from_vector(force)).to_vector();
+}
+
+/**
+  * @brief Propagate the force already in the workspace using its distance map
+  */
+static const Grid<double>& propagate_in_workspace(GridView<const int> cell,
+                                                  GridView<const int> nucleus,
+                                                  Workspace& workspace) {
+  search_dist<Connectivity::Four>(cell, nucleus, workspace.dist, workspace.frontier, nullptr);
+  build_levels(workspace.dist, workspace.levels);
+  propagate_force(cell, nucleus, workspace.dist, workspace.levels, workspace.force, workspace.queue);
+  return workspace.force;
+}
+
+const Grid<double>& find_nucleus_force(GridView<const int> cell, GridView<const int> nucleus, Workspace& workspace) {
+  find_boundary(cell, nucleus, workspace.boundary);
+  workspace.force.assign(cell.rows(), cell.cols());
+  const int* boundary = workspace.boundary.data();
+  double* force = workspace.force.data();
+  for (size_t i = 0; i < workspace.force.size(); ++i) {
+    force[i] = boundary[i];
+  }
+  return propagate_in_workspace(cell, nucleus, workspace);
+}
+
+const Grid<double>& find_nucleus_force(GridView<const int> cell,
+                                       GridView<const int> nucleus,
+                                       GridView<const double> force,
+                                       Workspace& workspace) {
+  check_force_shape(cell, nucleus, force);
+
+  workspace.force.assign(force.rows(), force.cols());
+  for (int y = 0; y < force.rows(); ++y) {
+    std::copy(force.row(y), force.row(y) + force.cols(), workspace.force.row(y));
+  }
+  return propagate_in_workspace(cell, nucleus, workspace);
+}
+
+Grid<double> find_nucleus_force(GridView<const int> cell,
+                                GridView<const int> nucleus,
+                                DistanceMetric metric,
+                                unsigned threads) {
+  if (metric == DistanceMetric::CityBlock) {
+    return find_nucleus_force(cell, nucleus, threads);
+  }
+
+  Grid<double> dist = metric == DistanceMetric::Euclidean ? find_euclidean_dist(cell, nucleus, threads)
+                                                          : find_geodesic_dist(cell, nucleus);
+  Grid<double> f = boundary_force(cell, nucleus);
+  propagate_force_downhill(cell, nucleus, dist, f);
+  return f;
+}
+
+template <Connectivity C, typename Dist, typename Force>
+Grid<Force> find_nucleus_force(GridView<const int> cell, GridView<const int> nucleus, GridView<const Force> force) {
+  if (cell.rows() != nucleus.rows() || cell.rows() != force.rows() ||
+    cell.cols() != nucleus.cols() || cell.cols() != force.cols()) {
+    throw std::invalid_argument("Cell, nucleus, and force array dimensions must be identical.");
+  }
+
+  Grid<Dist> dist = find_dist<C, Dist>(cell, nucleus);
+  DistanceLevels levels;
+  build_levels(dist, levels);
+  Grid<Force> f(force);
+  PixelHeap queue;
+  propagate_force<C, Dist, Force>(cell, nucleus, dist, levels, f, queue);
+  return f;
+}
+
+template <Connectivity C, typename Dist, typename Force>
+Grid<Force> find_nucleus_force(GridView<const int> cell, GridView<const int> nucleus) {
+  Grid<int> boundary = find_boundary<C>(cell, nucleus);
+  Grid<Force> force(cell.rows(), cell.cols());
+  for (size_t i = 0; i < force.size(); ++i) {
+    force.data()[i] = static_cast<Force>(boundary.data()[i]);
+  }
+  return find_nucleus_force<C, Dist, Force>(cell, nucleus, force.view());
+}
+
+#define NUCLEUS_FORCE_INSTANTIATE(C, Dist, Force) \
+  template Grid<Force> find_nucleus_force<C, Dist, Force>(GridView<const int>, GridView<const int>); \
+  template Grid<Force> find_nucleus_force<C, Dist, Force>(GridView<const int>, GridView<const int>, \
+                                                          GridView<const Force>);
+NUCLEUS_FORCE_INSTANTIATE(Connectivity::Four, int, float)
+NUCLEUS_FORCE_INSTANTIATE(Connectivity::Four, int, double)
+NUCLEUS_FORCE_INSTANTIATE(Connectivity::Four, uint16_t, float)
+NUCLEUS_FORCE_INSTANTIATE(Connectivity::Four, uint16_t, double)
+NUCLEUS_FORCE_INSTANTIATE(Connectivity::Eight, int, float)
+NUCLEUS_FORCE_INSTANTIATE(Connectivity::Eight, int, double)
+NUCLEUS_FORCE_INSTANTIATE(Connectivity::Eight, uint16_t, float)
+NUCLEUS_FORCE_INSTANTIATE(Connectivity::Eight, uint16_t, double)
+#undef NUCLEUS_FORCE_INSTANTIATE
+
+/**
+  * @brief Check that a sparse force array has the same dimensions as the cell
+  */
+static void check_force_shape(GridView<const int> cell, const SparseGrid<double>& force) {
+  if (cell.rows() != force.rows() || cell.cols() != force.cols()) {
+    throw std::invalid_argument("Cell, nucleus, and force array dimensions must be identical.");
+  }
+}
+
+Grid<double> find_nucleus_force(GridView<const int> cell,
+                                GridView<const int> nucleus,
+                                const SparseGrid<double>& force) {
+  check_force_shape(cell, force);
+  return find_nucleus_force(cell, nucleus, force.to_dense());
+}
+
+SparseGrid<double> find_sparse_nucleus_force(GridView<const int> cell, GridView<const int> nucleus,
+                                             unsigned threads) {
+  return SparseGrid<double>::from_dense(find_nucleus_force(cell, nucleus, threads));
+}
+
+SparseGrid<double> find_sparse_nucleus_force(GridView<const int> cell,
+                                             GridView<const int> nucleus,
+                                             const SparseGrid<double>& force,
+                                             unsigned threads) {
+  check_force_shape(cell, force);
+  return SparseGrid<double>::from_dense(find_nucleus_force(cell, nucleus, force.to_dense(), threads));
+}
+
+/**
+  * @brief Find the (mx, my) centroid of the nucleus without allocating
+  */
+static void nucleus_centroid(GridView<const int> nucleus, double& mx, double& my) {
+  mx = 0;
+  my = 0;
   int m = 0;
-  for (int y = 0; y < nucleus.size(); ++y) {
-    for (int x = 0; x < nucleus[0].size(); ++x) {
-      if (nucleus[y][x] == 1) {
+  for (int y = 0; y < nucleus.rows(); ++y) {
+    for (int x = 0; x < nucleus.cols(); ++x) {
+      if (nucleus(y, x) == 1) {
         mx += x;
         my += y;
         m++;
@@ -175,32 +511,109 @@ std::vector<double> find_nucleus_centroid(std::vector<std::vector<int>> nucleus)
   }
   mx /= m;
   my /= m;
+}
 
+std::vector<double> find_nucleus_centroid(GridView<const int> nucleus) {
+  double mx;
+  double my;
+  nucleus_centroid(nucleus, mx, my);
   return {mx, my};
 }
 
+std::vector<double> find_nucleus_centroid(const std::vector<std::vector<int>>& nucleus) {
+  return find_nucleus_centroid(Grid<int>::from_vector(nucleus));
+}
+
+/**
+  * @brief Find the net force on the nucleus into f_net, which must hold 2 elements
+  */
+static void net_force(GridView<const int> nucleus, GridView<const double> force, double* f_net) {
+  NF_TRACE_SCOPE("find_force_vector");
+  check_same_shape(nucleus, force, "Nucleus and force array dimensions must be identical.");
+
+  double mx;
+  double my;
+  nucleus_centroid(nucleus, mx, my);
+
+  // Find net force
+  f_net[0] = 0;
+  f_net[1] = 0;
+  for (int y = 0; y < nucleus.rows(); ++y) {
+    kernels::accumulate_force_row(nucleus.row(y), force.row(y), nucleus.cols(), y, mx, my, f_net[0], f_net[1]);
+  }
+}
 
-std::vector<double> find_force_vector(std::vector<std::vector<int>> nucleus,
-                                    std::vector<std::vector<double>> force) {
-std::vector<double> centroid = find_nucleus_centroid(nucleus);
+std::vector<double> find_force_vector(GridView<const int> nucleus,
+                                      GridView<const double> force) {
+  std::vector<double> f_net(2, 0);
+  net_force(nucleus, force, f_net.data());
+  return f_net;
+}
+
+std::vector<double> find_force_vector(GridView<const int> nucleus, GridView<const float> force) {
+  NF_TRACE_SCOPE("find_force_vector");
+  check_same_shape(nucleus, force, "Nucleus and force array dimensions must be identical.");
+
+  double mx;
+  double my;
+  nucleus_centroid(nucleus, mx, my);
+
+  // Sum in double so the net force keeps its precision over large nuclei
+  std::vector<double> f_net(2, 0);
+  for (int y = 0; y < nucleus.rows(); ++y) {
+    const int* n = nucleus.row(y);
+    const float* f = force.row(y);
+    for (int x = 0; x < nucleus.cols(); ++x) {
+      if (n[x] && f[x] != 0) {
+        double dy = my - y;
+        double dx = mx - x;
+        double mag = std::sqrt(dy * dy + dx * dx);
+        f_net[0] += dx / mag * f[x];
+        f_net[1] += dy / mag * f[x];
+      }
+    }
+  }
+  return f_net;
+}
+
+const std::vector<double>& find_force_vector(GridView<const int> nucleus,
+                                             GridView<const double> force,
+                                             Workspace& workspace) {
+  workspace.force_vector.resize(2);
+  net_force(nucleus, force, workspace.force_vector.data());
+  return workspace.force_vector;
+}
+
+std::vector<double> find_force_vector(const std::vector<std::vector<int>>& nucleus,
+                                      const std::vector<std::vector<double>>& force) {
+  return find_force_vector(Grid<int>::from_vector(nucleus), Grid<double>::from_vector(force));
+}
+
+std::vector<double> find_force_vector(GridView<const int> nucleus, const SparseGrid<double>& force) {
+  NF_TRACE_SCOPE("find_force_vector");
+  if (nucleus.rows() != force.rows() || nucleus.cols() != force.cols()) {
+    throw std::invalid_argument("Nucleus and force array dimensions must be identical.");
+  }
+
+  std::vector<double> centroid = find_nucleus_centroid(nucleus);
   double mx = centroid[0];
   double my = centroid[1];
 
-  // Find net force
+  // Same terms as the dense version over the stored pixels only, added in row-major order
+  // rather than through the vectorised reduction, so the two agree up to rounding
   std::vector<double> f_net(2, 0);
-  for (int y = 0; y < nucleus.size(); ++y) {
-    for (int x = 0; x < nucleus[0].size(); ++x) {
-      if (nucleus[y][x] && force[y][x] != 0.0) {
-        double fy = my - y;
-        double fx = mx - x;
-        double f_mag = std::sqrt(fy * fy + fx * fx);
-        fy /= f_mag; // get unit displacement vector
-        fx /= f_mag;
-        fy *= force[y][x];
-        fx *= force[y][x];
-
-        f_net[0] += fx;
-        f_net[1] += fy;
+  const std::vector<size_t>& offsets = force.row_offsets();
+  for (int y = 0; y < force.rows(); ++y) {
+    const int* n = nucleus.row(y);
+    for (size_t i = offsets[y]; i < offsets[y + 1]; ++i) {
+      int x = force.columns()[i];
+      double f = force.values()[i];
+      if (n[x] && f != 0.0) {
+        double dy = my - y;
+        double dx = mx - x;
+        double mag = std::sqrt(dy * dy + dx * dx);
+        f_net[0] += dx / mag * f;
+        f_net[1] += dy / mag * f;
       }
     }
   }
@@ -208,54 +621,134 @@ std::vector<double> centroid = find_nucleus_centroid(nucleus);
   return f_net;
 }
 
-inline std::pair<int, std::pair<int, int>> make_coord(int y, int x, int d) {
-  return std::make_pair(d, std::make_pair(y, x));
+std::vector<double> find_net_force(GridView<const int> cell, GridView<const int> nucleus) {
+  std::vector<double> centroid;
+  Grid<int> dist = search_dist(cell, nucleus, &centroid);
+  return propagate_boundary_net_force(cell, nucleus, dist, build_levels(dist), centroid);
 }
 
-void export_csv(std::string filepath, std::vector<std::vector<int>> array) {
-  std::ofstream file(filepath);  // Open file for writing
+std::vector<double> find_net_force(GridView<const int> cell,
+                                   GridView<const int> nucleus,
+                                   GridView<const double> force) {
+  check_force_shape(cell, nucleus, force);
 
-  if (!file.is_open()) {
-    throw std::runtime_error("Could not open file for writing: " + filepath);
-  }
+  std::vector<double> centroid;
+  Grid<int> dist = search_dist(cell, nucleus, &centroid);
+  return propagate_net_force(cell, nucleus, dist, build_levels(dist), force, centroid);
+}
 
-  for (size_t i = 0; i < array.size(); ++i) {
-    std::ostringstream row;
-    
-    for (size_t j = 0; j < array[i].size(); ++j) {
-      row << array[i][j];
-      if (j < array[i].size() - 1) {
-        row << ",";
+ForceSensitivity find_force_sensitivity(GridView<const int> cell,
+                                        GridView<const int> nucleus,
+                                        GridView<const double> force,
+                                        unsigned threads) {
+  check_force_shape(cell, nucleus, force);
+
+  // Force ending on a nucleus pixel pulls it along the unit vector to the centroid,
+  // as in find_force_vector. A pixel on the centroid has no direction to pull in.
+  std::vector<double> centroid = find_nucleus_centroid(nucleus);
+  ForceSensitivity sensitivity{Grid<double>(cell.rows(), cell.cols()), Grid<double>(cell.rows(), cell.cols())};
+  for (int y = 0; y < nucleus.rows(); ++y) {
+    for (int x = 0; x < nucleus.cols(); ++x) {
+      if (nucleus(y, x) == 1) {
+        double dy = centroid[1] - y;
+        double dx = centroid[0] - x;
+        double mag = std::sqrt(dy * dy + dx * dx);
+        if (mag == 0) continue;
+        sensitivity.x(y, x) = dx / mag;
+        sensitivity.y(y, x) = dy / mag;
       }
     }
+  }
 
-    file << row.str() << "\n";
+  ThreadPool pool(threads);
+  if (pool.size() == 1) {
+    Grid<int> dist = find_dist(cell, nucleus);
+    DistanceLevels levels = build_levels(dist);
+    propagate_adjoint(cell, nucleus, dist, levels, force, sensitivity.x);
+    propagate_adjoint(cell, nucleus, dist, levels, force, sensitivity.y);
+  } else {
+    Grid<int> dist = find_dist(cell, nucleus, pool);
+    DistanceLevels levels = build_levels(dist);
+    propagate_adjoint(cell, nucleus, dist, levels, force, sensitivity.x, pool);
+    propagate_adjoint(cell, nucleus, dist, levels, force, sensitivity.y, pool);
   }
 
-  file.close();
+  return sensitivity;
+}
+
+ForceSensitivity find_force_sensitivity(GridView<const int> cell, GridView<const int> nucleus, unsigned threads) {
+  return find_force_sensitivity(cell, nucleus, boundary_force(cell, nucleus), threads);
 }
 
-void export_csv(std::string filepath, std::vector<std::vector<double>> array) {
-  std::ofstream file(filepath);  // Open file for writing
+/**
+  * @brief Append value to out as ostream would print it with the default precision
+  */
+static char* format_value(char* out, char* end, int value) {
+  return std::to_chars(out, end, value).ptr;
+}
+
+static char* format_value(char* out, char* end, double value) {
+  // Same as "%g", which is how an ostream with precision 6 prints doubles
+  return std::to_chars(out, end, value, std::chars_format::general, 6).ptr;
+}
+
+template <typename T>
+static void write_csv(const std::string& filepath, GridView<const T> array) {
+  NF_TRACE_SCOPE("export");
+  std::ofstream file(filepath, std::ios::binary);  // Open file for writing
 
   if (!file.is_open()) {
     throw std::runtime_error("Could not open file for writing: " + filepath);
   }
 
-  for (size_t i = 0; i < array.size(); ++i) {
-    std::ostringstream row;
-    
-    for (size_t j = 0; j < array[i].size(); ++j) {
-      row << array[i][j];
-      if (j < array[i].size() - 1) {
-        row << ",";
-      }
+  // Format into a large buffer and write it out in big blocks
+  const size_t max_field = 32;
+  const size_t flush_at = size_t(1) << 20;
+  std::vector<char> buffer(flush_at + max_field);
+  size_t used = 0;
+  [[maybe_unused]] long long written = 0;
+  auto flush = [&] {
+    if (used >= flush_at) {
+      file.write(buffer.data(), used);
+      written += used;
+      used = 0;
     }
+  };
+
+  for (int i = 0; i < array.rows(); ++i) {
+    const T* row = array.row(i);
+    for (int j = 0; j < array.cols(); ++j) {
+      char* out = buffer.data() + used;
+      out = format_value(out, out + max_field - 1, row[j]);
+      if (j < array.cols() - 1) *out++ = ',';
+      used = out - buffer.data();
+      flush();
+    }
+    buffer[used++] = '\n';
+    flush();
+  }
+  file.write(buffer.data(), used);
 
-    file << row.str() << "\n";
+  if (!file) {
+    throw std::runtime_error("Could not write file: " + filepath);
   }
+  NF_TRACE_COUNT("bytes_written", written + static_cast<long long>(used));
+}
+
+void export_csv(const std::string& filepath, GridView<const int> array) {
+  write_csv(filepath, array);
+}
+
+void export_csv(const std::string& filepath, GridView<const double> array) {
+  write_csv(filepath, array);
+}
+
+void export_csv(const std::string& filepath, const std::vector<std::vector<int>>& array) {
+  export_csv(filepath, Grid<int>::from_vector(array));
+}
 
-  file.close();
+void export_csv(const std::string& filepath, const std::vector<std::vector<double>>& array) {
+  export_csv(filepath, Grid<double>::from_vector(array));
 }
 
 } // namespace nucleusforce
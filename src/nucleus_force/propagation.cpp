@@ -0,0 +1,835 @@
+#include <nucleus_force/propagation.h>
+#include <nucleus_force/nucleus_force.h>
+
+#include <common/trace.h>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace nucleusforce {
+const int dy[4] = {0, 1, 0, -1};
+const int dx[4] = {1, 0, -1, 0};
+
+DistanceLevels build_levels(GridView<const int> dist) {
+  DistanceLevels levels;
+  build_levels(dist, levels);
+  return levels;
+}
+
+/**
+  * @brief Whether the distance search reached a pixel at distance value
+  */
+template <typename Dist>
+static bool reached(Dist value) {
+  if constexpr (std::is_signed_v<Dist>) {
+    return value >= 0;
+  } else {
+    return value != unreached_distance<Dist>();
+  }
+}
+
+/**
+  * @brief Distance value as an int, -1 if the pixel was not reached
+  */
+template <typename Dist>
+static int distance_of(Dist value) {
+  return reached(value) ? static_cast<int>(value) : -1;
+}
+
+template <typename Dist>
+static void bucket_levels(GridView<const Dist> dist, DistanceLevels& levels) {
+  levels.rows = dist.rows();
+  levels.cols = dist.cols();
+
+  // Count the pixels at each distance into the slot after it
+  std::vector<int>& offsets = levels.offsets;
+  offsets.assign(1, 0);
+  for (int y = 0; y < dist.rows(); ++y) {
+    const Dist* row = dist.row(y);
+    for (int x = 0; x < dist.cols(); ++x) {
+      if (!reached(row[x])) continue;
+      int d = row[x];
+      if (d + 1 >= static_cast<int>(offsets.size())) {
+        offsets.resize(d + 2, 0);
+      }
+      offsets[d + 1]++;
+    }
+  }
+  for (size_t d = 1; d < offsets.size(); ++d) {
+    offsets[d] += offsets[d - 1];
+  }
+
+  // Scatter the pixels in row-major order so each level stays sorted, using the start
+  // of each level as its cursor, which leaves it at the start of the next level
+  levels.pixels.resize(offsets.back());
+  for (int y = 0; y < dist.rows(); ++y) {
+    const Dist* row = dist.row(y);
+    for (int x = 0; x < dist.cols(); ++x) {
+      if (reached(row[x])) {
+        levels.pixels[offsets[row[x]]++] = y * dist.cols() + x;
+      }
+    }
+  }
+  for (size_t d = offsets.size() - 1; d > 0; --d) {
+    offsets[d] = offsets[d - 1];
+  }
+  offsets[0] = 0;
+}
+
+void build_levels(GridView<const int> dist, DistanceLevels& levels) {
+  bucket_levels(dist, levels);
+}
+
+DistanceLevels build_levels(GridView<const uint16_t> dist) {
+  DistanceLevels levels;
+  bucket_levels(dist, levels);
+  return levels;
+}
+
+void build_levels(GridView<const uint16_t> dist, DistanceLevels& levels) {
+  bucket_levels(dist, levels);
+}
+
+/**
+  * @brief Run the priority-queue propagation until the queue is empty
+  *
+  * Only used for the rare pixels that are both cell and nucleus, whose force can move
+  * away from the nucleus before settling.
+  */
+template <Connectivity C, typename Dist, typename Force>
+static void drain_queue(GridView<const int> cell,
+                        GridView<const int> nucleus,
+                        GridView<const Dist> dist,
+                        GridView<Force> f,
+                        PixelHeap& q) {
+  // A pixel is queued once for every neighbour that passes force to it, and only the
+  // first pop finds force left on it
+  [[maybe_unused]] long long pushes = static_cast<long long>(q.size());
+  [[maybe_unused]] long long duplicate_pops = 0;
+  while (!q.empty()) {
+    std::pop_heap(q.begin(), q.end());
+    int y = q.back().second.first;
+    int x = q.back().second.second;
+    q.pop_back();
+
+    if (f(y, x) == 0) {
+      ++duplicate_pops;
+      continue;
+    }
+
+    int min_dist = INT_MAX;
+    int count = 0;
+    for_each_neighbour<C>([&](int oy, int ox) {
+      int ny = y + oy;
+      int nx = x + ox;
+      if (ny < 0 || ny >= cell.rows() || nx < 0 || nx >= cell.cols()) {
+        return;
+      }
+      if (cell(ny, nx) == 1 || nucleus(ny, nx) == 1) {
+        int nd = distance_of(dist(ny, nx));
+        if (nd >= 0 && nd < min_dist) {
+          min_dist = nd;
+          count = 1;
+        } else if (nd == min_dist) {
+          count++;
+        }
+      }
+    });
+
+    for_each_neighbour<C>([&](int oy, int ox) {
+      int ny = y + oy;
+      int nx = x + ox;
+      if (ny < 0 || ny >= cell.rows() || nx < 0 || nx >= cell.cols()) {
+        return;
+      }
+      if (cell(ny, nx) == 1 || nucleus(ny, nx) == 1) {
+        if (distance_of(dist(ny, nx)) == min_dist) {
+          f(ny, nx) += f(y, x) / count;
+          if (nucleus(ny, nx) == 0) {
+            q.push_back(make_coord(ny, nx, min_dist));
+            std::push_heap(q.begin(), q.end());
+            ++pushes;
+          }
+        }
+      }
+    });
+
+    f(y, x) = 0;
+  }
+  NF_TRACE_COUNT("queue_pushes", pushes);
+  NF_TRACE_COUNT("queue_duplicate_pops", duplicate_pops);
+}
+
+std::vector<std::pair<int, double>> drain_shares(GridView<const int> cell,
+                                                GridView<const int> nucleus,
+                                                GridView<const int> dist,
+                                                const std::vector<int>& queued,
+                                                int start) {
+  // Pixels of queued after start are popped before any force reaches them, so only
+  // the ones up to start matter
+  const int cols = cell.cols();
+  std::unordered_map<int, double> f;
+  f[start] = 1;
+  std::priority_queue<std::pair<int, std::pair<int, int>>> q;
+  for (int p : queued) {
+    if (p > start) break;
+    q.push(make_coord(p / cols, p % cols, 0));
+  }
+
+  while (!q.empty()) {
+    int y = q.top().second.first;
+    int x = q.top().second.second;
+    q.pop();
+
+    auto it = f.find(y * cols + x);
+    if (it == f.end() || it->second == 0) continue;
+    double value = it->second;
+
+    int min_dist = INT_MAX;
+    int count = 0;
+    for (int i = 0; i < 4; i++) {
+      int ny = y + dy[i];
+      int nx = x + dx[i];
+      if (ny < 0 || ny >= cell.rows() || nx < 0 || nx >= cols) continue;
+      if ((cell(ny, nx) == 1 || nucleus(ny, nx) == 1) && dist(ny, nx) >= 0) {
+        if (dist(ny, nx) < min_dist) {
+          min_dist = dist(ny, nx);
+          count = 1;
+        } else if (dist(ny, nx) == min_dist) {
+          count++;
+        }
+      }
+    }
+
+    for (int i = 0; i < 4; i++) {
+      int ny = y + dy[i];
+      int nx = x + dx[i];
+      if (ny < 0 || ny >= cell.rows() || nx < 0 || nx >= cols) continue;
+      if ((cell(ny, nx) == 1 || nucleus(ny, nx) == 1) && dist(ny, nx) == min_dist) {
+        f[ny * cols + nx] += value / count;
+        if (nucleus(ny, nx) == 0) {
+          q.push(make_coord(ny, nx, dist(ny, nx)));
+        }
+      }
+    }
+
+    f[y * cols + x] = 0;
+  }
+
+  std::vector<std::pair<int, double>> result;
+  for (const std::pair<const int, double>& entry : f) {
+    if (entry.second != 0) result.push_back(entry);
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+/**
+  * @brief Queue the pixels that are both cell and nucleus and start with force
+  *
+  * They sit at distance 0 but can still pass their own force on, so they go through the
+  * general queue once the levels are done.
+  */
+template <typename Force>
+static void overlap_queue(GridView<const int> cell,
+                          GridView<Force> f,
+                          const DistanceLevels& levels,
+                          PixelHeap& q) {
+  q.clear();
+  if (levels.count() > 0) {
+    for (const int* p = levels.begin(0); p != levels.end(0); ++p) {
+      int y = *p / levels.cols;
+      int x = *p - y * levels.cols;
+      if (cell(y, x) == 1 && f(y, x) != 0) {
+        q.push_back(make_coord(y, x, 0));
+        std::push_heap(q.begin(), q.end());
+      }
+    }
+  }
+}
+
+/**
+  * @brief Drop the force in rows [begin, end) of the cell that cannot reach the nucleus
+  */
+template <typename Dist, typename Force>
+static void clear_unreached(GridView<const int> cell, GridView<const Dist> dist, GridView<Force> f,
+                            int begin, int end) {
+  for (int y = begin; y < end; ++y) {
+    for (int x = 0; x < cell.cols(); ++x) {
+      if (cell(y, x) == 1 && dist(y, x) == unreached_distance<Dist>()) {
+        f(y, x) = 0;
+      }
+    }
+  }
+}
+
+void propagate_force(GridView<const int> cell,
+                     GridView<const int> nucleus,
+                     GridView<const int> dist,
+                     const DistanceLevels& levels,
+                     GridView<double> f) {
+  PixelHeap q;
+  propagate_force(cell, nucleus, dist, levels, f, q);
+}
+
+void propagate_force(GridView<const int> cell,
+                     GridView<const int> nucleus,
+                     GridView<const int> dist,
+                     const DistanceLevels& levels,
+                     GridView<double> f,
+                     PixelHeap& q) {
+  propagate_force<Connectivity::Four>(cell, nucleus, dist, levels, f, q);
+}
+
+template <Connectivity C, typename Dist, typename Force>
+void propagate_force(GridView<const int> cell,
+                     GridView<const int> nucleus,
+                     GridView<const Dist> dist,
+                     const DistanceLevels& levels,
+                     GridView<Force> f,
+                     PixelHeap& q) {
+  NF_TRACE_SCOPE("propagate_force");
+  check_same_shape(cell, nucleus, "cell and nucleus arrays should have the same dimensions");
+  check_same_shape(cell, dist, "Cell and distance array dimensions must be identical.");
+  check_same_shape(cell, f, "Cell and force array dimensions must be identical.");
+  const int rows = dist.rows();
+  const int cols = dist.cols();
+
+  overlap_queue(cell, f, levels, q);
+
+  // Every pixel at distance d > 0 has at least one neighbour at d - 1 and none closer,
+  // so force only ever moves down one level. Pixels are visited in descending
+  // row-major order within a level, which keeps the summation order (and therefore
+  // the result) identical to the priority-queue formulation.
+  [[maybe_unused]] long long visited = 0;
+  for (int d = levels.count() - 1; d >= 1; --d) {
+    const Dist closer = static_cast<Dist>(d - 1);
+    for (const int* p = levels.end(d); p != levels.begin(d);) {
+      --p;
+      int y = *p / cols;
+      int x = *p - y * cols;
+      Force& value = f(y, x);
+      if (value == 0) continue;
+      ++visited;
+
+      bool down_level[Stencil<C>::size];
+      int count = 0;
+      int i = 0;
+      for_each_neighbour<C>([&](int oy, int ox) {
+        int ny = y + oy;
+        int nx = x + ox;
+        down_level[i] = ny >= 0 && ny < rows && nx >= 0 && nx < cols && dist(ny, nx) == closer;
+        count += down_level[i++];
+      });
+      Force share = value / count;
+
+      i = 0;
+      for_each_neighbour<C>([&](int oy, int ox) {
+        if (down_level[i++]) f(y + oy, x + ox) += share;
+      });
+      value = 0;
+    }
+  }
+  NF_TRACE_COUNT("propagation_pixels_visited", visited);
+
+  drain_queue<C>(cell, nucleus, dist, f, q);
+  clear_unreached(cell, dist, f, 0, rows);
+}
+
+template void propagate_force<Connectivity::Four, int, float>(
+    GridView<const int>, GridView<const int>, GridView<const int>, const DistanceLevels&, GridView<float>, PixelHeap&);
+template void propagate_force<Connectivity::Four, int, double>(
+    GridView<const int>, GridView<const int>, GridView<const int>, const DistanceLevels&, GridView<double>, PixelHeap&);
+template void propagate_force<Connectivity::Four, uint16_t, float>(
+    GridView<const int>, GridView<const int>, GridView<const uint16_t>, const DistanceLevels&, GridView<float>, PixelHeap&);
+template void propagate_force<Connectivity::Four, uint16_t, double>(
+    GridView<const int>, GridView<const int>, GridView<const uint16_t>, const DistanceLevels&, GridView<double>,
+    PixelHeap&);
+template void propagate_force<Connectivity::Eight, int, float>(
+    GridView<const int>, GridView<const int>, GridView<const int>, const DistanceLevels&, GridView<float>, PixelHeap&);
+template void propagate_force<Connectivity::Eight, int, double>(
+    GridView<const int>, GridView<const int>, GridView<const int>, const DistanceLevels&, GridView<double>, PixelHeap&);
+template void propagate_force<Connectivity::Eight, uint16_t, float>(
+    GridView<const int>, GridView<const int>, GridView<const uint16_t>, const DistanceLevels&, GridView<float>,
+    PixelHeap&);
+template void propagate_force<Connectivity::Eight, uint16_t, double>(
+    GridView<const int>, GridView<const int>, GridView<const uint16_t>, const DistanceLevels&, GridView<double>,
+    PixelHeap&);
+
+void propagate_force_downhill(GridView<const int> cell,
+                              GridView<const int> nucleus,
+                              GridView<const double> dist,
+                              GridView<double> f) {
+  NF_TRACE_SCOPE("propagate_force_downhill");
+  check_same_shape(cell, nucleus, "cell and nucleus arrays should have the same dimensions");
+  check_same_shape(cell, dist, "Cell and distance array dimensions must be identical.");
+  check_same_shape(cell, f, "Cell and force array dimensions must be identical.");
+  const int rows = dist.rows();
+  const int cols = dist.cols();
+
+  // Farthest first, and backwards through the pixels at the same distance, the order
+  // the level engine visits pixels in
+  std::vector<std::pair<double, int>> order;
+  for (int y = 0; y < rows; ++y) {
+    for (int x = 0; x < cols; ++x) {
+      if (dist(y, x) > 0) order.emplace_back(dist(y, x), y * cols + x);
+    }
+  }
+  std::sort(order.begin(), order.end(), std::greater<std::pair<double, int>>());
+
+  [[maybe_unused]] long long visited = 0;
+  for (const std::pair<double, int>& entry : order) {
+    const double d = entry.first;
+    int y = entry.second / cols;
+    int x = entry.second - y * cols;
+    double& value = f(y, x);
+    if (value == 0) continue;
+    ++visited;
+
+    double drop[4];
+    double total = 0;
+    int i = 0;
+    for_each_neighbour<Connectivity::Four>([&](int oy, int ox) {
+      int ny = y + oy;
+      int nx = x + ox;
+      bool lower = ny >= 0 && ny < rows && nx >= 0 && nx < cols &&
+                   (cell(ny, nx) == 1 || nucleus(ny, nx) == 1) && dist(ny, nx) >= 0 && dist(ny, nx) < d;
+      drop[i] = lower ? d - dist(ny, nx) : 0;
+      total += drop[i++];
+    });
+
+    // A pixel with nowhere lower to go cannot pass its force on to the nucleus
+    if (total > 0) {
+      i = 0;
+      for_each_neighbour<Connectivity::Four>([&](int oy, int ox) {
+        if (drop[i] > 0) f(y + oy, x + ox) += value * drop[i] / total;
+        ++i;
+      });
+    }
+    value = 0;
+  }
+  NF_TRACE_COUNT("downhill_pixels_visited", visited);
+
+  for (int y = 0; y < rows; ++y) {
+    for (int x = 0; x < cols; ++x) {
+      if (cell(y, x) == 1 && dist(y, x) < 0) f(y, x) = 0;
+    }
+  }
+}
+
+void propagate_force(GridView<const int> cell,
+                     GridView<const int> nucleus,
+                     GridView<const int> dist,
+                     const DistanceLevels& levels,
+                     GridView<double> f,
+                     ThreadPool& pool) {
+  NF_TRACE_SCOPE("propagate_force");
+  check_same_shape(cell, nucleus, "cell and nucleus arrays should have the same dimensions");
+  check_same_shape(cell, dist, "Cell and distance array dimensions must be identical.");
+  check_same_shape(cell, f, "Cell and force array dimensions must be identical.");
+  const int rows = dist.rows();
+  const int cols = dist.cols();
+
+  PixelHeap q;
+  overlap_queue(cell, f, levels, q);
+
+  // Levels are thin rings, so split them finely
+  const int grain = 256;
+
+  for (int d = levels.count() - 1; d >= 1; --d) {
+    const int* level = levels.begin(d);
+    const int* next_level = levels.begin(d - 1);
+
+    // Replace the force on each pixel of this level with the share each of its
+    // neighbours one level closer receives
+    pool.parallel_for(0, levels.size(d), [&](int begin, int end) {
+      for (int i = begin; i < end; ++i) {
+        int y = level[i] / cols;
+        int x = level[i] - y * cols;
+        double& value = f(y, x);
+        if (value == 0) continue;
+
+        int count = (x + 1 < cols && dist(y, x + 1) == d - 1) +
+                    (y + 1 < rows && dist(y + 1, x) == d - 1) +
+                    (x > 0 && dist(y, x - 1) == d - 1) +
+                    (y > 0 && dist(y - 1, x) == d - 1);
+        value /= count;
+      }
+    }, grain);
+
+    // Gather the shares in descending source order (down, right, left, up), which is
+    // the order the serial engine adds them in
+    pool.parallel_for(0, levels.size(d - 1), [&](int begin, int end) {
+      for (int i = begin; i < end; ++i) {
+        int y = next_level[i] / cols;
+        int x = next_level[i] - y * cols;
+        double& value = f(y, x);
+        if (y + 1 < rows && dist(y + 1, x) == d && f(y + 1, x) != 0) value += f(y + 1, x);
+        if (x + 1 < cols && dist(y, x + 1) == d && f(y, x + 1) != 0) value += f(y, x + 1);
+        if (x > 0 && dist(y, x - 1) == d && f(y, x - 1) != 0) value += f(y, x - 1);
+        if (y > 0 && dist(y - 1, x) == d && f(y - 1, x) != 0) value += f(y - 1, x);
+      }
+    }, grain);
+
+    pool.parallel_for(0, levels.size(d), [&](int begin, int end) {
+      for (int i = begin; i < end; ++i) {
+        int y = level[i] / cols;
+        f(y, level[i] - y * cols) = 0;
+      }
+    }, grain);
+  }
+
+  drain_queue<Connectivity::Four>(cell, nucleus, dist, f, q);
+
+  pool.parallel_for(0, rows, [&](int begin, int end) {
+    clear_unreached(cell, dist, f, begin, end);
+  }, 16);
+}
+
+/**
+  * @brief Propagate force_at(y, x) through the levels one level buffer at a time and sum it on the nucleus
+  */
+template <typename ForceAt>
+static std::vector<double> net_force_levels(GridView<const int> cell,
+                                            GridView<const int> nucleus,
+                                            GridView<const int> dist,
+                                            const DistanceLevels& levels,
+                                            ForceAt force_at,
+                                            const std::vector<double>& centroid) {
+  const int rows = dist.rows();
+  const int cols = dist.cols();
+  std::vector<double> f_net(2, 0);
+  if (levels.count() == 0) return f_net;
+
+  auto load = [&](int d, std::vector<double>& values) {
+    values.resize(levels.size(d));
+    const int* level = levels.begin(d);
+    for (int k = 0; k < levels.size(d); ++k) {
+      values[k] = force_at(level[k] / cols, level[k] % cols);
+    }
+  };
+
+  // Force on the pixels of the level being passed on and of the level below it
+  std::vector<double> upper;
+  std::vector<double> lower;
+  load(levels.count() - 1, upper);
+
+  for (int d = levels.count() - 1; d >= 1; --d) {
+    load(d - 1, lower);
+    const int* level = levels.begin(d);
+    const int* next = levels.begin(d - 1);
+
+    // Position in the level below of each neighbour. Pixels are visited in descending
+    // order as in propagate_force, so the neighbours in each direction only move down.
+    int cursor[4] = {levels.size(d - 1) - 1, levels.size(d - 1) - 1, levels.size(d - 1) - 1,
+                     levels.size(d - 1) - 1};
+    auto slot = [&](int direction, int q) {
+      int& c = cursor[direction];
+      while (next[c] > q) --c;
+      return c;
+    };
+
+    for (int k = levels.size(d) - 1; k >= 0; --k) {
+      double value = upper[k];
+      if (value == 0) continue;
+      int p = level[k];
+      int y = p / cols;
+      int x = p - y * cols;
+
+      bool right = x + 1 < cols && dist(y, x + 1) == d - 1;
+      bool down = y + 1 < rows && dist(y + 1, x) == d - 1;
+      bool left = x > 0 && dist(y, x - 1) == d - 1;
+      bool up = y > 0 && dist(y - 1, x) == d - 1;
+      double share = value / (right + down + left + up);
+
+      if (right) lower[slot(0, p + 1)] += share;
+      if (down) lower[slot(1, p + cols)] += share;
+      if (left) lower[slot(2, p - 1)] += share;
+      if (up) lower[slot(3, p - cols)] += share;
+    }
+    std::swap(upper, lower);
+  }
+
+  // Pull of force ending on a nucleus pixel, as in find_force_vector
+  auto pull = [&](int p, double& gx, double& gy) {
+    double dy = centroid[1] - p / cols;
+    double dx = centroid[0] - p % cols;
+    double mag = std::sqrt(dy * dy + dx * dx);
+    gx = dx / mag;
+    gy = dy / mag;
+  };
+
+  // Overlap pixels that start with force pass everything on them on through drain_queue
+  const int* level = levels.begin(0);
+  std::vector<int> queued;
+  for (int k = 0; k < levels.size(0); ++k) {
+    int y = level[k] / cols;
+    int x = level[k] - y * cols;
+    if (cell(y, x) == 1 && force_at(y, x) != 0) queued.push_back(level[k]);
+  }
+
+  for (int k = 0; k < levels.size(0); ++k) {
+    double value = upper[k];
+    if (value == 0) continue;
+    int p = level[k];
+    double gx = 0;
+    double gy = 0;
+    if (!queued.empty() && std::binary_search(queued.begin(), queued.end(), p)) {
+      for (const std::pair<int, double>& share : drain_shares(cell, nucleus, dist, queued, p)) {
+        double sx, sy;
+        pull(share.first, sx, sy);
+        gx += share.second * sx;
+        gy += share.second * sy;
+      }
+    } else {
+      pull(p, gx, gy);
+    }
+    f_net[0] += gx * value;
+    f_net[1] += gy * value;
+  }
+
+  return f_net;
+}
+
+std::vector<double> propagate_net_force(GridView<const int> cell,
+                                        GridView<const int> nucleus,
+                                        GridView<const int> dist,
+                                        const DistanceLevels& levels,
+                                        GridView<const double> force,
+                                        const std::vector<double>& centroid) {
+  check_same_shape(dist, force, "Distance and force array dimensions must be identical.");
+  return net_force_levels(cell, nucleus, dist, levels, [&](int y, int x) { return force(y, x); }, centroid);
+}
+
+std::vector<double> propagate_boundary_net_force(GridView<const int> cell,
+                                                 GridView<const int> nucleus,
+                                                 GridView<const int> dist,
+                                                 const DistanceLevels& levels,
+                                                 const std::vector<double>& centroid) {
+  return net_force_levels(cell, nucleus, dist, levels,
+                          [&](int y, int x) { return is_boundary(cell, nucleus, y, x) ? 1.0 : 0.0; }, centroid);
+}
+
+/**
+  * @brief Walk the levels of propagate_force backwards, splitting each level with run
+  *
+  * run(n, body) calls body over chunks of [0, n).
+  */
+template <typename Run>
+static void adjoint_levels(GridView<const int> cell,
+                           GridView<const int> nucleus,
+                           GridView<const int> dist,
+                           const DistanceLevels& levels,
+                           GridView<const double> force,
+                           GridView<double> weight,
+                           Run run) {
+  check_same_shape(dist, force, "Distance and force array dimensions must be identical.");
+  check_same_shape(dist, weight, "Distance and weight array dimensions must be identical.");
+
+  const int rows = dist.rows();
+  const int cols = dist.cols();
+
+  // Unreached cell pixels lose their force
+  run(rows, [&](int begin, int end) {
+    for (int y = begin; y < end; ++y) {
+      for (int x = 0; x < cols; ++x) {
+        if (cell(y, x) == 1 && dist(y, x) == -1) weight(y, x) = 0;
+      }
+    }
+  });
+  if (levels.count() == 0) return;
+
+  // Overlap pixels with force pass it on through drain_queue, reading the weights of
+  // the nucleus before any of them change
+  std::vector<int> queued;
+  for (const int* p = levels.begin(0); p != levels.end(0); ++p) {
+    int y = *p / cols;
+    int x = *p - y * cols;
+    if (cell(y, x) == 1 && force(y, x) != 0) queued.push_back(*p);
+  }
+  std::vector<double> drained(queued.size());
+  run(static_cast<int>(queued.size()), [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      double sum = 0;
+      for (const std::pair<int, double>& share : drain_shares(cell, nucleus, dist, queued, queued[i])) {
+        sum += share.second * weight(share.first / cols, share.first % cols);
+      }
+      drained[i] = sum;
+    }
+  });
+  for (size_t i = 0; i < queued.size(); ++i) {
+    weight(queued[i] / cols, queued[i] % cols) = drained[i];
+  }
+
+  // Each pixel's force is split evenly between its neighbours one level closer
+  for (int d = 1; d < levels.count(); ++d) {
+    const int* level = levels.begin(d);
+    run(levels.size(d), [&](int begin, int end) {
+      for (int i = begin; i < end; ++i) {
+        int y = level[i] / cols;
+        int x = level[i] - y * cols;
+        double sum = 0;
+        int count = 0;
+        auto add = [&](int ny, int nx) {
+          if (dist(ny, nx) == d - 1) {
+            sum += weight(ny, nx);
+            count++;
+          }
+        };
+        if (y + 1 < rows) add(y + 1, x);
+        if (x + 1 < cols) add(y, x + 1);
+        if (x > 0) add(y, x - 1);
+        if (y > 0) add(y - 1, x);
+        weight(y, x) = sum / count;
+      }
+    });
+  }
+}
+
+void propagate_adjoint(GridView<const int> cell,
+                       GridView<const int> nucleus,
+                       GridView<const int> dist,
+                       const DistanceLevels& levels,
+                       GridView<const double> force,
+                       GridView<double> weight) {
+  adjoint_levels(cell, nucleus, dist, levels, force, weight,
+                 [](int n, const std::function<void(int, int)>& body) { body(0, n); });
+}
+
+void propagate_adjoint(GridView<const int> cell,
+                       GridView<const int> nucleus,
+                       GridView<const int> dist,
+                       const DistanceLevels& levels,
+                       GridView<const double> force,
+                       GridView<double> weight,
+                       ThreadPool& pool) {
+  adjoint_levels(cell, nucleus, dist, levels, force, weight,
+                 [&](int n, const std::function<void(int, int)>& body) { pool.parallel_for(0, n, body, 256); });
+}
+
+/**
+  * @brief Flux arriving at (y, x) from its neighbours at distance d + 1, added to value
+  *
+  * Shares are added in descending source order (down, right, left, up) and zero shares
+  * are skipped, as in propagate_force.
+  */
+static double gather_flux(GridView<const int> dist, GridView<const double> flux, int y, int x, double value) {
+  const int rows = dist.rows();
+  const int cols = dist.cols();
+  const int d = dist(y, x);
+
+  // Number of neighbours of (ny, nx) at distance d, which share its flux
+  auto count = [&](int ny, int nx) {
+    return (nx + 1 < cols && dist(ny, nx + 1) == d) + (ny + 1 < rows && dist(ny + 1, nx) == d) +
+           (nx > 0 && dist(ny, nx - 1) == d) + (ny > 0 && dist(ny - 1, nx) == d);
+  };
+  auto add = [&](int ny, int nx) {
+    if (dist(ny, nx) == d + 1 && flux(ny, nx) != 0) value += flux(ny, nx) / count(ny, nx);
+  };
+
+  if (y + 1 < rows) add(y + 1, x);
+  if (x + 1 < cols) add(y, x + 1);
+  if (x > 0) add(y, x - 1);
+  if (y > 0) add(y - 1, x);
+  return value;
+}
+
+void find_flux(GridView<const int> dist, const DistanceLevels& levels, GridView<double> flux) {
+  for (int d = levels.count() - 1; d >= 1; --d) {
+    for (const int* p = levels.begin(d - 1); p != levels.end(d - 1); ++p) {
+      int y = *p / levels.cols;
+      int x = *p - y * levels.cols;
+      flux(y, x) = gather_flux(dist, flux, y, x, flux(y, x));
+    }
+  }
+}
+
+std::vector<int> update_flux(GridView<const int> dist,
+                             GridView<const double> force,
+                             const std::vector<int>& dirty,
+                             GridView<double> flux) {
+  std::vector<unsigned char> marks(static_cast<size_t>(dist.rows()) * dist.cols(), 0);
+  return update_flux(dist, force, dirty, flux, marks);
+}
+
+std::vector<int> update_flux(GridView<const int> dist,
+                             GridView<const double> force,
+                             const std::vector<int>& dirty,
+                             GridView<double> flux,
+                             std::vector<unsigned char>& marks) {
+  check_same_shape(dist, force, "Distance and force array dimensions must be identical.");
+  check_same_shape(dist, flux, "Distance and flux array dimensions must be identical.");
+  if (marks.size() != static_cast<size_t>(dist.rows()) * dist.cols()) {
+    throw std::invalid_argument("marks should have one element per pixel");
+  }
+
+  const int rows = dist.rows();
+  const int cols = dist.cols();
+
+  // 1 once queued for recomputation, 2 if also dirty
+  std::vector<unsigned char>& state = marks;
+  std::vector<int> marked;
+  std::vector<std::vector<int>> buckets;
+  std::vector<int> changed;
+
+  for (int p : dirty) {
+    if (state[p] == 2) continue;
+    int y = p / cols;
+    int x = p - y * cols;
+    if (state[p] == 0) marked.push_back(p);
+    state[p] = 2;
+    int d = dist(y, x);
+    if (d < 0) {
+      // Unreached pixels keep their own force
+      if (flux(y, x) != force(y, x)) {
+        flux(y, x) = force(y, x);
+        changed.push_back(p);
+      }
+      continue;
+    }
+    if (d >= static_cast<int>(buckets.size())) buckets.resize(d + 1);
+    buckets[d].push_back(p);
+  }
+
+  for (int d = static_cast<int>(buckets.size()) - 1; d >= 0; --d) {
+    for (int p : buckets[d]) {
+      int y = p / cols;
+      int x = p - y * cols;
+      double value = gather_flux(dist, flux, y, x, force(y, x));
+      bool differs = value != flux(y, x);
+      if (differs) {
+        flux(y, x) = value;
+        changed.push_back(p);
+      }
+      if ((!differs && state[p] != 2) || d == 0) continue;
+
+      // The shares of the neighbours one level closer depend on this pixel
+      for (int i = 0; i < 4; ++i) {
+        int ny = y + dy[i];
+        int nx = x + dx[i];
+        if (ny < 0 || ny >= rows || nx < 0 || nx >= cols || dist(ny, nx) != d - 1) continue;
+        int q = ny * cols + nx;
+        if (state[q] == 0) {
+          state[q] = 1;
+          marked.push_back(q);
+          buckets[d - 1].push_back(q);
+        }
+      }
+    }
+  }
+
+  for (int p : marked) {
+    state[p] = 0;
+  }
+  std::sort(changed.begin(), changed.end());
+  return changed;
+}
+} // namespace nucleusforce
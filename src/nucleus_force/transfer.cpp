@@ -0,0 +1,274 @@
+#include <nucleus_force/transfer.h>
+
+#include <common/thread_pool.h>
+#include <nucleus_force/nucleus_force.h>
+#include <nucleus_force/propagation.h>
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace nucleusforce {
+/**
+  * @brief Share of a pixel's force that reaches each output pixel, sorted by output
+  */
+using Shares = std::vector<std::pair<int, double>>;
+
+/**
+  * @brief One element of the matrix before it is compressed
+  */
+struct Element {
+  int output;
+  int input;
+  double weight;
+};
+
+/**
+  * @brief Shares of one neighbour closer to the nucleus
+  */
+struct Source {
+  const std::pair<int, double>* next;
+  const std::pair<int, double>* end;
+};
+
+/**
+  * @brief Merge the shares of up to 4 sources, each sorted by output, and divide them by count
+  *
+  * Shares of the same output are added in source order, so the result does not depend on
+  * how the level is split between threads.
+  */
+static void merge_shares(Source* sources, int n, int count, Shares& shares) {
+  size_t total = 0;
+  for (int s = 0; s < n; ++s) {
+    total += sources[s].end - sources[s].next;
+  }
+  shares.reserve(total);
+
+  while (true) {
+    int output = INT_MAX;
+    for (int s = 0; s < n; ++s) {
+      if (sources[s].next != sources[s].end) output = std::min(output, sources[s].next->first);
+    }
+    if (output == INT_MAX) break;
+
+    double sum = 0;
+    for (int s = 0; s < n; ++s) {
+      if (sources[s].next != sources[s].end && sources[s].next->first == output) {
+        sum += sources[s].next->second;
+        ++sources[s].next;
+      }
+    }
+    shares.emplace_back(output, sum / count);
+  }
+}
+
+TransferOperator::TransferOperator(GridView<const int> cell,
+                                   GridView<const int> nucleus,
+                                   GridView<const int> dist,
+                                   GridView<const int> inputs,
+                                   unsigned threads)
+    : rows_(cell.rows()), cols_(cell.cols()), threads_(threads) {
+  check_same_shape(cell, nucleus, "cell and nucleus arrays should have the same dimensions");
+  check_same_shape(cell, dist, "Cell and distance array dimensions must be identical.");
+  check_same_shape(cell, inputs, "Cell and input array dimensions must be identical.");
+
+  const int rows = rows_;
+  const int cols = cols_;
+  Grid<int> input_index(rows, cols, -1);
+  std::vector<int> queued; // Overlap pixels whose force drain_queue moves on
+  std::vector<Element> elements;
+
+  for (int y = 0; y < rows; ++y) {
+    for (int x = 0; x < cols; ++x) {
+      if (inputs(y, x) == 0) continue;
+      int i = static_cast<int>(inputs_.size());
+      input_index(y, x) = i;
+      inputs_.push_back(y * cols + x);
+      if (cell(y, x) == 1 && nucleus(y, x) == 1) {
+        queued.push_back(y * cols + x);
+        overlap_inputs_.push_back(i);
+      }
+      // Force outside the cell and nucleus stays put, and force in unreached parts of the cell is dropped
+      if (dist(y, x) < 0 && cell(y, x) != 1) {
+        elements.push_back({y * cols + x, i, 1.0});
+      }
+    }
+  }
+
+  DistanceLevels levels = build_levels(dist);
+  ThreadPool pool(threads);
+
+  // Where the force of each pixel ends up is where the force of its neighbours one level
+  // closer ends up, split between them. Build that outwards from the nucleus, keeping
+  // only two levels and the columns of the input pixels.
+  std::vector<Shares> lower;
+  Grid<int> slot(rows, cols, -1);
+  for (int d = 0; d < levels.count(); ++d) {
+    const int* level = levels.begin(d);
+    for (int k = 0; k < levels.size(d); ++k) {
+      slot.data()[level[k]] = k;
+    }
+
+    std::vector<Shares> current(levels.size(d));
+    pool.parallel_for(0, levels.size(d), [&](int begin, int end) {
+      for (int k = begin; k < end; ++k) {
+        int y = level[k] / cols;
+        int x = level[k] - y * cols;
+        if (d == 0) {
+          // Force left on an overlap pixel that carries force is moved on by drain_queue
+          if (std::binary_search(queued.begin(), queued.end(), level[k])) {
+            current[k] = drain_shares(cell, nucleus, dist, queued, level[k]);
+          } else {
+            current[k].emplace_back(level[k], 1.0);
+          }
+          continue;
+        }
+
+        // Same neighbours and split as propagate_force, taken down, right, left, up
+        Source sources[4];
+        int n = 0;
+        auto add = [&](int ny, int nx) {
+          if (dist(ny, nx) != d - 1) return;
+          const Shares& to = lower[slot(ny, nx)];
+          sources[n++] = {to.data(), to.data() + to.size()};
+        };
+        if (y + 1 < rows) add(y + 1, x);
+        if (x + 1 < cols) add(y, x + 1);
+        if (x > 0) add(y, x - 1);
+        if (y > 0) add(y - 1, x);
+        merge_shares(sources, n, n, current[k]);
+      }
+    }, 64);
+
+    for (int k = 0; k < levels.size(d); ++k) {
+      int i = input_index.data()[level[k]];
+      if (i < 0) continue;
+      for (const std::pair<int, double>& share : current[k]) {
+        elements.push_back({share.first, i, share.second});
+      }
+    }
+    lower = std::move(current);
+  }
+
+  // Compress into one row per output pixel
+  std::sort(elements.begin(), elements.end(), [](const Element& a, const Element& b) {
+    return a.output != b.output ? a.output < b.output : a.input < b.input;
+  });
+  row_offsets_.push_back(0);
+  for (const Element& element : elements) {
+    if (outputs_.empty() || outputs_.back() != element.output) {
+      outputs_.push_back(element.output);
+      row_offsets_.push_back(row_offsets_.back());
+    }
+    input_of_.push_back(element.input);
+    weights_.push_back(element.weight);
+    row_offsets_.back()++;
+  }
+}
+
+Grid<double> TransferOperator::apply_loads(GridView<const double> loads) const {
+  if (loads.cols() != static_cast<int>(inputs_.size())) {
+    throw std::invalid_argument("loads should have one column per input pixel");
+  }
+  // Without force of its own an overlap pixel keeps what reaches it, which the matrix cannot express
+  for (int k = 0; k < loads.rows(); ++k) {
+    for (int i : overlap_inputs_) {
+      if (loads(k, i) == 0) {
+        int p = inputs_[i];
+        throw std::invalid_argument("Cell and nucleus pixel (" + std::to_string(p / cols_) + ", " +
+                                    std::to_string(p % cols_) + ") is an input without force.");
+      }
+    }
+  }
+
+  // Interleave the fields so each element updates all of them from one contiguous run
+  const int fields = loads.rows();
+  std::vector<double> in(inputs_.size() * fields);
+  for (int k = 0; k < fields; ++k) {
+    for (size_t i = 0; i < inputs_.size(); ++i) {
+      in[i * fields + k] = loads(k, static_cast<int>(i));
+    }
+  }
+
+  Grid<double> out(fields, static_cast<int>(outputs_.size()));
+  ThreadPool pool(threads_);
+  pool.parallel_for(0, static_cast<int>(outputs_.size()), [&](int begin, int end) {
+    std::vector<double> sum(fields);
+    for (int o = begin; o < end; ++o) {
+      std::fill(sum.begin(), sum.end(), 0.0);
+      for (size_t e = row_offsets_[o]; e < row_offsets_[o + 1]; ++e) {
+        const double weight = weights_[e];
+        const double* source = &in[static_cast<size_t>(input_of_[e]) * fields];
+        for (int k = 0; k < fields; ++k) {
+          sum[k] += weight * source[k];
+        }
+      }
+      for (int k = 0; k < fields; ++k) {
+        out(k, o) = sum[k];
+      }
+    }
+  }, 256);
+
+  return out;
+}
+
+/**
+  * @brief Force on the input pixels of each field, one row per field
+  */
+Grid<double> TransferOperator::loads_of(const std::vector<GridView<const double>>& forces) const {
+  Grid<double> loads(static_cast<int>(forces.size()), static_cast<int>(inputs_.size()));
+  std::vector<unsigned char> is_input(static_cast<size_t>(rows_) * cols_, 0);
+  for (int p : inputs_) {
+    is_input[p] = 1;
+  }
+
+  for (size_t k = 0; k < forces.size(); ++k) {
+    GridView<const double> force = forces[k];
+    if (force.rows() != rows_ || force.cols() != cols_) {
+      throw std::invalid_argument("Cell, nucleus, and force array dimensions must be identical.");
+    }
+    for (int y = 0; y < rows_; ++y) {
+      const double* row = force.row(y);
+      for (int x = 0; x < cols_; ++x) {
+        if (row[x] != 0 && !is_input[y * cols_ + x]) {
+          throw std::invalid_argument("Force at (" + std::to_string(y) + ", " + std::to_string(x) +
+                                      ") is outside the input pixels of the transfer operator.");
+        }
+      }
+    }
+    for (size_t i = 0; i < inputs_.size(); ++i) {
+      loads(static_cast<int>(k), static_cast<int>(i)) = force(inputs_[i] / cols_, inputs_[i] % cols_);
+    }
+  }
+  return loads;
+}
+
+/**
+  * @brief Spread row field of values over the output pixels of a full-size grid
+  */
+Grid<double> TransferOperator::scatter(GridView<const double> values, int field) const {
+  Grid<double> f(rows_, cols_);
+  const double* row = values.row(field);
+  for (size_t o = 0; o < outputs_.size(); ++o) {
+    f.data()[outputs_[o]] = row[o];
+  }
+  return f;
+}
+
+Grid<double> TransferOperator::apply(GridView<const double> force) const {
+  return scatter(apply_loads(loads_of({force})), 0);
+}
+
+std::vector<Grid<double>> TransferOperator::apply(const std::vector<Grid<double>>& forces) const {
+  std::vector<GridView<const double>> views(forces.begin(), forces.end());
+  Grid<double> out = apply_loads(loads_of(views));
+
+  std::vector<Grid<double>> results;
+  results.reserve(forces.size());
+  for (int k = 0; k < out.rows(); ++k) {
+    results.push_back(scatter(out, k));
+  }
+  return results;
+}
+} // namespace nucleusforce
@@ -0,0 +1,200 @@
+#include <gtest/gtest.h>
+#include <batch/time_lapse.h>
+#include <nucleus_force/force_map.h>
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace nucleusforce;
+using namespace nucleusforce::batch;
+namespace fs = std::filesystem;
+
+/**
+  * @brief Cell disk with a nucleus disk that moves right by shift pixels
+  */
+static cv::Mat make_frame(int shift, Grid<int>& cell, Grid<int>& nucleus) {
+  const int size = 48;
+  cv::Mat image(size, size, CV_8UC3);
+  cell = Grid<int>(size, size);
+  nucleus = Grid<int>(size, size);
+  for (int y = 0; y < size; ++y) {
+    for (int x = 0; x < size; ++x) {
+      int cx = x - size / 2;
+      int cy = y - size / 2;
+      int nx = cx - shift;
+      cv::Vec3b color(0, 0, 0);
+      if (nx * nx + cy * cy <= 36) {
+        color = cv::Vec3b(0, 255, 0);
+        nucleus(y, x) = 1;
+      } else if (cx * cx + cy * cy <= 400) {
+        color = cv::Vec3b(255, 0, 255);
+        cell(y, x) = 1;
+      }
+      image.at<cv::Vec3b>(y, x) = color;
+    }
+  }
+  return image;
+}
+
+class BatchTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    dir_ = fs::temp_directory_path() / ("nucleusforce_batch_test_" +
+                                        std::string(::testing::UnitTest::GetInstance()->current_test_info()->name()));
+    fs::remove_all(dir_);
+    fs::create_directories(dir_ / "frames");
+    for (int t = 0; t < 6; ++t) {
+      Grid<int> cell, nucleus;
+      cv::Mat image = make_frame(t - 3, cell, nucleus);
+      std::string name = "t_" + std::to_string(t) + ".png";
+      ASSERT_TRUE(cv::imwrite((dir_ / "frames" / name).string(), image));
+      cells_.push_back(cell);
+      nuclei_.push_back(nucleus);
+    }
+  }
+
+  void TearDown() override { fs::remove_all(dir_); }
+
+  fs::path dir_;
+  std::vector<Grid<int>> cells_;
+  std::vector<Grid<int>> nuclei_;
+};
+
+TEST_F(BatchTest, DirectoryListsEveryImageInOrder) {
+  std::ofstream(dir_ / "frames" / "notes.txt") << "not a frame";
+
+  std::vector<std::string> files = find_frame_files((dir_ / "frames").string());
+
+  ASSERT_EQ(files.size(), 6);
+  for (int t = 0; t < 6; ++t) {
+    ASSERT_EQ(fs::path(files[t]).filename(), "t_" + std::to_string(t) + ".png");
+  }
+}
+
+TEST_F(BatchTest, GlobListsMatchingFiles) {
+  std::vector<std::string> files = find_frame_files((dir_ / "frames" / "t_?.png").string());
+  ASSERT_EQ(files.size(), 6);
+
+  files = find_frame_files((dir_ / "frames" / "*_4.png").string());
+  ASSERT_EQ(files.size(), 1);
+  ASSERT_EQ(fs::path(files[0]).filename(), "t_4.png");
+}
+
+TEST_F(BatchTest, MissingInputShouldThrowError) {
+  ASSERT_THROW(find_frame_files((dir_ / "missing").string()), std::invalid_argument);
+  ASSERT_THROW(find_frame_files((dir_ / "frames" / "*.tif").string()), std::invalid_argument);
+}
+
+TEST_F(BatchTest, ResultsMatchForceMapInFrameOrder) {
+  BatchOptions options;
+  options.threads = 3;
+  options.max_in_flight = 1;
+
+  std::vector<FrameResult> results = run_batch((dir_ / "frames").string(), options);
+
+  ASSERT_EQ(results.size(), 6);
+  for (int t = 0; t < 6; ++t) {
+    ForceMap force_map(cells_[t], nuclei_[t]);
+    ASSERT_EQ(results[t].index, t);
+    ASSERT_EQ(results[t].name, "t_" + std::to_string(t));
+    ASSERT_TRUE(results[t].ok) << results[t].error;
+    // The batch works on the crop around the cell, which rounds differently
+    std::vector<double> centroid = force_map.centroid();
+    std::vector<double> force_vector = force_map.force_vector();
+    for (int i = 0; i < 2; ++i) {
+      ASSERT_NEAR(results[t].centroid[i], centroid[i], 1e-9);
+      ASSERT_NEAR(results[t].force_vector[i], force_vector[i], 1e-9);
+    }
+  }
+}
+
+TEST_F(BatchTest, UnreadableFrameIsReportedWithoutStoppingBatch) {
+  std::ofstream(dir_ / "frames" / "t_3.png", std::ios::trunc) << "not a png";
+
+  BatchOptions options;
+  options.threads = 2;
+
+  std::vector<FrameResult> results = run_batch((dir_ / "frames").string(), options);
+
+  ASSERT_EQ(results.size(), 6);
+  for (int t = 0; t < 6; ++t) {
+    ASSERT_EQ(results[t].ok, t != 3);
+  }
+  ASSERT_FALSE(results[3].error.empty());
+}
+
+TEST_F(BatchTest, OutputDirectoryGetsFrameCsvsAndSummary) {
+  BatchOptions options;
+  options.threads = 2;
+  options.output_dir = (dir_ / "output").string();
+
+  std::vector<FrameResult> results = run_batch((dir_ / "frames" / "t_*.png").string(), options);
+
+  for (const FrameResult& result : results) {
+    ASSERT_TRUE(fs::exists(dir_ / "output" / (result.name + "_boundary.csv")));
+    ASSERT_TRUE(fs::exists(dir_ / "output" / (result.name + "_dist.csv")));
+    ASSERT_TRUE(fs::exists(dir_ / "output" / (result.name + "_force.csv")));
+  }
+
+  std::ifstream summary(dir_ / "output" / "summary.csv");
+  std::string line;
+  std::vector<std::string> lines;
+  while (std::getline(summary, line)) {
+    lines.push_back(line);
+  }
+  ASSERT_EQ(lines.size(), 7);
+  ASSERT_EQ(lines[0], "frame,name,centroid_x,centroid_y,force_x,force_y,error");
+  ASSERT_EQ(lines[1].rfind("0,\"t_0\",", 0), 0);
+}
+
+TEST_F(BatchTest, SparseForceIsWrittenAsCoordinates) {
+  BatchOptions options;
+  options.threads = 2;
+  options.output_dir = (dir_ / "output").string();
+  options.sparse_force = true;
+
+  std::vector<FrameResult> results = run_batch((dir_ / "frames").string(), options);
+
+  for (int t = 0; t < 6; ++t) {
+    ForceMap force_map(cells_[t], nuclei_[t]);
+    ASSERT_TRUE(results[t].ok) << results[t].error;
+    std::vector<double> expected = force_map.force_vector();
+    ASSERT_NEAR(results[t].force_vector[0], expected[0], 1e-9);
+    ASSERT_NEAR(results[t].force_vector[1], expected[1], 1e-9);
+
+    std::ifstream file(dir_ / "output" / (results[t].name + "_force.csv"));
+    std::string line;
+    size_t rows = 0;
+    while (std::getline(file, line)) {
+      ASSERT_EQ(std::count(line.begin(), line.end(), ','), 2);
+      rows++;
+    }
+    ASSERT_EQ(rows, force_map.sparse_nucleus_force().nonzeros());
+  }
+}
+
+TEST_F(BatchTest, TraceIsWrittenWithOneThreadPerFrame) {
+  BatchOptions options;
+  options.threads = 2;
+  options.output_dir = (dir_ / "output").string();
+  options.write_trace = true;
+
+  std::vector<FrameResult> results = run_batch((dir_ / "frames").string(), options);
+
+  std::ifstream file(dir_ / "output" / "trace.json");
+  ASSERT_TRUE(file.is_open());
+  std::stringstream contents;
+  contents << file.rdbuf();
+  for (const FrameResult& result : results) {
+    ASSERT_NE(contents.str().find("\"args\":{\"name\":\"" + result.name + "\"}"), std::string::npos);
+#ifdef NUCLEUSFORCE_TRACE
+    ASSERT_FALSE(result.trace.spans().empty());
+    ASSERT_GT(result.trace.counters().at("bytes_written"), 0);
+#endif
+  }
+}
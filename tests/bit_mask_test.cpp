@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include <common/bit_mask.h>
+#include <common/grid.h>
+
+using namespace nucleusforce;
+
+TEST(BitMaskTest, NewMaskIsEmpty) {
+  BitMask mask(3, 130);
+
+  ASSERT_EQ(mask.rows(), 3);
+  ASSERT_EQ(mask.cols(), 130);
+  ASSERT_EQ(mask.words_per_row(), 3);
+  ASSERT_EQ(mask.count(), 0);
+}
+
+TEST(BitMaskTest, SetAndGetAcrossWords) {
+  BitMask mask(2, 100);
+
+  mask.set(0, 0, true);
+  mask.set(0, 63, true);
+  mask.set(1, 64, true);
+  mask.set(1, 99, true);
+
+  ASSERT_TRUE(mask.get(0, 0));
+  ASSERT_TRUE(mask.get(0, 63));
+  ASSERT_FALSE(mask.get(0, 64));
+  ASSERT_TRUE(mask.get(1, 64));
+  ASSERT_TRUE(mask.get(1, 99));
+  ASSERT_EQ(mask.row(1)[1], (uint64_t(1) << 0) | (uint64_t(1) << 35));
+  ASSERT_EQ(mask.count(), 4);
+
+  mask.set(0, 63, false);
+  ASSERT_FALSE(mask.get(0, 63));
+  ASSERT_EQ(mask.count(), 3);
+}
+
+TEST(BitMaskTest, GridRoundTrip) {
+  Grid<int> grid(5, 70);
+  for (int y = 0; y < grid.rows(); ++y) {
+    for (int x = 0; x < grid.cols(); ++x) {
+      grid(y, x) = (x * 3 + y) % 4 == 0;
+    }
+  }
+
+  BitMask mask = BitMask::from_grid(grid);
+
+  ASSERT_EQ(mask.to_grid(), grid);
+  ASSERT_EQ(mask.row(0)[1] & ~mask.last_word_mask(), 0);
+}
+
+TEST(BitMaskTest, OnlyOnesAreSet) {
+  Grid<int> grid(1, 3);
+  grid(0, 0) = 1;
+  grid(0, 1) = 2;
+
+  BitMask mask = BitMask::from_grid(grid);
+
+  ASSERT_TRUE(mask.get(0, 0));
+  ASSERT_FALSE(mask.get(0, 1));
+  ASSERT_FALSE(mask.get(0, 2));
+}
+
+TEST(BitMaskTest, LastWordMaskCoversColumns) {
+  ASSERT_EQ(BitMask(1, 64).last_word_mask(), ~uint64_t(0));
+  ASSERT_EQ(BitMask(1, 65).last_word_mask(), uint64_t(1));
+  ASSERT_EQ(BitMask(1, 3).last_word_mask(), uint64_t(7));
+}
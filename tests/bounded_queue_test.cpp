@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+#include <common/bounded_queue.h>
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace nucleusforce;
+
+TEST(BoundedQueueTest, ZeroCapacityShouldThrowError) {
+  ASSERT_THROW(BoundedQueue<int>(0), std::invalid_argument);
+}
+
+TEST(BoundedQueueTest, PopReturnsItemsInOrder) {
+  BoundedQueue<int> queue(3);
+  queue.push(1);
+  queue.push(2);
+  queue.push(3);
+  queue.close();
+
+  ASSERT_EQ(queue.pop(), 1);
+  ASSERT_EQ(queue.pop(), 2);
+  ASSERT_EQ(queue.pop(), 3);
+  ASSERT_EQ(queue.pop(), std::nullopt);
+}
+
+TEST(BoundedQueueTest, PushAfterCloseIsDropped) {
+  BoundedQueue<int> queue(1);
+  queue.close();
+
+  ASSERT_FALSE(queue.push(1));
+  ASSERT_EQ(queue.pop(), std::nullopt);
+}
+
+TEST(BoundedQueueTest, PushWaitsWhileFull) {
+  BoundedQueue<int> queue(2);
+  std::atomic<int> pushed{0};
+
+  std::thread producer([&] {
+    for (int i = 0; i < 5; ++i) {
+      queue.push(i);
+      pushed++;
+    }
+    queue.close();
+  });
+
+  // The producer can only get as far as the capacity until something is popped
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  ASSERT_EQ(pushed.load(), 2);
+
+  std::vector<int> popped;
+  while (std::optional<int> item = queue.pop()) {
+    popped.push_back(*item);
+  }
+  producer.join();
+
+  ASSERT_EQ(popped, std::vector<int>({0, 1, 2, 3, 4}));
+}
@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include <nucleus_force/cells.h>
+#include <nucleus_force/force_map.h>
+#include <cmath>
+#include <vector>
+
+using namespace nucleusforce;
+
+/**
+  * @brief Draw a round cell with a round nucleus at its centre
+  */
+static void draw_cell(Grid<int>& cell, Grid<int>& nucleus, int cy, int cx, double r_cell, double r_nucleus) {
+  for (int y = 0; y < cell.rows(); ++y) {
+    for (int x = 0; x < cell.cols(); ++x) {
+      double r = std::hypot(y - cy, x - cx);
+      if (r < r_nucleus) {
+        nucleus(y, x) = 1;
+      } else if (r < r_cell) {
+        cell(y, x) = 1;
+      }
+    }
+  }
+}
+
+TEST(CellsTest, ComponentsAreNumberedInRowMajorOrder) {
+  Grid<int> mask = Grid<int>::from_vector({
+    {0, 1, 0, 0, 1},
+    {1, 1, 0, 1, 1},
+    {0, 0, 0, 0, 0},
+    {1, 0, 1, 1, 0},
+  });
+
+  Labels labels = label_components(mask);
+
+  std::vector<std::vector<int>> true_labels = {
+    {0, 1, 0, 0, 2},
+    {1, 1, 0, 2, 2},
+    {0, 0, 0, 0, 0},
+    {3, 0, 4, 4, 0},
+  };
+  ASSERT_EQ(labels.count, 4);
+  ASSERT_EQ(labels.grid.to_vector(), true_labels);
+}
+
+TEST(CellsTest, TouchingCellsAreSplitBetweenTheirNuclei) {
+  Grid<int> cell(5, 11, 1);
+  Grid<int> nucleus(5, 11, 0);
+  nucleus(2, 1) = 1;
+  nucleus(2, 9) = 1;
+  cell(2, 1) = 0;
+  cell(2, 9) = 0;
+
+  CellLabels labels = label_cells(cell, nucleus);
+
+  ASSERT_EQ(labels.count, 2);
+  ASSERT_EQ(labels.nuclei(2, 1), 1);
+  ASSERT_EQ(labels.nuclei(2, 9), 2);
+  for (int y = 0; y < 5; ++y) {
+    for (int x = 0; x < 11; ++x) {
+      if (cell(y, x) == 0) {
+        ASSERT_EQ(labels.cells(y, x), 0);
+      } else if (x < 5) {
+        ASSERT_EQ(labels.cells(y, x), 1);
+      } else if (x > 5) {
+        ASSERT_EQ(labels.cells(y, x), 2);
+      } else {
+        ASSERT_NE(labels.cells(y, x), 0);
+      }
+    }
+  }
+}
+
+TEST(CellsTest, CellWithoutNucleusIsNotLabelled) {
+  Grid<int> cell(6, 6);
+  Grid<int> nucleus(6, 6);
+  cell(1, 1) = 1;
+
+  CellLabels labels = label_cells(cell, nucleus);
+
+  ASSERT_EQ(labels.count, 0);
+  ASSERT_EQ(labels.cells(1, 1), 0);
+  ASSERT_TRUE(find_cell_forces(labels).empty());
+}
+
+TEST(CellsTest, EachCellMatchesItsOwnForceMap) {
+  const int rows = 70;
+  const int cols = 90;
+  struct Disk {
+    int cy, cx;
+    double r_cell, r_nucleus;
+  };
+  std::vector<Disk> disks = {{15, 15, 12, 4}, {40, 60, 20, 7}, {55, 15, 8, 3}};
+
+  Grid<int> cell(rows, cols);
+  Grid<int> nucleus(rows, cols);
+  for (const Disk& d : disks) {
+    draw_cell(cell, nucleus, d.cy, d.cx, d.r_cell, d.r_nucleus);
+  }
+
+  std::vector<CellForce> forces = find_cell_forces(cell, nucleus, 3);
+
+  ASSERT_EQ(forces.size(), disks.size());
+  for (size_t k = 0; k < disks.size(); ++k) {
+    Grid<int> one_cell(rows, cols);
+    Grid<int> one_nucleus(rows, cols);
+    draw_cell(one_cell, one_nucleus, disks[k].cy, disks[k].cx, disks[k].r_cell, disks[k].r_nucleus);
+    ForceMap alone = ForceMap::cropped(one_cell, one_nucleus);
+
+    const CellForce& found = forces[k];
+    ASSERT_EQ(found.label, static_cast<int>(k) + 1);
+    ASSERT_EQ(found.force_map.region(), alone.region());
+    ASSERT_EQ(found.force_map.cell(), alone.cell());
+    ASSERT_EQ(found.force_map.nucleus(), alone.nucleus());
+    ASSERT_EQ(found.force_map.dist(), alone.dist());
+    ASSERT_EQ(found.force_map.nucleus_force(), alone.nucleus_force());
+    ASSERT_EQ(found.force_vector, alone.force_vector());
+  }
+
+  std::vector<CellForce> serial = find_cell_forces(cell, nucleus);
+  for (size_t k = 0; k < disks.size(); ++k) {
+    ASSERT_EQ(serial[k].force_vector, forces[k].force_vector);
+  }
+}
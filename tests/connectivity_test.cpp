@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include <nucleus_force/connectivity.h>
+#include <nucleus_force/nucleus_force.h>
+#include <nucleus_force/propagation.h>
+#include <cstdint>
+#include <cstdlib>
+#include "reference_force.h"
+
+using namespace nucleusforce;
+using nucleusforce::testing::RandomGeometry;
+
+TEST(ConnectivityTests, FourConnectedIntDoubleMatchesDefault) {
+  for (unsigned seed = 0; seed < 6; ++seed) {
+    RandomGeometry g(40, 45, seed, seed % 2 == 1);
+
+    ASSERT_EQ((find_dist<Connectivity::Four, int>(g.cell, g.nucleus)), find_dist(g.cell, g.nucleus));
+    ASSERT_EQ(find_boundary<Connectivity::Four>(g.cell, g.nucleus), find_boundary(g.cell, g.nucleus));
+    ASSERT_EQ(find_nucleus_force<Connectivity::Four>(g.cell, g.nucleus), find_nucleus_force(g.cell, g.nucleus));
+    ASSERT_EQ((find_nucleus_force<Connectivity::Four, int, double>(g.cell, g.nucleus, g.force)),
+              find_nucleus_force(g.cell, g.nucleus, g.force));
+  }
+}
+
+TEST(ConnectivityTests, NarrowTypesMatchWideTypes) {
+  for (Connectivity c : {Connectivity::Four, Connectivity::Eight}) {
+    for (unsigned seed = 0; seed < 4; ++seed) {
+      RandomGeometry g(50, 40, seed, seed % 2 == 1);
+      bool eight = c == Connectivity::Eight;
+
+      Grid<int> dist = eight ? find_dist<Connectivity::Eight, int>(g.cell, g.nucleus)
+                             : find_dist<Connectivity::Four, int>(g.cell, g.nucleus);
+      Grid<uint16_t> narrow_dist = eight ? find_dist<Connectivity::Eight, uint16_t>(g.cell, g.nucleus)
+                                         : find_dist<Connectivity::Four, uint16_t>(g.cell, g.nucleus);
+      for (size_t i = 0; i < dist.size(); ++i) {
+        int expected = dist.data()[i];
+        ASSERT_EQ(narrow_dist.data()[i], expected < 0 ? unreached_distance<uint16_t>() : expected);
+      }
+      ASSERT_EQ(build_levels(narrow_dist).pixels, build_levels(dist).pixels);
+      ASSERT_EQ(build_levels(narrow_dist).offsets, build_levels(dist).offsets);
+
+      Grid<double> force = eight ? find_nucleus_force<Connectivity::Eight>(g.cell, g.nucleus)
+                                 : find_nucleus_force<Connectivity::Four>(g.cell, g.nucleus);
+      Grid<double> narrow_dist_force =
+          eight ? find_nucleus_force<Connectivity::Eight, uint16_t>(g.cell, g.nucleus)
+                : find_nucleus_force<Connectivity::Four, uint16_t>(g.cell, g.nucleus);
+      Grid<float> float_force = eight ? find_nucleus_force<Connectivity::Eight, uint16_t, float>(g.cell, g.nucleus)
+                                      : find_nucleus_force<Connectivity::Four, uint16_t, float>(g.cell, g.nucleus);
+      ASSERT_EQ(narrow_dist_force, force);
+      for (size_t i = 0; i < force.size(); ++i) {
+        ASSERT_NEAR(float_force.data()[i], force.data()[i], 1e-4 * std::max(1.0, std::abs(force.data()[i])));
+      }
+
+      std::vector<double> float_vector = find_force_vector(g.nucleus, float_force);
+      std::vector<double> vector = find_force_vector(g.nucleus, force);
+      for (int i = 0; i < 2; ++i) {
+        ASSERT_NEAR(float_vector[i], vector[i], 1e-3 * std::max(1.0, std::abs(vector[i])));
+      }
+    }
+  }
+}
+
+TEST(ConnectivityTests, EightConnectedDistanceIsChessboardDistance) {
+  Grid<int> cell(9, 11, 1);
+  Grid<int> nucleus(9, 11, 0);
+  nucleus(4, 3) = 1;
+
+  Grid<int> dist = find_dist<Connectivity::Eight>(cell, nucleus);
+
+  for (int y = 0; y < 9; ++y) {
+    for (int x = 0; x < 11; ++x) {
+      ASSERT_EQ(dist(y, x), std::max(std::abs(y - 4), std::abs(x - 3)));
+    }
+  }
+}
+
+TEST(ConnectivityTests, EightConnectedForceIsConserved) {
+  for (unsigned seed = 0; seed < 4; ++seed) {
+    RandomGeometry g(45, 50, seed);
+
+    Grid<int> boundary = find_boundary<Connectivity::Eight>(g.cell, g.nucleus);
+    Grid<int> dist = find_dist<Connectivity::Eight>(g.cell, g.nucleus);
+    Grid<double> force = find_nucleus_force<Connectivity::Eight>(g.cell, g.nucleus);
+
+    // Every reached boundary pixel's unit of force ends up on the nucleus
+    double applied = 0;
+    double arrived = 0;
+    for (int y = 0; y < g.cell.rows(); ++y) {
+      for (int x = 0; x < g.cell.cols(); ++x) {
+        if (boundary(y, x) == 1 && dist(y, x) >= 0) applied += 1;
+        if (g.nucleus(y, x) == 1) arrived += force(y, x);
+      }
+    }
+    ASSERT_GT(applied, 0);
+    ASSERT_NEAR(arrived, applied, 1e-9 * applied);
+  }
+}
+
+TEST(ConnectivityTests, EightConnectedBoundaryTestsEveryNeighbour) {
+  // The centre pixel only touches the background diagonally up and to the right
+  Grid<int> cell(5, 5, 1);
+  Grid<int> nucleus(5, 5, 0);
+  nucleus(2, 2) = 1;
+  cell(1, 3) = 0;
+
+  ASSERT_EQ(find_boundary<Connectivity::Four>(cell, nucleus)(2, 2), 0);
+  ASSERT_EQ(find_boundary<Connectivity::Eight>(cell, nucleus)(2, 2), 1);
+}
+
+TEST(ConnectivityTests, DistancesTooLargeForTheTypeShouldThrowError) {
+  Grid<int> cell(1, 70000, 1);
+  Grid<int> nucleus(1, 70000, 0);
+  nucleus(0, 0) = 1;
+
+  ASSERT_THROW((find_dist<Connectivity::Four, uint16_t>(cell, nucleus)), std::invalid_argument);
+  ASSERT_EQ((find_dist<Connectivity::Four, int>(cell, nucleus))(0, 69999), 69999);
+}
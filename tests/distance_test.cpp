@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+#include <nucleus_force/distance.h>
+#include <nucleus_force/nucleus_force.h>
+#include <algorithm>
+#include <cmath>
+#include "reference_force.h"
+
+using namespace nucleusforce;
+using nucleusforce::testing::RandomGeometry;
+
+TEST(Distance_ParallelBfsTests, MatchesSerialOnRandomCells) {
+  ThreadPool pool(4);
+  for (unsigned seed = 0; seed < 20; ++seed) {
+    RandomGeometry g(150 + seed, 170 - seed, seed, seed % 2 == 1);
+
+    ASSERT_EQ(find_dist(g.cell, g.nucleus, pool), find_dist(g.cell, g.nucleus)) << "seed " << seed;
+  }
+}
+
+TEST(Distance_ParallelBfsTests, MatchesSerialWithLargeFrontier) {
+  // Scattered nucleus pixels make the first frontiers cover much of the image,
+  // which switches the search to bottom-up
+  RandomGeometry g(300, 280, 3);
+  for (int y = 0; y < g.nucleus.rows(); ++y) {
+    for (int x = 0; x < g.nucleus.cols(); ++x) {
+      if ((y * 7 + x * 3) % 11 == 0) {
+        g.nucleus(y, x) = 1;
+        g.cell(y, x) = 0;
+      }
+    }
+  }
+
+  for (unsigned threads : {1u, 2u, 5u}) {
+    ThreadPool pool(threads);
+    ASSERT_EQ(find_dist(g.cell, g.nucleus, pool), find_dist(g.cell, g.nucleus)) << "threads " << threads;
+  }
+}
+
+TEST(Distance_ParallelBfsTests, ThreadCountOverloadMatchesSerial) {
+  RandomGeometry g(64, 64, 1);
+
+  ASSERT_EQ(find_dist(g.cell, g.nucleus, 3u), find_dist(g.cell, g.nucleus));
+  ASSERT_EQ(find_dist(g.cell, g.nucleus, 1u), find_dist(g.cell, g.nucleus));
+}
+
+TEST(Distance_ParallelBfsTests, BlankMapHasNoDistance) {
+  ThreadPool pool(2);
+  Grid<int> cell(4, 4);
+
+  ASSERT_EQ(find_dist(cell, cell, pool), Grid<int>(4, 4, -1));
+}
+
+TEST(Distance_ParallelBfsTests, MismatchedDimensionsShouldThrowError) {
+  ThreadPool pool(2);
+
+  ASSERT_THROW(find_dist(Grid<int>(3, 4), Grid<int>(4, 4), pool), std::invalid_argument);
+}
+
+TEST(Distance_EuclideanTests, MatchesBruteForce) {
+  for (unsigned seed = 0; seed < 4; ++seed) {
+    RandomGeometry g(37, 41, seed, seed % 2 == 1);
+
+    Grid<double> dist = find_euclidean_dist(g.cell, g.nucleus, 3);
+
+    for (int y = 0; y < g.cell.rows(); ++y) {
+      for (int x = 0; x < g.cell.cols(); ++x) {
+        if (g.cell(y, x) == 0 && g.nucleus(y, x) == 0) {
+          ASSERT_EQ(dist(y, x), -1);
+          continue;
+        }
+        double nearest = 1e9;
+        for (int ny = 0; ny < g.nucleus.rows(); ++ny) {
+          for (int nx = 0; nx < g.nucleus.cols(); ++nx) {
+            if (g.nucleus(ny, nx) == 1) {
+              nearest = std::min(nearest, std::hypot(double(y - ny), double(x - nx)));
+            }
+          }
+        }
+        ASSERT_NEAR(dist(y, x), nearest, 1e-9) << "at " << y << ", " << x;
+      }
+    }
+  }
+}
+
+TEST(Distance_EuclideanTests, BlankMapHasNoDistance) {
+  Grid<int> cell(6, 7, 1);
+  Grid<int> nucleus(6, 7, 0);
+
+  ASSERT_EQ(find_euclidean_dist(cell, nucleus), Grid<double>(6, 7, -1));
+}
+
+TEST(Distance_GeodesicTests, LiesBetweenCityBlockBounds) {
+  for (unsigned seed = 0; seed < 4; ++seed) {
+    RandomGeometry g(60, 55, seed, seed % 2 == 1);
+
+    Grid<int> steps = find_dist(g.cell, g.nucleus);
+    Grid<double> dist = find_geodesic_dist(g.cell, g.nucleus);
+
+    // Reaches the same pixels, never further than the 4-connected path and never
+    // shorter than the diagonal through it
+    for (size_t i = 0; i < steps.size(); ++i) {
+      if (steps.data()[i] < 0) {
+        ASSERT_EQ(dist.data()[i], -1);
+      } else {
+        ASSERT_LE(dist.data()[i], steps.data()[i] + 1e-9);
+        ASSERT_GE(dist.data()[i], steps.data()[i] / std::sqrt(2.0) - 1e-9);
+      }
+    }
+  }
+}
+
+TEST(Distance_GeodesicTests, ApproximatesEuclideanInOpenCell) {
+  Grid<int> cell(61, 61, 1);
+  Grid<int> nucleus(61, 61, 0);
+  nucleus(30, 30) = 1;
+
+  Grid<double> dist = find_geodesic_dist(cell, nucleus);
+
+  for (int y = 0; y < 61; ++y) {
+    for (int x = 0; x < 61; ++x) {
+      double euclidean = std::hypot(double(y - 30), double(x - 30));
+      ASSERT_NEAR(dist(y, x), euclidean, 0.1 * euclidean + 0.5) << "at " << y << ", " << x;
+    }
+  }
+}
+
+TEST(Distance_GeodesicTests, GoesAroundWalls) {
+  // A wall across most of the cell separates the nucleus from the bottom rows
+  Grid<int> cell(21, 21, 1);
+  Grid<int> nucleus(21, 21, 0);
+  nucleus(5, 2) = 1;
+  for (int x = 0; x < 18; ++x) cell(10, x) = 0;
+
+  Grid<double> geodesic = find_geodesic_dist(cell, nucleus);
+  Grid<double> euclidean = find_euclidean_dist(cell, nucleus);
+
+  ASSERT_NEAR(euclidean(15, 2), 10, 1e-9);
+  ASSERT_GT(geodesic(15, 2), 25);
+  ASSERT_EQ(geodesic(10, 2), -1);
+}
@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include <nucleus_force/force_map.h>
+#include <nucleus_force/nucleus_force.h>
+#include "reference_force.h"
+#include <thread>
+#include <vector>
+
+using namespace nucleusforce;
+using nucleusforce::testing::RandomGeometry;
+
+TEST(ForceMapTests, CachedGeometryMatchesFreeFunctions) {
+  RandomGeometry g(50, 60, 2);
+
+  ForceMap fm(g.cell, g.nucleus);
+
+  ASSERT_EQ(fm.rows(), 50);
+  ASSERT_EQ(fm.cols(), 60);
+  ASSERT_EQ(fm.cell(), g.cell);
+  ASSERT_EQ(fm.nucleus(), g.nucleus);
+  ASSERT_EQ(fm.boundary(), find_boundary(g.cell, g.nucleus));
+  ASSERT_EQ(fm.dist(), find_dist(g.cell, g.nucleus));
+  ASSERT_EQ(fm.levels().pixels, build_levels(fm.dist()).pixels);
+}
+
+TEST(ForceMapTests, ForcesMatchFreeFunctions) {
+  for (unsigned seed = 0; seed < 5; ++seed) {
+    RandomGeometry g(40, 45, seed);
+
+    ForceMap fm(g.cell, g.nucleus);
+
+    ASSERT_EQ(fm.nucleus_force(), find_nucleus_force(g.cell, g.nucleus));
+    ASSERT_EQ(fm.nucleus_force(g.force), find_nucleus_force(g.cell, g.nucleus, g.force));
+    ASSERT_EQ(fm.centroid(), find_nucleus_centroid(g.nucleus));
+    ASSERT_EQ(fm.force_vector(), find_force_vector(g.nucleus, find_nucleus_force(g.cell, g.nucleus)));
+    ASSERT_EQ(fm.force_vector(g.force),
+              find_force_vector(g.nucleus, find_nucleus_force(g.cell, g.nucleus, g.force)));
+  }
+}
+
+TEST(ForceMapTests, ThreadedForceMapMatchesSerial) {
+  RandomGeometry g(200, 180, 4);
+
+  ForceMap serial(g.cell, g.nucleus);
+  ForceMap threaded(g.cell, g.nucleus, 3);
+
+  ASSERT_EQ(threaded.dist(), serial.dist());
+  ASSERT_EQ(threaded.nucleus_force(), serial.nucleus_force());
+  ASSERT_EQ(threaded.nucleus_force(g.force), serial.nucleus_force(g.force));
+}
+
+TEST(ForceMapTests, ThreadedForceMapCanBeSharedBetweenThreads) {
+  RandomGeometry g(150, 160, 6);
+  ForceMap serial(g.cell, g.nucleus);
+  ForceMap threaded(g.cell, g.nucleus, 3);
+  ForceMap copy = threaded;
+  Grid<double> expected = serial.nucleus_force(g.force);
+  ForceMoments expected_moments = serial.force_moments(g.force);
+
+  // Callers that find the kept threads busy run alone and get the same result
+  std::vector<int> matches(4);
+  std::vector<std::thread> callers;
+  for (int i = 0; i < 4; ++i) {
+    const ForceMap& fm = i % 2 ? copy : threaded;
+    callers.emplace_back([&, i] {
+      for (int round = 0; round < 10; ++round) {
+        ForceMoments moments = fm.force_moments(g.force);
+        matches[i] += fm.nucleus_force(g.force) == expected && moments.force_x == expected_moments.force_x &&
+                      moments.force_y == expected_moments.force_y;
+      }
+    });
+  }
+  for (std::thread& caller : callers) {
+    caller.join();
+  }
+
+  ASSERT_EQ(matches, std::vector<int>(4, 10));
+}
+
+TEST(ForceMapTests, CellWithoutGivenForceFindsCorrectForce) {
+  std::vector<std::vector<int>> cell(4, std::vector<int>(4));
+  cell[0] = {0, 1, 1, 1};
+  cell[1] = {0, 1, 1, 1};
+  cell[2] = {0, 1, 0, 1};
+  cell[3] = {0, 1, 1, 1};
+
+  std::vector<std::vector<int>> nucleus(4, std::vector<int>(4));
+  nucleus[2] = {0, 0, 1, 0};
+
+  ForceMap fm(Grid<int>::from_vector(cell), Grid<int>::from_vector(nucleus));
+
+  Grid<double> force = fm.nucleus_force();
+
+  ASSERT_EQ(force(2, 2), 10);
+  ASSERT_EQ(force.size(), 16);
+}
+
+TEST(ForceMapTests, MismatchedDimensionsShouldThrowError) {
+  ForceMap fm(Grid<int>(4, 4), Grid<int>(4, 4));
+
+  ASSERT_THROW(ForceMap(Grid<int>(4, 4), Grid<int>(3, 4)), std::invalid_argument);
+  ASSERT_THROW(fm.nucleus_force(Grid<double>(4, 5)), std::invalid_argument);
+}
+
+TEST(ForceMapTests, CroppedForceMapMatchesFullArrays) {
+  for (bool overlap : {false, true}) {
+    RandomGeometry g(40, 45, 3, overlap);
+    // Pad the geometry so the cell is a small part of the image
+    Region placed{7, 11, 40, 45};
+    Grid<int> cell = embed(g.cell, placed, 60, 70);
+    Grid<int> nucleus = embed(g.nucleus, placed, 60, 70);
+    Grid<double> force = embed(g.force, placed, 60, 70);
+
+    ForceMap full(cell, nucleus);
+    ForceMap cropped = ForceMap::cropped(cell, nucleus, 2);
+    const Region& region = cropped.region();
+
+    ASSERT_EQ(region, find_bounding_box(cell, nucleus));
+    ASSERT_LT(region.rows, 60);
+    ASSERT_LT(region.cols, 70);
+    ASSERT_EQ(embed(cropped.boundary(), region, 60, 70), full.boundary());
+    ASSERT_EQ(embed(cropped.dist(), region, 60, 70, -1), full.dist());
+    ASSERT_EQ(embed(cropped.nucleus_force(), region, 60, 70), full.nucleus_force());
+    // Force outside the cell stays where it is, so only compare force inside the region
+    Grid<double> cropped_force(force.view().subview(region));
+    ASSERT_EQ(embed(cropped.nucleus_force(cropped_force), region, 60, 70),
+              full.nucleus_force(embed(cropped_force, region, 60, 70)));
+
+    std::vector<double> centroid = cropped.centroid();
+    std::vector<double> true_centroid = full.centroid();
+    std::vector<double> force_vector = cropped.force_vector();
+    std::vector<double> true_force_vector = full.force_vector();
+    for (int i = 0; i < 2; ++i) {
+      ASSERT_NEAR(centroid[i], true_centroid[i], 1e-9);
+      ASSERT_NEAR(force_vector[i], true_force_vector[i], 1e-9);
+    }
+  }
+}
+
+TEST(ForceMapTests, RegionOfTheWrongSizeShouldThrowError) {
+  ASSERT_THROW(ForceMap(Grid<int>(4, 4), Grid<int>(4, 4), Region{1, 1, 4, 3}), std::invalid_argument);
+}
@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+#include <nucleus_force/grid_io.h>
+#include <nucleus_force/nucleus_force.h>
+#include "reference_force.h"
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace nucleusforce;
+using nucleusforce::testing::RandomGeometry;
+namespace fs = std::filesystem;
+
+static fs::path temp_file(const std::string& name) {
+  return fs::temp_directory_path() / ("nucleusforce_grid_io_test_" + name);
+}
+
+static std::string read_file(const fs::path& path) {
+  std::ifstream file(path, std::ios::binary);
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+TEST(GridIoTest, NpyRoundTripsInts) {
+  RandomGeometry g(37, 53, 1);
+  fs::path path = temp_file("dist.npy");
+
+  Grid<int> dist = find_dist(g.cell, g.nucleus);
+  export_npy(path.string(), dist);
+  MappedGrid mapped(path.string());
+
+  ASSERT_EQ(mapped.type(), GridType::Int32);
+  ASSERT_EQ(Grid<int>(mapped.view<int>()), dist);
+  ASSERT_THROW(mapped.view<double>(), std::invalid_argument);
+  fs::remove(path);
+}
+
+TEST(GridIoTest, NpyHeaderIsAlignedNumpyFormat) {
+  fs::path path = temp_file("header.npy");
+
+  export_npy(path.string(), Grid<double>(3, 4, 1.5));
+  std::string contents = read_file(path);
+
+  ASSERT_EQ(contents.substr(0, 8), std::string("\x93NUMPY\x01\x00", 8));
+  size_t header_length = static_cast<unsigned char>(contents[8]) | (static_cast<unsigned char>(contents[9]) << 8);
+  ASSERT_EQ((10 + header_length) % 64, 0);
+  ASSERT_EQ(contents.size(), 10 + header_length + 3 * 4 * sizeof(double));
+  std::string dict = contents.substr(10, header_length);
+  ASSERT_EQ(dict.rfind("{'descr': '<f8', 'fortran_order': False, 'shape': (3, 4), }", 0), 0);
+  ASSERT_EQ(dict.back(), '\n');
+  fs::remove(path);
+}
+
+TEST(GridIoTest, RawRoundTripsDoublesFromSubview) {
+  RandomGeometry g(40, 30, 2);
+  fs::path path = temp_file("force.grid");
+
+  Grid<double> force = find_nucleus_force(g.cell, g.nucleus, g.force);
+  GridView<const double> window = force.view().subview(5, 3, 20, 17);
+  export_raw(path.string(), window);
+  MappedGrid mapped(path.string());
+
+  ASSERT_EQ(mapped.type(), GridType::Float64);
+  ASSERT_EQ(mapped.rows(), 20);
+  ASSERT_EQ(mapped.cols(), 17);
+  ASSERT_EQ(Grid<double>(mapped.view<double>()), Grid<double>(window));
+  ASSERT_EQ(read_file(path).size(), 64 + 20 * 17 * sizeof(double));
+  fs::remove(path);
+}
+
+TEST(GridIoTest, MappedGridCanBeMoved) {
+  fs::path path = temp_file("moved.grid");
+  export_raw(path.string(), Grid<int>(2, 3, 7));
+
+  MappedGrid first(path.string());
+  MappedGrid second = std::move(first);
+
+  ASSERT_EQ(second.rows(), 2);
+  ASSERT_EQ(Grid<int>(second.view<int>()), Grid<int>(2, 3, 7));
+  ASSERT_EQ(first.rows(), 0);
+  fs::remove(path);
+}
+
+TEST(GridIoTest, InvalidFilesShouldThrowError) {
+  fs::path path = temp_file("invalid.grid");
+
+  ASSERT_THROW(MappedGrid(temp_file("missing").string()), std::runtime_error);
+
+  std::ofstream(path, std::ios::binary) << "not a grid file at all";
+  ASSERT_THROW(MappedGrid(path.string()), std::invalid_argument);
+
+  // Header claims more data than the file holds
+  export_raw(path.string(), Grid<double>(10, 10));
+  fs::resize_file(path, 64 + 8 * 99);
+  ASSERT_THROW(MappedGrid(path.string()), std::invalid_argument);
+
+  // Dimensions whose byte count wraps around to the 64 bytes the file holds
+  export_raw(path.string(), Grid<double>(2, 4));
+  {
+    int64_t shape[2] = {1073807362, 2147352580};
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(16);
+    file.write(reinterpret_cast<const char*>(shape), sizeof(shape));
+  }
+  ASSERT_THROW(MappedGrid(path.string()), std::invalid_argument);
+  fs::remove(path);
+}
+
+TEST(GridIoTest, CsvMatchesStreamFormatting) {
+  Grid<double> values(3, 4);
+  double samples[] = {0.0, -0.0, 1.0, -2.5, 1.0 / 3.0, 1e-5, 123456789.0, 6.02214076e23,
+                      std::numeric_limits<double>::min(), std::numeric_limits<double>::max(), 0.1 + 0.2, -1e100};
+  for (int i = 0; i < 12; ++i) {
+    values.data()[i] = samples[i];
+  }
+  fs::path path = temp_file("values.csv");
+
+  export_csv(path.string(), values);
+
+  std::ostringstream expected;
+  for (int y = 0; y < values.rows(); ++y) {
+    for (int x = 0; x < values.cols(); ++x) {
+      expected << values(y, x) << (x < values.cols() - 1 ? "," : "\n");
+    }
+  }
+  ASSERT_EQ(read_file(path), expected.str());
+  fs::remove(path);
+}
+
+TEST(GridIoTest, CsvWritesLargeIntGrids) {
+  Grid<int> values(300, 2000);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values.data()[i] = static_cast<int>(i * 2654435761u) - 7;
+  }
+  fs::path path = temp_file("large.csv");
+
+  export_csv(path.string(), values);
+
+  std::ostringstream expected;
+  for (int y = 0; y < values.rows(); ++y) {
+    for (int x = 0; x < values.cols(); ++x) {
+      expected << values(y, x) << (x < values.cols() - 1 ? "," : "\n");
+    }
+  }
+  ASSERT_EQ(read_file(path), expected.str());
+  fs::remove(path);
+}
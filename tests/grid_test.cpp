@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+#include <common/grid.h>
+#include <common/sparse_grid.h>
+#include <stdexcept>
+#include <vector>
+
+using namespace nucleusforce;
+
+TEST(GridTest, ConstructorFillsValue) {
+  Grid<int> grid(3, 5, 7);
+
+  ASSERT_EQ(grid.rows(), 3);
+  ASSERT_EQ(grid.cols(), 5);
+  ASSERT_EQ(grid.size(), 15);
+
+  for (int y = 0; y < grid.rows(); ++y) {
+    for (int x = 0; x < grid.cols(); ++x) {
+      ASSERT_EQ(grid(y, x), 7);
+    }
+  }
+}
+
+TEST(GridTest, StorageIsContiguousRowMajor) {
+  Grid<int> grid(2, 3);
+  for (int i = 0; i < 6; ++i) {
+    grid.data()[i] = i;
+  }
+
+  ASSERT_EQ(grid(0, 2), 2);
+  ASSERT_EQ(grid(1, 0), 3);
+  ASSERT_EQ(grid.row(1), grid.data() + 3);
+  ASSERT_TRUE(grid.view().is_contiguous());
+}
+
+TEST(GridTest, VectorRoundTrip) {
+  std::vector<std::vector<double>> array = {{0, 1, 2}, {3, 4, 5}};
+
+  Grid<double> grid = Grid<double>::from_vector(array);
+
+  ASSERT_EQ(grid.rows(), 2);
+  ASSERT_EQ(grid.cols(), 3);
+  ASSERT_EQ(grid(1, 1), 4);
+  ASSERT_EQ(grid.to_vector(), array);
+}
+
+TEST(GridTest, RaggedVectorShouldThrowError) {
+  std::vector<std::vector<int>> array = {{0, 1, 2}, {3, 4}};
+
+  ASSERT_THROW(Grid<int>::from_vector(array), std::invalid_argument);
+}
+
+TEST(GridTest, EmptyVectorCreatesEmptyGrid) {
+  Grid<int> grid = Grid<int>::from_vector({});
+
+  ASSERT_TRUE(grid.empty());
+  ASSERT_EQ(grid.rows(), 0);
+  ASSERT_EQ(grid.cols(), 0);
+}
+
+TEST(GridViewTest, SubviewSharesStorage) {
+  Grid<int> grid(4, 4);
+  GridView<int> sub = grid.view().subview(1, 2, 2, 2);
+
+  ASSERT_EQ(sub.rows(), 2);
+  ASSERT_EQ(sub.cols(), 2);
+  ASSERT_EQ(sub.stride(), 4);
+  ASSERT_FALSE(sub.is_contiguous());
+
+  sub(1, 1) = 9;
+  ASSERT_EQ(grid(2, 3), 9);
+
+  std::vector<std::vector<int>> true_sub = {{0, 0}, {0, 9}};
+  ASSERT_EQ(sub.to_vector(), true_sub);
+}
+
+TEST(GridViewTest, SubviewOutOfBoundsShouldThrowError) {
+  Grid<int> grid(4, 4);
+
+  ASSERT_THROW(grid.view().subview(3, 3, 2, 2), std::out_of_range);
+}
+
+TEST(GridViewTest, ViewConstructedFromSubviewCopiesWindow) {
+  Grid<int> grid(3, 3);
+  for (int i = 0; i < 9; ++i) {
+    grid.data()[i] = i;
+  }
+
+  Grid<int> copy(grid.view().subview(1, 1, 2, 2));
+
+  ASSERT_EQ(copy.rows(), 2);
+  ASSERT_EQ(copy.cols(), 2);
+  ASSERT_EQ(copy(0, 0), 4);
+  ASSERT_EQ(copy(1, 1), 8);
+}
+
+TEST(SparseGridTest, DenseRoundTripKeepsNonZeros) {
+  Grid<double> dense(3, 4);
+  dense(0, 3) = 1.5;
+  dense(2, 0) = -2;
+  dense(2, 2) = 0.25;
+
+  SparseGrid<double> sparse = SparseGrid<double>::from_dense(dense);
+
+  ASSERT_EQ(sparse.rows(), 3);
+  ASSERT_EQ(sparse.cols(), 4);
+  ASSERT_EQ(sparse.nonzeros(), 3);
+  ASSERT_EQ(sparse.row_offsets(), (std::vector<size_t>{0, 1, 1, 3}));
+  ASSERT_EQ(sparse.columns(), (std::vector<int>{3, 0, 2}));
+  ASSERT_EQ(sparse.to_dense(), dense);
+}
+
+TEST(SparseGridTest, EntriesAreSortedAndZerosDropped) {
+  SparseGrid<double> sparse(3, 4, {{2, 2, 0.25}, {0, 3, 1.5}, {1, 1, 0}, {2, 0, -2}});
+
+  Grid<double> dense(3, 4);
+  dense(0, 3) = 1.5;
+  dense(2, 0) = -2;
+  dense(2, 2) = 0.25;
+  ASSERT_EQ(sparse, SparseGrid<double>::from_dense(dense));
+
+  Grid<double> coordinates = sparse.to_coordinates();
+  ASSERT_EQ(coordinates.rows(), 3);
+  ASSERT_EQ(coordinates.cols(), 3);
+  ASSERT_EQ(coordinates.to_vector(), (std::vector<std::vector<double>>{{0, 3, 1.5}, {2, 0, -2}, {2, 2, 0.25}}));
+}
+
+TEST(SparseGridTest, InvalidEntriesShouldThrowError) {
+  ASSERT_THROW(SparseGrid<double>(2, 2, {{2, 0, 1.0}}), std::invalid_argument);
+  ASSERT_THROW(SparseGrid<double>(2, 2, {{0, -1, 1.0}}), std::invalid_argument);
+  ASSERT_THROW(SparseGrid<double>(2, 2, {{1, 1, 1.0}, {1, 1, 2.0}}), std::invalid_argument);
+}
+
+TEST(RegionTest, GrowRegionClipsToGrid) {
+  Region inside = grow_region(2, 3, 4, 6, 1, 10, 10);
+  ASSERT_EQ(inside, (Region{1, 3, 4, 5}));
+
+  Region clipped = grow_region(0, 9, 1, 8, 2, 10, 10);
+  ASSERT_EQ(clipped, (Region{0, 0, 10, 10}));
+  ASSERT_FALSE(clipped.empty());
+  ASSERT_TRUE(Region().empty());
+}
+
+TEST(RegionTest, EmbedPlacesCropAndFillsTheRest) {
+  Grid<int> grid(4, 5);
+  for (int i = 0; i < 20; ++i) {
+    grid.data()[i] = i;
+  }
+  Region region{1, 2, 2, 3};
+
+  Grid<int> crop(grid.view().subview(region));
+  Grid<int> full = embed(crop, region, 4, 5, -1);
+
+  for (int y = 0; y < 4; ++y) {
+    for (int x = 0; x < 5; ++x) {
+      bool in_region = y >= 1 && y < 3 && x >= 2;
+      ASSERT_EQ(full(y, x), in_region ? grid(y, x) : -1);
+    }
+  }
+  ASSERT_THROW(embed(crop, Region{0, 0, 3, 3}, 4, 5), std::invalid_argument);
+  ASSERT_THROW(embed(crop, Region{3, 3, 2, 3}, 4, 5), std::out_of_range);
+}
@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include <image/image_reader.h>
 #include <image/image_parse.h>
+#include <nucleus_force/nucleus_force.h>
 #include <filesystem>
 
 using namespace nucleusforce::image;
@@ -25,3 +26,98 @@ TEST(ImageParserTest, TestParseTargetColor) {
     }
   }
 }
+
+TEST(ImageParserTest, TestParseTargetColorGrid) {
+  fs::path image_path = fs::current_path() / "img" / "dot.png";
+
+  ASSERT_TRUE(fs::exists(image_path)) << "Test image file does not exist at path: " << image_path;
+
+  ColorMap cm(image_path.string());
+
+  nucleusforce::Grid<int> isolated_map = isolate_color_grid(cm, cv::Vec3b(0, 0, 0));
+
+  ASSERT_EQ(isolated_map.rows(), 16);
+  ASSERT_EQ(isolated_map.cols(), 16);
+  ASSERT_EQ(isolated_map.to_vector(), isolate_color(cm, cv::Vec3b(0, 0, 0)));
+  ASSERT_EQ(isolated_map(15, 15), 1);
+}
+
+TEST(ImageParserTest, TestParseMissingColorGrid) {
+  fs::path image_path = fs::current_path() / "img" / "dot.png";
+
+  ASSERT_TRUE(fs::exists(image_path)) << "Test image file does not exist at path: " << image_path;
+
+  ColorMap cm(image_path.string());
+
+  nucleusforce::Grid<int> isolated_map = isolate_color_grid(cm, cv::Vec3b(0, 0, 255));
+
+  ASSERT_EQ(isolated_map, nucleusforce::Grid<int>(16, 16, 0));
+}
+
+TEST(ImageParserTest, TestParseTargetColorMask) {
+  fs::path image_path = fs::current_path() / "img" / "colors.png";
+
+  ASSERT_TRUE(fs::exists(image_path)) << "Test image file does not exist at path: " << image_path;
+
+  ColorMap cm(image_path.string());
+
+  for (cv::Vec3b color : {cv::Vec3b(0, 0, 0), cv::Vec3b(255, 0, 255), cv::Vec3b(1, 2, 3)}) {
+    nucleusforce::BitMask mask = isolate_color_mask(cm, color);
+
+    ASSERT_EQ(mask.rows(), 16);
+    ASSERT_EQ(mask.cols(), 16);
+    ASSERT_EQ(mask.to_grid(), isolate_color_grid(cm, color));
+  }
+}
+
+TEST(ImageParserTest, TestParseSeveralColorsInOnePass) {
+  fs::path image_path = fs::current_path() / "img" / "colors.png";
+
+  ASSERT_TRUE(fs::exists(image_path)) << "Test image file does not exist at path: " << image_path;
+
+  ColorMap cm(image_path.string());
+  std::vector<cv::Vec3b> colors = {cv::Vec3b(255, 0, 255), cv::Vec3b(1, 2, 3), cv::Vec3b(0, 0, 0),
+                                   cv::Vec3b(255, 0, 255)};
+
+  std::vector<nucleusforce::Grid<int>> grids = isolate_colors(cm, colors);
+  std::vector<nucleusforce::BitMask> masks = isolate_color_masks(cm, colors);
+
+  ASSERT_EQ(grids.size(), colors.size());
+  ASSERT_EQ(masks.size(), colors.size());
+  for (size_t i = 0; i < colors.size(); ++i) {
+    ASSERT_EQ(grids[i], isolate_color_grid(cm, colors[i]));
+    ASSERT_EQ(masks[i].to_grid(), grids[i]);
+  }
+  ASSERT_EQ(grids[1], nucleusforce::Grid<int>(16, 16, 0));
+}
+
+TEST(ImageParserTest, TestParseNoColors) {
+  fs::path image_path = fs::current_path() / "img" / "dot.png";
+
+  ASSERT_TRUE(fs::exists(image_path)) << "Test image file does not exist at path: " << image_path;
+
+  ColorMap cm(image_path.string());
+
+  ASSERT_TRUE(isolate_colors(cm, {}).empty());
+  ASSERT_TRUE(isolate_color_masks(cm, {}).empty());
+}
+
+TEST(ImageParserTest, TestParseColorsInBoundingBox) {
+  fs::path image_path = fs::current_path() / "img" / "colors.png";
+
+  ASSERT_TRUE(fs::exists(image_path)) << "Test image file does not exist at path: " << image_path;
+
+  ColorMap cm(image_path.string());
+  std::vector<cv::Vec3b> colors = {cv::Vec3b(255, 0, 255), cv::Vec3b(1, 2, 3)};
+
+  std::vector<nucleusforce::Grid<int>> full = isolate_colors(cm, colors);
+  nucleusforce::Region region = find_colors_bounding_box(cm, colors);
+  std::vector<nucleusforce::Grid<int>> cropped = isolate_colors(cm, colors, region);
+
+  ASSERT_FALSE(region.empty());
+  ASSERT_EQ(region, nucleusforce::find_bounding_box(full[0], full[1]));
+  for (size_t i = 0; i < colors.size(); ++i) {
+    ASSERT_EQ(cropped[i], nucleusforce::Grid<int>(full[i].view().subview(region)));
+  }
+  ASSERT_TRUE(find_colors_bounding_box(cm, {cv::Vec3b(1, 2, 3)}).empty());
+}
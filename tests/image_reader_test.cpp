@@ -2,6 +2,7 @@
 #include <image/image_reader.h>
 #include <stdexcept>
 #include <filesystem>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -153,3 +154,150 @@ TEST(ImageReaderTest, RecolorImageShouldRenumberColorMap) {
     }
   }
 }
+
+TEST(ImageReaderTest, DecodedImageShouldMatchImageFile) {
+  fs::path image_path = fs::current_path() / "img" / "colors.png";
+
+  ASSERT_TRUE(fs::exists(image_path)) << "Test image file does not exist at path: " << image_path;
+
+  ColorMap from_file(image_path.string());
+  ColorMap from_image;
+  from_image.load(cv::imread(image_path.string(), cv::IMREAD_COLOR), "colors");
+
+  ASSERT_EQ(from_image.get_color_map(), from_file.get_color_map());
+  ASSERT_EQ(from_image.get_color_mapping(), from_file.get_color_mapping());
+}
+
+TEST(ImageReaderTest, EmptyDecodedImageShouldThrowError) {
+  ColorMap cm;
+
+  ASSERT_THROW(cm.load(cv::Mat(), "empty"), std::invalid_argument);
+  ASSERT_THROW(cm.get_color_map(), std::invalid_argument);
+}
+
+/**
+  * @brief Image with many colors in bands, so colors first appear in different rows
+  */
+static cv::Mat many_color_image() {
+  cv::Mat image(97, 61, CV_8UC3);
+  for (int y = 0; y < image.rows; ++y) {
+    for (int x = 0; x < image.cols; ++x) {
+      int c = (y / 3) * 7 + x % 11;
+      image.at<cv::Vec3b>(y, x) = cv::Vec3b(c & 0xff, (c * 37) & 0xff, (x / 20) * 50);
+    }
+  }
+  return image;
+}
+
+TEST(ImageReaderTest, ColorsAreNumberedInOrderOfFirstAppearance) {
+  cv::Mat image = many_color_image();
+
+  // Number the colors the way the original per-pixel loop did
+  std::unordered_map<cv::Vec3b, int> expected_mapping;
+  std::vector<std::vector<int>> expected_map(image.rows, std::vector<int>(image.cols));
+  for (int y = 0; y < image.rows; ++y) {
+    for (int x = 0; x < image.cols; ++x) {
+      cv::Vec3b color = image.at<cv::Vec3b>(y, x);
+      if (expected_mapping.find(color) == expected_mapping.end()) {
+        int index = static_cast<int>(expected_mapping.size());
+        expected_mapping[color] = index;
+      }
+      expected_map[y][x] = expected_mapping[color];
+    }
+  }
+
+  for (unsigned threads : {1u, 3u, 8u}) {
+    ColorMap cm;
+    cm.set_threads(threads);
+    cm.load(image, "many colors");
+
+    ASSERT_EQ(cm.get_color_map(), expected_map) << "threads " << threads;
+    ASSERT_EQ(cm.get_color_mapping(), expected_mapping) << "threads " << threads;
+  }
+}
+
+TEST(ImageReaderTest, LoadWithMappingMatchesLoadThenRecolor) {
+  fs::path image_path = fs::current_path() / "img" / "dot.png";
+
+  ASSERT_TRUE(fs::exists(image_path)) << "Test image file does not exist at path: " << image_path;
+
+  std::unordered_map<cv::Vec3b, int> color_mapping;
+  color_mapping[cv::Vec3b(0, 0, 0)] = 11;
+  color_mapping[cv::Vec3b(255, 255, 255)] = 10;
+
+  ColorMap recolored(image_path.string());
+  recolored.recolor(color_mapping);
+  ColorMap mapped(image_path.string(), color_mapping);
+
+  ASSERT_EQ(mapped.get_color_map(), recolored.get_color_map());
+  ASSERT_EQ(mapped.get_color_index(), recolored.get_color_index());
+  ASSERT_EQ(mapped.get_color_mapping(), recolored.get_color_mapping());
+}
+
+TEST(ImageReaderTest, LoadWithMappingMissingColorsShouldThrowError) {
+  cv::Mat image = many_color_image();
+  std::unordered_map<cv::Vec3b, int> color_mapping;
+  color_mapping[image.at<cv::Vec3b>(0, 0)] = 0;
+
+  for (unsigned threads : {1u, 4u}) {
+    ColorMap cm;
+    cm.set_threads(threads);
+    cv::Vec3b missing = image.at<cv::Vec3b>(0, 1);
+    try {
+      cm.load(image, "many colors", color_mapping);
+      FAIL() << "Expected std::invalid_argument";
+    } catch (const std::invalid_argument& e) {
+      // The first missing pixel in row-major order is reported
+      ASSERT_EQ(std::string(e.what()), "Missing color: (" + std::to_string(missing[0]) + "," +
+                std::to_string(missing[1]) + "," + std::to_string(missing[2]) + ")");
+    }
+    ASSERT_THROW(cm.get_color_map(), std::invalid_argument);
+  }
+}
+
+TEST(ImageReaderTest, ViewSharesColorMapBufferAndLabelMatCopiesIt) {
+  ColorMap cm;
+  ASSERT_THROW(cm.get_color_view(), std::invalid_argument);
+  ASSERT_THROW(cm.get_label_mat(), std::invalid_argument);
+
+  cm.load(many_color_image(), "many colors");
+  const nucleusforce::Grid<int>& grid = cm.get_color_grid();
+  nucleusforce::GridView<const int> view = cm.get_color_view();
+  cv::Mat labels = cm.get_label_mat();
+
+  ASSERT_EQ(view.data(), grid.data());
+  ASSERT_EQ(view.rows(), grid.rows());
+  ASSERT_EQ(view.cols(), grid.cols());
+  ASSERT_NE(reinterpret_cast<const int*>(labels.data), grid.data());
+  ASSERT_EQ(labels.type(), CV_32S);
+  ASSERT_EQ(labels.rows, grid.rows());
+  ASSERT_EQ(labels.cols, grid.cols());
+  ASSERT_EQ(labels.at<int>(5, 7), grid(5, 7));
+
+  // Writing to the copy leaves the color map alone
+  int before = grid(5, 7);
+  labels.at<int>(5, 7) = before + 1;
+  ASSERT_EQ(grid(5, 7), before);
+}
+
+TEST(ImageReaderTest, ConcurrentReadersSeeTheSameColorMap) {
+  ColorMap cm;
+  cm.load(many_color_image(), "many colors");
+  const ColorMap& shared = cm;
+
+  std::vector<std::vector<std::vector<int>>> maps(4);
+  std::vector<size_t> colors(4);
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; ++i) {
+    readers.emplace_back([&, i] {
+      maps[i] = shared.get_color_view().to_vector();
+      colors[i] = shared.get_color_mapping().size() + shared.get_color_index().size();
+    });
+  }
+  for (std::thread& reader : readers) reader.join();
+
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_EQ(maps[i], cm.get_color_map());
+    ASSERT_EQ(colors[i], 2 * cm.get_color_mapping().size());
+  }
+}
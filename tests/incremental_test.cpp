@@ -0,0 +1,225 @@
+#include <gtest/gtest.h>
+#include <nucleus_force/distance.h>
+#include <nucleus_force/incremental.h>
+#include <nucleus_force/nucleus_force.h>
+#include <nucleus_force/propagation.h>
+#include "reference_force.h"
+#include <random>
+#include <vector>
+
+using namespace nucleusforce;
+using nucleusforce::testing::RandomGeometry;
+
+/**
+  * @brief Set the cell to value in a small disc, leaving the nucleus alone
+  */
+static void paint_cell(RandomGeometry& g, int cy, int cx, int r, int value) {
+  for (int y = std::max(0, cy - r); y <= std::min(g.cell.rows() - 1, cy + r); ++y) {
+    for (int x = std::max(0, cx - r); x <= std::min(g.cell.cols() - 1, cx + r); ++x) {
+      if ((y - cy) * (y - cy) + (x - cx) * (x - cx) <= r * r && g.nucleus(y, x) == 0) {
+        g.cell(y, x) = value;
+      }
+    }
+  }
+}
+
+/**
+  * @brief Move the nucleus one pixel right, filling the space it leaves with cell
+  */
+static void shift_nucleus(RandomGeometry& g) {
+  Grid<int> nucleus(g.nucleus.rows(), g.nucleus.cols());
+  for (int y = 0; y < nucleus.rows(); ++y) {
+    for (int x = 1; x < nucleus.cols(); ++x) {
+      nucleus(y, x) = g.nucleus(y, x - 1);
+    }
+  }
+  for (int y = 0; y < nucleus.rows(); ++y) {
+    for (int x = 0; x < nucleus.cols(); ++x) {
+      if (g.nucleus(y, x) == 1 && nucleus(y, x) == 0) g.cell(y, x) = 1;
+      if (nucleus(y, x) == 1) g.cell(y, x) = 0;
+    }
+  }
+  g.nucleus = nucleus;
+}
+
+static void expect_full_recompute(const IncrementalForceMap& map, const RandomGeometry& g, int frame) {
+  Grid<int> dist = find_dist(g.cell, g.nucleus);
+  Grid<double> flux(g.cell.rows(), g.cell.cols());
+  Grid<int> boundary = find_boundary(g.cell, g.nucleus);
+  for (size_t i = 0; i < flux.size(); ++i) {
+    flux.data()[i] = boundary.data()[i];
+  }
+  find_flux(dist, build_levels(dist), flux);
+
+  ASSERT_EQ(map.boundary(), boundary) << "frame " << frame;
+  ASSERT_EQ(map.dist(), dist) << "frame " << frame;
+  ASSERT_EQ(map.flux(), flux) << "frame " << frame;
+  ASSERT_EQ(map.nucleus_force(), find_nucleus_force(g.cell, g.nucleus)) << "frame " << frame;
+}
+
+TEST(Incremental_UpdateDistTests, MatchesFindDistAfterRandomEdits) {
+  for (unsigned seed = 0; seed < 10; ++seed) {
+    RandomGeometry g(60, 70, seed, seed % 2 == 1);
+    Grid<int> dist = find_dist(g.cell, g.nucleus);
+    std::mt19937 rng(seed);
+
+    for (int step = 0; step < 10; ++step) {
+      Grid<int> old_cell = g.cell;
+      Grid<int> old_nucleus = g.nucleus;
+      paint_cell(g, rng() % 60, rng() % 70, 1 + rng() % 4, step % 2);
+      if (step == 4) shift_nucleus(g);
+
+      std::vector<int> changed;
+      for (int i = 0; i < static_cast<int>(g.cell.size()); ++i) {
+        if (g.cell.data()[i] != old_cell.data()[i] || g.nucleus.data()[i] != old_nucleus.data()[i]) {
+          changed.push_back(i);
+        }
+      }
+      Grid<int> old_dist = dist;
+      std::vector<int> moved = update_dist(g.cell, g.nucleus, changed, dist);
+
+      Grid<int> expected = find_dist(g.cell, g.nucleus);
+      ASSERT_EQ(dist, expected) << "seed " << seed << ", step " << step;
+      for (int i = 0; i < static_cast<int>(dist.size()); ++i) {
+        bool differs = old_dist.data()[i] != dist.data()[i];
+        ASSERT_EQ(differs, std::binary_search(moved.begin(), moved.end(), i));
+      }
+    }
+  }
+}
+
+TEST(Incremental_FluxTests, NucleusFluxMatchesPropagatedForce) {
+  for (unsigned seed = 0; seed < 10; ++seed) {
+    RandomGeometry g(40, 50, seed);
+    Grid<int> dist = find_dist(g.cell, g.nucleus);
+    Grid<double> flux = g.force;
+    find_flux(dist, build_levels(dist), flux);
+    Grid<double> force = find_nucleus_force(g.cell, g.nucleus, g.force);
+
+    for (int y = 0; y < dist.rows(); ++y) {
+      for (int x = 0; x < dist.cols(); ++x) {
+        if (dist(y, x) == 0) {
+          ASSERT_EQ(flux(y, x), force(y, x));
+        }
+      }
+    }
+  }
+}
+
+TEST(Incremental_ForceMapTests, MatchesFullRecomputeOverTimeLapse) {
+  for (unsigned seed = 0; seed < 5; ++seed) {
+    RandomGeometry g(80, 90, seed);
+    IncrementalForceMap map(g.cell, g.nucleus);
+    expect_full_recompute(map, g, 0);
+    std::mt19937 rng(seed);
+
+    for (int frame = 1; frame <= 12; ++frame) {
+      paint_cell(g, rng() % 80, rng() % 90, 1 + rng() % 3, frame % 3 != 0);
+      if (frame % 5 == 0) shift_nucleus(g);
+
+      map.update(g.cell, g.nucleus);
+      expect_full_recompute(map, g, frame);
+      ASSERT_EQ(map.force_vector(), find_force_vector(g.nucleus, find_nucleus_force(g.cell, g.nucleus)));
+    }
+  }
+}
+
+TEST(Incremental_ForceMapTests, ChangedPixelsMatchFullRecomputeOverTimeLapse) {
+  for (unsigned seed = 0; seed < 5; ++seed) {
+    RandomGeometry g(80, 90, seed, seed % 2 == 1);
+    IncrementalForceMap map(g.cell, g.nucleus);
+    std::mt19937 rng(seed);
+
+    for (int frame = 1; frame <= 12; ++frame) {
+      Grid<int> old_cell = g.cell;
+      Grid<int> old_nucleus = g.nucleus;
+      paint_cell(g, rng() % 80, rng() % 90, 1 + rng() % 3, frame % 3 != 0);
+      if (frame % 5 == 0) shift_nucleus(g);
+
+      // Only the differing pixels, plus a no-op and a pixel listed twice whose last value wins
+      std::vector<PixelChange> changes = {{0, 0, old_cell(0, 0), old_nucleus(0, 0)}};
+      for (int y = 0; y < g.cell.rows(); ++y) {
+        for (int x = 0; x < g.cell.cols(); ++x) {
+          if (g.cell(y, x) != old_cell(y, x) || g.nucleus(y, x) != old_nucleus(y, x)) {
+            changes.push_back({y, x, 1 - g.cell(y, x), g.nucleus(y, x)});
+            changes.push_back({y, x, g.cell(y, x), g.nucleus(y, x)});
+          }
+        }
+      }
+      map.update(changes);
+      expect_full_recompute(map, g, frame);
+    }
+  }
+}
+
+TEST(Incremental_ForceMapTests, SmallEditOnlyTouchesNearbyDistances) {
+  RandomGeometry g(200, 200, 3);
+  IncrementalForceMap map(g.cell, g.nucleus);
+
+  // Notch the outer edge of the cell
+  paint_cell(g, 100, 190, 2, 0);
+  UpdateStats stats = map.update(g.cell, g.nucleus);
+
+  ASSERT_GT(stats.changed, 0);
+  ASSERT_FALSE(stats.full);
+  ASSERT_LT(stats.dist_changed, 200);
+  expect_full_recompute(map, g, 1);
+}
+
+TEST(Incremental_ForceMapTests, UnchangedFrameDoesNothing) {
+  RandomGeometry g(30, 30, 1);
+  IncrementalForceMap map(g.cell, g.nucleus);
+
+  UpdateStats stats = map.update(g.cell, g.nucleus);
+
+  ASSERT_EQ(stats.changed, 0);
+  ASSERT_EQ(stats.dist_changed, 0);
+  ASSERT_EQ(stats.flux_changed, 0);
+}
+
+TEST(Incremental_ForceMapTests, OverlappingNucleusFallsBackToFullPropagation) {
+  for (unsigned seed = 0; seed < 5; ++seed) {
+    RandomGeometry g(40, 40, seed, true);
+    IncrementalForceMap map(g.cell, g.nucleus);
+    expect_full_recompute(map, g, 0);
+    std::mt19937 rng(seed);
+
+    for (int frame = 1; frame <= 6; ++frame) {
+      paint_cell(g, rng() % 40, rng() % 40, 2, frame % 2);
+      map.update(g.cell, g.nucleus);
+      expect_full_recompute(map, g, frame);
+    }
+  }
+}
+
+TEST(Incremental_ForceMapTests, BoundaryOnNucleusFallsBackAndRecovers) {
+  RandomGeometry g(9, 9, 0);
+  g.cell = Grid<int>(9, 9, 1);
+  g.nucleus = Grid<int>(9, 9);
+  g.nucleus(4, 4) = 1;
+  g.nucleus(4, 5) = 1;
+  g.cell(4, 4) = 0;
+  g.cell(4, 5) = 0;
+  IncrementalForceMap map(g.cell, g.nucleus);
+
+  // (4, 5) becomes cell as well as nucleus, next to a hole in the cell
+  g.cell(4, 5) = 1;
+  g.cell(4, 6) = 0;
+  UpdateStats stats = map.update(g.cell, g.nucleus);
+  ASSERT_TRUE(stats.full);
+  expect_full_recompute(map, g, 1);
+
+  g.cell(4, 5) = 0;
+  stats = map.update(g.cell, g.nucleus);
+  ASSERT_FALSE(stats.full);
+  expect_full_recompute(map, g, 2);
+}
+
+TEST(Incremental_ForceMapTests, MismatchedFrameShouldThrowError) {
+  IncrementalForceMap map(Grid<int>(4, 4), Grid<int>(4, 4));
+
+  ASSERT_THROW(map.update(Grid<int>(4, 5), Grid<int>(4, 5)), std::invalid_argument);
+  ASSERT_THROW(map.update(Grid<int>(4, 4), Grid<int>(5, 4)), std::invalid_argument);
+  ASSERT_THROW(map.update({{4, 0, 1, 0}}), std::invalid_argument);
+  ASSERT_THROW(map.update({{0, -1, 1, 0}}), std::invalid_argument);
+}
@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include <common/kernels.h>
+#include <common/simd.h>
+#include <nucleus_force/nucleus_force.h>
+#include <random>
+#include <vector>
+#include "reference_force.h"
+
+using namespace nucleusforce;
+using nucleusforce::testing::RandomGeometry;
+using nucleusforce::testing::reference_boundary;
+
+/**
+  * @brief Run a test body once per instruction set this CPU supports
+  */
+template <typename Body>
+static void for_each_simd_level(Body body) {
+  for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2}) {
+    if (level > supported_simd_level()) continue;
+    set_simd_level(level);
+    body(level);
+  }
+  set_simd_level(supported_simd_level());
+}
+
+TEST(KernelsTest, SetSimdLevelIsLimitedToSupportedLevel) {
+  set_simd_level(SimdLevel::AVX2);
+  ASSERT_EQ(simd_level(), supported_simd_level());
+
+  set_simd_level(SimdLevel::Scalar);
+  ASSERT_EQ(simd_level(), SimdLevel::Scalar);
+
+  set_simd_level(supported_simd_level());
+  ASSERT_STREQ(simd_level_name(SimdLevel::Scalar), "scalar");
+}
+
+TEST(KernelsTest, SelectEqualRowMatchesScalar) {
+  std::mt19937 rng(1);
+  std::vector<int> in(1037);
+  for (int& v : in) v = rng() % 4;
+
+  for_each_simd_level([&](SimdLevel level) {
+    for (int n : {0, 1, 7, 8, 9, 1037}) {
+      std::vector<int> out(n, -1);
+      kernels::select_equal_row(in.data(), n, 2, out.data());
+      for (int x = 0; x < n; ++x) {
+        ASSERT_EQ(out[x], in[x] == 2) << simd_level_name(level) << " n " << n << " x " << x;
+      }
+    }
+  });
+}
+
+TEST(KernelsTest, BoundaryMatchesReferenceOnEveryLevel) {
+  for_each_simd_level([&](SimdLevel level) {
+    for (unsigned seed = 0; seed < 8; ++seed) {
+      RandomGeometry g(20 + seed, 3 + 7 * seed, seed, seed % 2 == 0);
+
+      ASSERT_EQ(find_boundary(g.cell, g.nucleus), reference_boundary(g.cell, g.nucleus))
+        << simd_level_name(level) << " seed " << seed;
+    }
+  });
+}
+
+TEST(KernelsTest, BoundaryOfThinImages) {
+  for_each_simd_level([&](SimdLevel level) {
+    for (int cols : {1, 2, 3}) {
+      Grid<int> cell(5, cols, 1);
+      Grid<int> nucleus(5, cols, 0);
+
+      ASSERT_EQ(find_boundary(cell, nucleus), reference_boundary(cell, nucleus)) << simd_level_name(level);
+    }
+  });
+}
+
+TEST(KernelsTest, ForceVectorMatchesScalar) {
+  RandomGeometry g(90, 77, 5);
+  Grid<double> force = find_nucleus_force(g.cell, g.nucleus, g.force);
+
+  set_simd_level(SimdLevel::Scalar);
+  std::vector<double> expected = find_force_vector(g.nucleus, force);
+
+  for_each_simd_level([&](SimdLevel level) {
+    std::vector<double> found = find_force_vector(g.nucleus, force);
+    ASSERT_NEAR(found[0], expected[0], 1e-9 * (1 + std::abs(expected[0]))) << simd_level_name(level);
+    ASSERT_NEAR(found[1], expected[1], 1e-9 * (1 + std::abs(expected[1]))) << simd_level_name(level);
+  });
+}
+
+TEST(KernelsTest, ScalarForceVectorMatchesOriginalLoop) {
+  RandomGeometry g(40, 33, 6);
+  Grid<double> force = find_nucleus_force(g.cell, g.nucleus, g.force);
+
+  std::vector<double> centroid = find_nucleus_centroid(g.nucleus);
+  std::vector<double> expected(2, 0);
+  for (int y = 0; y < g.nucleus.rows(); ++y) {
+    for (int x = 0; x < g.nucleus.cols(); ++x) {
+      if (g.nucleus(y, x) && force(y, x) != 0.0) {
+        double fy = centroid[1] - y;
+        double fx = centroid[0] - x;
+        double f_mag = std::sqrt(fy * fy + fx * fx);
+        expected[0] += fx / f_mag * force(y, x);
+        expected[1] += fy / f_mag * force(y, x);
+      }
+    }
+  }
+
+  set_simd_level(SimdLevel::Scalar);
+  ASSERT_EQ(find_force_vector(g.nucleus, force), expected);
+  set_simd_level(supported_simd_level());
+}
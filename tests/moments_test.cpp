@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include <nucleus_force/force_map.h>
+#include <nucleus_force/moments.h>
+#include <nucleus_force/nucleus_force.h>
+#include <cmath>
+#include "reference_force.h"
+
+using namespace nucleusforce;
+using nucleusforce::testing::RandomGeometry;
+
+TEST(MomentsTests, MatchesCentroidAndForceVector) {
+  for (unsigned seed = 0; seed < 5; ++seed) {
+    RandomGeometry g(60, 70, seed, seed % 2 == 1);
+    Grid<double> force = find_nucleus_force(g.cell, g.nucleus);
+
+    ForceMoments moments = find_force_moments(g.nucleus, force);
+
+    std::vector<double> centroid = find_nucleus_centroid(g.nucleus);
+    std::vector<double> force_vector = find_force_vector(g.nucleus, force);
+    ASSERT_EQ(moments.centroid(), centroid);
+    ASSERT_NEAR(moments.force_x, force_vector[0], 1e-9);
+    ASSERT_NEAR(moments.force_y, force_vector[1], 1e-9);
+  }
+}
+
+TEST(MomentsTests, TwoPixelNucleusIsSqueezedAlongTheLineBetweenThem) {
+  Grid<int> nucleus(1, 3);
+  nucleus(0, 0) = 1;
+  nucleus(0, 2) = 1;
+  Grid<double> force(1, 3, 1.0);
+
+  ForceMoments moments = find_force_moments(nucleus, force);
+
+  ASSERT_EQ(moments.pixels, 2);
+  ASSERT_EQ(moments.centroid_x, 1);
+  ASSERT_EQ(moments.centroid_y, 0);
+  ASSERT_EQ(moments.force_x, 0);
+  ASSERT_EQ(moments.force_y, 0);
+  ASSERT_EQ(moments.moment_xx, -2);
+  ASSERT_EQ(moments.moment_xy, 0);
+  ASSERT_EQ(moments.moment_yx, 0);
+  ASSERT_EQ(moments.moment_yy, 0);
+}
+
+TEST(MomentsTests, TensorIsSymmetricAndCompressive) {
+  RandomGeometry g(80, 90, 2);
+  Grid<double> force = find_nucleus_force(g.cell, g.nucleus);
+
+  ForceMoments moments = find_force_moments(g.nucleus, force);
+
+  ASSERT_NEAR(moments.torque(), 0, 1e-9);
+  ASSERT_NEAR(moments.moment_xy, moments.moment_yx, 1e-9);
+  ASSERT_LT(moments.moment_xx, 0);
+  ASSERT_LT(moments.moment_yy, 0);
+}
+
+TEST(MomentsTests, ResultDoesNotDependOnThreadCount) {
+  // A nucleus of several thousand pixels spans several summation blocks
+  RandomGeometry g(300, 320, 5);
+  Grid<double> force = find_nucleus_force(g.cell, g.nucleus);
+
+  ForceMoments serial = find_force_moments(g.nucleus, force, 1);
+  for (unsigned threads : {2u, 3u, 8u}) {
+    ForceMoments threaded = find_force_moments(g.nucleus, force, threads);
+    ASSERT_EQ(threaded.force_x, serial.force_x);
+    ASSERT_EQ(threaded.force_y, serial.force_y);
+    ASSERT_EQ(threaded.moment_xx, serial.moment_xx);
+    ASSERT_EQ(threaded.moment_xy, serial.moment_xy);
+    ASSERT_EQ(threaded.moment_yx, serial.moment_yx);
+    ASSERT_EQ(threaded.moment_yy, serial.moment_yy);
+  }
+}
+
+TEST(MomentsTests, ForceMapUsesItsNucleusLevel) {
+  RandomGeometry g(40, 45, 3);
+  Region placed{7, 11, 40, 45};
+  Grid<int> cell = embed(g.cell, placed, 60, 70);
+  Grid<int> nucleus = embed(g.nucleus, placed, 60, 70);
+
+  ForceMap cropped = ForceMap::cropped(cell, nucleus);
+  ForceMoments moments = cropped.force_moments();
+  ForceMoments full = find_force_moments(nucleus, find_nucleus_force(cell, nucleus));
+
+  ASSERT_NEAR(moments.centroid_x, full.centroid_x, 1e-9);
+  ASSERT_NEAR(moments.centroid_y, full.centroid_y, 1e-9);
+  ASSERT_NEAR(moments.force_x, full.force_x, 1e-9);
+  ASSERT_NEAR(moments.force_y, full.force_y, 1e-9);
+  ASSERT_NEAR(moments.moment_xx, full.moment_xx, 1e-9);
+  ASSERT_NEAR(moments.moment_yy, full.moment_yy, 1e-9);
+}
+
+TEST(MomentsTests, MismatchedDimensionsShouldThrowError) {
+  ASSERT_THROW(find_force_moments(Grid<int>(4, 4), Grid<double>(4, 5)), std::invalid_argument);
+}
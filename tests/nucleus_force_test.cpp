@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include <nucleus_force/nucleus_force.h>
 #include <image/image_reader.h>
+#include "reference_force.h"
 
 using namespace nucleusforce;
 
@@ -247,3 +248,265 @@ TEST(NucleusForce_FindForceTests, CellFindsCorrectForce) {
     }
   }
 }
+
+TEST(NucleusForce_FindBoundaryTests, NonSquareMapFindsBoundary) {
+  std::vector<std::vector<int>> cell(3, std::vector<int>(6));
+  cell[0] = {0, 0, 0, 0, 0, 0};
+  cell[1] = {0, 1, 1, 1, 1, 1};
+  cell[2] = {0, 0, 0, 0, 0, 0};
+
+  std::vector<std::vector<int>> nucleus(3, std::vector<int>(6));
+
+  std::vector<std::vector<int>> boundary = find_boundary(cell, nucleus);
+
+  ASSERT_EQ(boundary.size(), 3);
+  ASSERT_EQ(boundary[0].size(), 6);
+  ASSERT_EQ(boundary, cell);
+}
+
+TEST(NucleusForce_GridTests, GridOverloadsMatchVectorOverloads) {
+  std::vector<std::vector<int>> cell(4, std::vector<int>(5));
+  cell[0] = {0, 1, 1, 1, 1};
+  cell[1] = {0, 1, 0, 1, 1};
+  cell[2] = {0, 1, 0, 1, 1};
+  cell[3] = {0, 1, 1, 1, 0};
+
+  std::vector<std::vector<int>> nucleus(4, std::vector<int>(5));
+  nucleus[1] = {0, 0, 1, 0, 0};
+  nucleus[2] = {0, 0, 1, 0, 0};
+
+  Grid<int> cell_grid = Grid<int>::from_vector(cell);
+  Grid<int> nucleus_grid = Grid<int>::from_vector(nucleus);
+
+  ASSERT_EQ(find_boundary(cell_grid, nucleus_grid).to_vector(), find_boundary(cell, nucleus));
+  ASSERT_EQ(find_dist(cell_grid, nucleus_grid).to_vector(), find_dist(cell, nucleus));
+
+  Grid<double> force = find_nucleus_force(cell_grid, nucleus_grid);
+  ASSERT_EQ(force.to_vector(), find_nucleus_force(cell, nucleus));
+  ASSERT_EQ(find_force_vector(nucleus_grid, force), find_force_vector(nucleus, force.to_vector()));
+}
+
+TEST(NucleusForce_GridTests, MismatchedDimensionsShouldThrowError) {
+  Grid<int> cell(4, 4);
+  Grid<int> nucleus(4, 5);
+
+  ASSERT_THROW(find_dist(cell, nucleus), std::invalid_argument);
+  ASSERT_THROW(find_boundary(cell, nucleus), std::invalid_argument);
+  ASSERT_THROW(find_nucleus_force(cell, nucleus), std::invalid_argument);
+}
+
+TEST(NucleusForce_FindBoundaryTests, BitMaskBoundaryMatchesArrayBoundary) {
+  for (unsigned seed = 0; seed < 10; ++seed) {
+    nucleusforce::testing::RandomGeometry g(37 + 11 * seed, 150 - 9 * seed, seed, seed % 3 == 0);
+
+    BitMask boundary = find_boundary(BitMask::from_grid(g.cell), BitMask::from_grid(g.nucleus));
+
+    ASSERT_EQ(boundary.to_grid(), find_boundary(g.cell, g.nucleus)) << "seed " << seed;
+  }
+}
+
+TEST(NucleusForce_FindBoundaryTests, BitMaskBoundaryOfFullMaskIsItsEdge) {
+  Grid<int> cell(5, 128, 1);
+  Grid<int> nucleus(5, 128, 0);
+
+  Grid<int> boundary = find_boundary(BitMask::from_grid(cell), BitMask::from_grid(nucleus)).to_grid();
+
+  ASSERT_EQ(boundary, find_boundary(cell, nucleus));
+  ASSERT_EQ(boundary(2, 0), 1);
+  ASSERT_EQ(boundary(2, 63), 0);
+  ASSERT_EQ(boundary(2, 64), 0);
+  ASSERT_EQ(boundary(2, 127), 1);
+}
+
+TEST(NucleusForce_SparseTests, SparseOverloadsMatchDense) {
+  using nucleusforce::testing::RandomGeometry;
+  for (unsigned seed = 0; seed < 4; ++seed) {
+    RandomGeometry g(45, 38, seed, seed % 2 == 1);
+    SparseGrid<double> sparse_force = SparseGrid<double>::from_dense(g.force);
+
+    Grid<double> dense = find_nucleus_force(g.cell, g.nucleus, g.force);
+    ASSERT_EQ(find_nucleus_force(g.cell, g.nucleus, sparse_force), dense);
+    ASSERT_EQ(find_sparse_nucleus_force(g.cell, g.nucleus, sparse_force), SparseGrid<double>::from_dense(dense));
+    ASSERT_EQ(find_sparse_nucleus_force(g.cell, g.nucleus, sparse_force, 3), SparseGrid<double>::from_dense(dense));
+    ASSERT_EQ(find_sparse_nucleus_force(g.cell, g.nucleus).to_dense(), find_nucleus_force(g.cell, g.nucleus));
+
+    std::vector<double> expected = find_force_vector(g.nucleus, dense);
+    std::vector<double> actual = find_force_vector(g.nucleus, SparseGrid<double>::from_dense(dense));
+    ASSERT_NEAR(actual[0], expected[0], 1e-9 * (1 + std::abs(expected[0])));
+    ASSERT_NEAR(actual[1], expected[1], 1e-9 * (1 + std::abs(expected[1])));
+  }
+}
+
+TEST(NucleusForce_SparseTests, SparseForceKeepsOnlyNucleusPixels) {
+  using nucleusforce::testing::RandomGeometry;
+  RandomGeometry g(60, 60, 7);
+
+  SparseGrid<double> force = find_sparse_nucleus_force(g.cell, g.nucleus);
+
+  for (int y = 0; y < force.rows(); ++y) {
+    for (size_t i = force.row_offsets()[y]; i < force.row_offsets()[y + 1]; ++i) {
+      ASSERT_EQ(g.nucleus(y, force.columns()[i]), 1);
+    }
+  }
+}
+
+TEST(NucleusForce_SparseTests, MismatchedSparseDimensionsShouldThrowError) {
+  Grid<int> cell(4, 5);
+  SparseGrid<double> force(5, 4);
+
+  ASSERT_THROW(find_nucleus_force(cell, cell, force), std::invalid_argument);
+  ASSERT_THROW(find_sparse_nucleus_force(cell, cell, force), std::invalid_argument);
+  ASSERT_THROW(find_force_vector(cell, force), std::invalid_argument);
+}
+
+TEST(NucleusForce_SensitivityTests, SensitivityMatchesUnitForces) {
+  using nucleusforce::testing::RandomGeometry;
+  RandomGeometry g(40, 44, 5);
+  Grid<int> boundary = find_boundary(g.cell, g.nucleus);
+
+  ForceSensitivity sensitivity = find_force_sensitivity(g.cell, g.nucleus);
+
+  int checked = 0;
+  for (int y = 0; y < boundary.rows(); ++y) {
+    for (int x = 0; x < boundary.cols(); x += 3) {
+      if (!boundary(y, x)) continue;
+      Grid<double> unit(boundary.rows(), boundary.cols());
+      unit(y, x) = 1;
+      std::vector<double> net = find_force_vector(g.nucleus, find_nucleus_force(g.cell, g.nucleus, unit));
+      ASSERT_NEAR(sensitivity.x(y, x), net[0], 1e-12) << "at (" << y << ", " << x << ")";
+      ASSERT_NEAR(sensitivity.y(y, x), net[1], 1e-12) << "at (" << y << ", " << x << ")";
+      checked++;
+    }
+  }
+  ASSERT_GT(checked, 50);
+}
+
+TEST(NucleusForce_SensitivityTests, SensitivityTimesForceIsNetForce) {
+  using nucleusforce::testing::RandomGeometry;
+  for (unsigned seed = 0; seed < 4; ++seed) {
+    RandomGeometry g(50, 47, seed, seed % 2 == 1);
+
+    for (unsigned threads : {1u, 3u}) {
+      ForceSensitivity sensitivity = find_force_sensitivity(g.cell, g.nucleus, g.force, threads);
+      std::vector<double> expected = find_force_vector(g.nucleus, find_nucleus_force(g.cell, g.nucleus, g.force));
+
+      double fx = 0;
+      double fy = 0;
+      for (size_t i = 0; i < g.force.size(); ++i) {
+        fx += sensitivity.x.data()[i] * g.force.data()[i];
+        fy += sensitivity.y.data()[i] * g.force.data()[i];
+      }
+      ASSERT_NEAR(fx, expected[0], 1e-9 * (1 + std::abs(expected[0])));
+      ASSERT_NEAR(fy, expected[1], 1e-9 * (1 + std::abs(expected[1])));
+    }
+  }
+}
+
+TEST(NucleusForce_SensitivityTests, PixelOnCentroidHasNoSensitivity) {
+  // 3x3 nucleus in the middle of a 7x7 cell, so the centre pixel is the centroid
+  Grid<int> cell(7, 7, 1);
+  Grid<int> nucleus(7, 7);
+  for (int y = 2; y < 5; ++y) {
+    for (int x = 2; x < 5; ++x) {
+      cell(y, x) = 0;
+      nucleus(y, x) = 1;
+    }
+  }
+  Grid<int> boundary = find_boundary(cell, nucleus);
+
+  ForceSensitivity sensitivity = find_force_sensitivity(cell, nucleus);
+  std::vector<double> expected = find_force_vector(nucleus, find_nucleus_force(cell, nucleus));
+
+  ASSERT_EQ(sensitivity.x(3, 3), 0);
+  ASSERT_EQ(sensitivity.y(3, 3), 0);
+  double fx = 0;
+  double fy = 0;
+  for (size_t i = 0; i < boundary.size(); ++i) {
+    fx += sensitivity.x.data()[i] * boundary.data()[i];
+    fy += sensitivity.y.data()[i] * boundary.data()[i];
+  }
+  ASSERT_NEAR(fx, expected[0], 1e-12);
+  ASSERT_NEAR(fy, expected[1], 1e-12);
+}
+
+/**
+  * @brief Net force summed pixel by pixel in row-major order, as the scalar find_force_vector does
+  */
+static std::vector<double> scalar_force_vector(const Grid<int>& nucleus, const Grid<double>& force) {
+  std::vector<double> centroid = find_nucleus_centroid(nucleus);
+  std::vector<double> f_net(2, 0);
+  for (int y = 0; y < nucleus.rows(); ++y) {
+    for (int x = 0; x < nucleus.cols(); ++x) {
+      if (nucleus(y, x) && force(y, x) != 0.0) {
+        double dy = centroid[1] - y;
+        double dx = centroid[0] - x;
+        double mag = std::sqrt(dy * dy + dx * dx);
+        f_net[0] += dx / mag * force(y, x);
+        f_net[1] += dy / mag * force(y, x);
+      }
+    }
+  }
+  return f_net;
+}
+
+TEST(NucleusForce_NetForceTests, NetForceMatchesForceField) {
+  using nucleusforce::testing::RandomGeometry;
+  for (unsigned seed = 0; seed < 5; ++seed) {
+    RandomGeometry g(53, 49, seed);
+
+    // Force on each pixel is carried exactly as propagate_force does, so only the final
+    // sum can differ from find_force_vector's vectorised one
+    ASSERT_EQ(find_net_force(g.cell, g.nucleus), scalar_force_vector(g.nucleus, find_nucleus_force(g.cell, g.nucleus)));
+    ASSERT_EQ(find_net_force(g.cell, g.nucleus, g.force),
+              scalar_force_vector(g.nucleus, find_nucleus_force(g.cell, g.nucleus, g.force)));
+
+    std::vector<double> expected = find_force_vector(g.nucleus, find_nucleus_force(g.cell, g.nucleus));
+    std::vector<double> actual = find_net_force(g.cell, g.nucleus);
+    ASSERT_NEAR(actual[0], expected[0], 1e-9 * (1 + std::abs(expected[0])));
+    ASSERT_NEAR(actual[1], expected[1], 1e-9 * (1 + std::abs(expected[1])));
+  }
+}
+
+TEST(NucleusForce_NetForceTests, NetForceMatchesWhenCellOverlapsNucleus) {
+  using nucleusforce::testing::RandomGeometry;
+  for (unsigned seed = 0; seed < 5; ++seed) {
+    RandomGeometry g(47, 55, seed, true);
+
+    for (bool boundary : {true, false}) {
+      std::vector<double> expected = boundary
+          ? find_force_vector(g.nucleus, find_nucleus_force(g.cell, g.nucleus))
+          : find_force_vector(g.nucleus, find_nucleus_force(g.cell, g.nucleus, g.force));
+      std::vector<double> actual = boundary ? find_net_force(g.cell, g.nucleus)
+                                            : find_net_force(g.cell, g.nucleus, g.force);
+      ASSERT_NEAR(actual[0], expected[0], 1e-9 * (1 + std::abs(expected[0])));
+      ASSERT_NEAR(actual[1], expected[1], 1e-9 * (1 + std::abs(expected[1])));
+    }
+  }
+}
+
+TEST(NucleusForce_FindBoundaryTests, PixelBoundaryMatchesArrayBoundary) {
+  using nucleusforce::testing::RandomGeometry;
+  RandomGeometry g(31, 29, 2, true);
+
+  Grid<int> boundary = find_boundary(g.cell, g.nucleus);
+
+  for (int y = 0; y < boundary.rows(); ++y) {
+    for (int x = 0; x < boundary.cols(); ++x) {
+      ASSERT_EQ(is_boundary(g.cell, g.nucleus, y, x), boundary(y, x) == 1);
+    }
+  }
+}
+
+TEST(NucleusForce_BoundingBoxTests, BoxHoldsCellAndNucleusWithHalo) {
+  Grid<int> cell(8, 10);
+  Grid<int> nucleus(8, 10);
+  cell(2, 3) = 1;
+  cell(4, 6) = 1;
+  nucleus(5, 4) = 1;
+
+  ASSERT_EQ(find_bounding_box(cell, nucleus, 0), (Region{2, 3, 4, 4}));
+  ASSERT_EQ(find_bounding_box(cell, nucleus), (Region{1, 2, 6, 6}));
+  ASSERT_EQ(find_bounding_box(cell, nucleus, 3), (Region{0, 0, 8, 10}));
+  ASSERT_TRUE(find_bounding_box(Grid<int>(8, 10), Grid<int>(8, 10)).empty());
+  ASSERT_THROW(find_bounding_box(cell, nucleus, -1), std::invalid_argument);
+}
@@ -0,0 +1,203 @@
+#include <gtest/gtest.h>
+#include <nucleus_force/distance.h>
+#include <nucleus_force/nucleus_force.h>
+#include <nucleus_force/propagation.h>
+#include <cmath>
+#include <stdexcept>
+#include "reference_force.h"
+
+using namespace nucleusforce;
+using nucleusforce::testing::RandomGeometry;
+using nucleusforce::testing::reference_nucleus_force;
+
+TEST(Propagation_BuildLevelsTests, LevelsAreSortedByDistanceThenPosition) {
+  std::vector<std::vector<int>> dist(3, std::vector<int>(3));
+  dist[0] = {2, 1, 2};
+  dist[1] = {1, 0, -1};
+  dist[2] = {2, 1, 2};
+
+  DistanceLevels levels = build_levels(Grid<int>::from_vector(dist));
+
+  ASSERT_EQ(levels.count(), 3);
+  ASSERT_EQ(levels.size(0), 1);
+  ASSERT_EQ(levels.size(1), 3);
+  ASSERT_EQ(levels.size(2), 4);
+  ASSERT_EQ(levels.pixels, std::vector<int>({4, 1, 3, 7, 0, 2, 6, 8}));
+}
+
+TEST(Propagation_BuildLevelsTests, UnreachedMapHasNoLevels) {
+  DistanceLevels levels = build_levels(Grid<int>(4, 4, -1));
+
+  ASSERT_EQ(levels.count(), 0);
+  ASSERT_TRUE(levels.pixels.empty());
+}
+
+TEST(Propagation_PropagateTests, MatchesPriorityQueueOnRandomCells) {
+  for (unsigned seed = 0; seed < 20; ++seed) {
+    RandomGeometry g(33 + seed, 41 - seed, seed);
+
+    Grid<double> expected = reference_nucleus_force(g.cell, g.nucleus, g.force);
+    Grid<double> found = find_nucleus_force(g.cell, g.nucleus, g.force);
+
+    ASSERT_EQ(found, expected) << "seed " << seed;
+  }
+}
+
+TEST(Propagation_PropagateTests, MatchesPriorityQueueWhenCellOverlapsNucleus) {
+  for (unsigned seed = 0; seed < 20; ++seed) {
+    RandomGeometry g(30, 30, seed, true);
+
+    Grid<double> expected = reference_nucleus_force(g.cell, g.nucleus, g.force);
+    Grid<double> found = find_nucleus_force(g.cell, g.nucleus, g.force);
+
+    ASSERT_EQ(found, expected) << "seed " << seed;
+  }
+}
+
+TEST(Propagation_PropagateTests, MatchesPriorityQueueForBoundaryForce) {
+  for (unsigned seed = 0; seed < 5; ++seed) {
+    RandomGeometry g(64, 48, seed);
+    Grid<int> boundary = find_boundary(g.cell, g.nucleus);
+    Grid<double> force(boundary.rows(), boundary.cols());
+    for (size_t i = 0; i < boundary.size(); ++i) {
+      force.data()[i] = boundary.data()[i];
+    }
+
+    ASSERT_EQ(find_nucleus_force(g.cell, g.nucleus), reference_nucleus_force(g.cell, g.nucleus, force));
+  }
+}
+
+TEST(Propagation_ParallelTests, MatchesSerialForAnyThreadCount) {
+  for (unsigned seed = 0; seed < 10; ++seed) {
+    RandomGeometry g(170, 190, seed, seed % 2 == 1);
+    Grid<double> serial = find_nucleus_force(g.cell, g.nucleus, g.force);
+
+    for (unsigned threads : {1u, 2u, 3u, 8u}) {
+      ASSERT_EQ(find_nucleus_force(g.cell, g.nucleus, g.force, threads), serial)
+        << "seed " << seed << ", threads " << threads;
+    }
+  }
+}
+
+TEST(Propagation_ParallelTests, LargeLevelsSplitAcrossThreads) {
+  RandomGeometry g(600, 500, 7);
+  Grid<int> dist = find_dist(g.cell, g.nucleus);
+  DistanceLevels levels = build_levels(dist);
+
+  Grid<double> serial = g.force;
+  propagate_force(g.cell, g.nucleus, dist, levels, serial);
+
+  ThreadPool pool(4);
+  Grid<double> parallel = g.force;
+  propagate_force(g.cell, g.nucleus, dist, levels, parallel, pool);
+
+  ASSERT_EQ(parallel, serial);
+  ASSERT_EQ(find_nucleus_force(g.cell, g.nucleus, 4), find_nucleus_force(g.cell, g.nucleus));
+}
+
+TEST(Propagation_ParallelTests, MismatchedDimensionsShouldThrowError) {
+  RandomGeometry g(30, 30, 2);
+  Grid<int> dist = find_dist(g.cell, g.nucleus);
+  DistanceLevels levels = build_levels(dist);
+  ThreadPool pool(2);
+  Grid<double> f = g.force;
+  Grid<double> small_f(30, 29);
+
+  ASSERT_THROW(propagate_force(g.cell, Grid<int>(29, 30), dist, levels, f, pool), std::invalid_argument);
+  ASSERT_THROW(propagate_force(g.cell, g.nucleus, Grid<int>(30, 31), levels, f, pool), std::invalid_argument);
+  ASSERT_THROW(propagate_force(g.cell, g.nucleus, dist, levels, small_f, pool), std::invalid_argument);
+}
+
+TEST(Propagation_AdjointTests, AdjointIsTransposeOfPropagation) {
+  for (unsigned seed = 0; seed < 6; ++seed) {
+    RandomGeometry g(43, 51, seed, seed % 2 == 1);
+    RandomGeometry w(43, 51, seed + 100);
+    Grid<int> dist = find_dist(g.cell, g.nucleus);
+    DistanceLevels levels = build_levels(dist);
+
+    Grid<double> f = g.force;
+    propagate_force(g.cell, g.nucleus, dist, levels, f);
+    Grid<double> weight = w.force;
+    propagate_adjoint(g.cell, g.nucleus, dist, levels, g.force, weight);
+
+    // <propagate(force), w> == <force, adjoint(w)>
+    double forward = 0;
+    double backward = 0;
+    for (size_t i = 0; i < f.size(); ++i) {
+      forward += f.data()[i] * w.force.data()[i];
+      backward += g.force.data()[i] * weight.data()[i];
+    }
+    ASSERT_NEAR(forward, backward, 1e-9 * (1 + std::abs(forward)));
+  }
+}
+
+TEST(Propagation_AdjointTests, ParallelAdjointMatchesSerial) {
+  RandomGeometry g(90, 70, 4, true);
+  Grid<int> dist = find_dist(g.cell, g.nucleus);
+  DistanceLevels levels = build_levels(dist);
+  Grid<double> serial = RandomGeometry(90, 70, 5).force;
+  Grid<double> parallel = serial;
+
+  ThreadPool pool(3);
+  propagate_adjoint(g.cell, g.nucleus, dist, levels, g.force, serial);
+  propagate_adjoint(g.cell, g.nucleus, dist, levels, g.force, parallel, pool);
+
+  ASSERT_EQ(parallel, serial);
+}
+
+TEST(Propagation_DownhillTests, CityBlockDistanceMatchesLevels) {
+  for (unsigned seed = 0; seed < 5; ++seed) {
+    RandomGeometry g(40, 45, seed);
+    Grid<int> dist = find_dist(g.cell, g.nucleus);
+    Grid<double> real_dist(dist.rows(), dist.cols());
+    for (size_t i = 0; i < dist.size(); ++i) real_dist.data()[i] = dist.data()[i];
+
+    Grid<double> f = g.force;
+    propagate_force_downhill(g.cell, g.nucleus, real_dist, f);
+
+    ASSERT_EQ(f, find_nucleus_force(g.cell, g.nucleus, g.force)) << "seed " << seed;
+  }
+}
+
+TEST(Propagation_DownhillTests, GeodesicForceReachesNucleus) {
+  for (unsigned seed = 0; seed < 4; ++seed) {
+    RandomGeometry g(50, 45, seed);
+    Grid<int> boundary = find_boundary(g.cell, g.nucleus);
+    Grid<double> dist = find_geodesic_dist(g.cell, g.nucleus);
+
+    Grid<double> force = find_nucleus_force(g.cell, g.nucleus, DistanceMetric::Geodesic);
+
+    double applied = 0;
+    double arrived = 0;
+    for (int y = 0; y < g.cell.rows(); ++y) {
+      for (int x = 0; x < g.cell.cols(); ++x) {
+        if (boundary(y, x) == 1 && dist(y, x) >= 0) applied += 1;
+        if (g.nucleus(y, x) == 1) arrived += force(y, x);
+        else ASSERT_EQ(force(y, x), 0);
+      }
+    }
+    ASSERT_NEAR(arrived, applied, 1e-9 * applied);
+  }
+}
+
+TEST(Propagation_DownhillTests, EuclideanForceReachesNucleusOfConvexCell) {
+  Grid<int> cell(41, 41, 0);
+  Grid<int> nucleus(41, 41, 0);
+  for (int y = 0; y < 41; ++y) {
+    for (int x = 0; x < 41; ++x) {
+      double r = std::hypot(y - 20.0, x - 20.0);
+      if (r < 6) nucleus(y, x) = 1;
+      else if (r < 18) cell(y, x) = 1;
+    }
+  }
+  Grid<int> boundary = find_boundary(cell, nucleus);
+  double applied = 0;
+  for (size_t i = 0; i < boundary.size(); ++i) applied += boundary.data()[i];
+
+  Grid<double> force = find_nucleus_force(cell, nucleus, DistanceMetric::Euclidean, 2);
+
+  double arrived = 0;
+  for (size_t i = 0; i < force.size(); ++i) arrived += nucleus.data()[i] == 1 ? force.data()[i] : 0;
+  ASSERT_NEAR(arrived, applied, 1e-9 * applied);
+  ASSERT_EQ(find_nucleus_force(cell, nucleus, DistanceMetric::CityBlock), find_nucleus_force(cell, nucleus));
+}
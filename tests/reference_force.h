@@ -0,0 +1,133 @@
+#ifndef REFERENCE_FORCE_H
+#define REFERENCE_FORCE_H
+
+#include <common/grid.h>
+#include <nucleus_force/nucleus_force.h>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <queue>
+#include <random>
+#include <utility>
+
+namespace nucleusforce::testing {
+/**
+  * @brief Original priority-queue propagation, kept as the reference for the faster engines
+  */
+inline Grid<double> reference_nucleus_force(const Grid<int>& cell,
+                                            const Grid<int>& nucleus,
+                                            const Grid<double>& force) {
+  const int dy[4] = {0, 1, 0, -1};
+  const int dx[4] = {1, 0, -1, 0};
+
+  Grid<int> dist = find_dist(cell, nucleus);
+  Grid<double> f = force;
+  std::priority_queue<std::pair<int, std::pair<int, int>>> q;
+
+  for (int y = 0; y < force.rows(); ++y) {
+    for (int x = 0; x < force.cols(); ++x) {
+      if (cell(y, x) == 1 && force(y, x) != 0) {
+        q.push(make_coord(y, x, dist(y, x)));
+      }
+    }
+  }
+
+  while (!q.empty()) {
+    int y = q.top().second.first;
+    int x = q.top().second.second;
+    q.pop();
+
+    if (f(y, x) == 0) continue;
+
+    int min_dist = INT_MAX;
+    int count = 0;
+    for (int i = 0; i < 4; i++) {
+      int ny = y + dy[i];
+      int nx = x + dx[i];
+      if (ny < 0 || ny >= cell.rows() || nx < 0 || nx >= cell.cols()) continue;
+      if (cell(ny, nx) == 1 || nucleus(ny, nx) == 1) {
+        if (dist(ny, nx) >= 0 && dist(ny, nx) < min_dist) {
+          min_dist = dist(ny, nx);
+          count = 1;
+        } else if (dist(ny, nx) == min_dist) {
+          count++;
+        }
+      }
+    }
+
+    for (int i = 0; i < 4; i++) {
+      int ny = y + dy[i];
+      int nx = x + dx[i];
+      if (ny < 0 || ny >= cell.rows() || nx < 0 || nx >= cell.cols()) continue;
+      if ((cell(ny, nx) == 1 || nucleus(ny, nx) == 1) && dist(ny, nx) == min_dist) {
+        f(ny, nx) += f(y, x) / count;
+        if (nucleus(ny, nx) == 0) {
+          q.push(make_coord(ny, nx, dist(ny, nx)));
+        }
+      }
+    }
+
+    f(y, x) = 0;
+  }
+
+  return f;
+}
+
+/**
+  * @brief Original per-pixel boundary search, kept as the reference for the faster kernels
+  */
+inline Grid<int> reference_boundary(const Grid<int>& cell, const Grid<int>& nucleus) {
+  const int dy[8] = {0, 1, 0, -1, 0, 1, 0, -1};
+  const int dx[8] = {1, 0, -1, 0, 0, 1, 0, -1};
+
+  Grid<int> boundary(cell.rows(), cell.cols());
+  for (int y = 0; y < cell.rows(); ++y) {
+    for (int x = 0; x < cell.cols(); ++x) {
+      if (cell(y, x) != 1) continue;
+      for (int i = 0; i < 8; i++) {
+        int ny = y + dy[i];
+        int nx = x + dx[i];
+        if (ny < 0 || ny >= cell.rows() || nx < 0 || nx >= cell.cols() ||
+          (cell(ny, nx) == 0 && nucleus(ny, nx) == 0)) {
+          boundary(y, x) = 1;
+          break;
+        }
+      }
+    }
+  }
+  return boundary;
+}
+
+/**
+  * @brief Random cell and nucleus masks with a random force field
+  *
+  * The cell is a noisy disc with holes and a detached island, and the nucleus is a
+  * smaller disc inside it. With overlap set, some nucleus pixels are also cell pixels.
+  */
+struct RandomGeometry {
+  Grid<int> cell;
+  Grid<int> nucleus;
+  Grid<double> force;
+
+  RandomGeometry(int rows, int cols, unsigned seed, bool overlap = false)
+      : cell(rows, cols), nucleus(rows, cols), force(rows, cols) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> unit(0, 1);
+    double cy = rows / 2.0, cx = cols / 2.0;
+    double r_cell = 0.45 * std::min(rows, cols), r_nucleus = 0.15 * std::min(rows, cols);
+    for (int y = 0; y < rows; ++y) {
+      for (int x = 0; x < cols; ++x) {
+        double r = std::hypot(y - cy, x - cx);
+        bool in_nucleus = r < r_nucleus;
+        bool in_cell = r < r_cell * (0.85 + 0.3 * unit(rng)) && unit(rng) > 0.05;
+        bool island = y < rows / 8 && x < cols / 8;
+        nucleus(y, x) = in_nucleus;
+        cell(y, x) = (in_cell && (!in_nucleus || (overlap && unit(rng) < 0.3))) || island;
+        force(y, x) = unit(rng) < 0.3 ? unit(rng) * 4 - 1 : 0;
+      }
+    }
+  }
+};
+} // namespace nucleusforce::testing
+
+#endif // REFERENCE_FORCE_H
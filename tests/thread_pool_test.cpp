@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include <common/thread_pool.h>
+#include <common/work_stealing_pool.h>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace nucleusforce;
+
+TEST(ThreadPoolTest, SizeIncludesCallingThread) {
+  ThreadPool pool(3);
+
+  ASSERT_EQ(pool.size(), 3);
+  ASSERT_GE(ThreadPool(0).size(), 1);
+}
+
+TEST(ThreadPoolTest, ParallelForVisitsEveryIndexOnce) {
+  ThreadPool pool(4);
+  std::vector<int> visits(10000, 0);
+
+  pool.parallel_for(0, visits.size(), [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      visits[i]++;
+    }
+  }, 7);
+
+  for (int v : visits) {
+    ASSERT_EQ(v, 1);
+  }
+}
+
+TEST(ThreadPoolTest, ParallelForCanBeCalledRepeatedly) {
+  ThreadPool pool(3);
+  std::atomic<long> total{0};
+
+  for (int round = 0; round < 200; ++round) {
+    pool.parallel_for(0, 100, [&](int begin, int end) {
+      long sum = 0;
+      for (int i = begin; i < end; ++i) sum += i;
+      total += sum;
+    }, 1);
+  }
+
+  ASSERT_EQ(total.load(), 200L * 4950);
+}
+
+TEST(ThreadPoolTest, EmptyRangeDoesNothing) {
+  ThreadPool pool(2);
+  bool called = false;
+
+  pool.parallel_for(5, 5, [&](int, int) { called = true; });
+
+  ASSERT_FALSE(called);
+}
+
+TEST(ThreadPoolTest, BodyExceptionIsRethrownAfterRunningChunks) {
+  ThreadPool pool(4);
+  std::atomic<int> running{0};
+
+  // Every chunk throws, so both the workers and the calling thread do
+  for (int round = 0; round < 50; ++round) {
+    ASSERT_THROW(pool.parallel_for(0, 1000, [&](int, int) {
+      running++;
+      std::this_thread::yield();
+      running--;
+      throw std::runtime_error("chunk failed");
+    }, 1), std::runtime_error);
+    ASSERT_EQ(running, 0);
+  }
+
+  std::atomic<long> total{0};
+  pool.parallel_for(0, 100, [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) total += i;
+  }, 1);
+  ASSERT_EQ(total.load(), 4950);
+}
+
+TEST(WorkStealingPoolTest, RunsEveryTaskOnce) {
+  WorkStealingPool pool(4);
+  std::vector<std::atomic<int>> runs(500);
+
+  for (int round = 0; round < 20; ++round) {
+    pool.run(runs.size(), [&](int i) {
+      // Uneven tasks, so threads that finish early have to steal
+      volatile long sink = 0;
+      for (long k = 0; k < (i % 50 == 0 ? 200000 : 100); ++k) sink += k;
+      runs[i]++;
+    });
+  }
+
+  for (const std::atomic<int>& r : runs) {
+    ASSERT_EQ(r, 20);
+  }
+}
+
+TEST(WorkStealingPoolTest, TaskExceptionIsRethrownAfterOtherTasks) {
+  WorkStealingPool pool(3);
+  std::atomic<int> finished{0};
+
+  ASSERT_THROW(pool.run(100, [&](int i) {
+    if (i == 7) throw std::runtime_error("task failed");
+    finished++;
+  }), std::runtime_error);
+  ASSERT_EQ(finished, 99);
+
+  pool.run(10, [&](int) { finished++; });
+  ASSERT_EQ(finished, 109);
+}
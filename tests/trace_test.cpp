@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include <common/trace.h>
+#include <nucleus_force/nucleus_force.h>
+#include <sstream>
+#include <string>
+#include "reference_force.h"
+
+using namespace nucleusforce;
+using nucleusforce::testing::RandomGeometry;
+
+TEST(TraceTest, ScopesAndCountsGoToTheOpenSession) {
+  trace::Trace outer("outer");
+  trace::Trace inner("inner");
+  {
+    trace::Session session(outer);
+    trace::Scope scope("a");
+    trace::count("pixels", 3);
+    {
+      trace::Session nested(inner);
+      trace::Scope inner_scope("b");
+      trace::count("pixels", 5);
+    }
+    trace::count("pixels", 4);
+  }
+  trace::Scope ignored("c");
+  trace::count("pixels", 100);
+
+  ASSERT_EQ(outer.spans().size(), 1);
+  ASSERT_EQ(outer.spans()[0].name, "a");
+  ASSERT_GE(outer.spans()[0].duration_us, 0);
+  ASSERT_EQ(outer.counters().at("pixels"), 7);
+  ASSERT_EQ(inner.spans().size(), 1);
+  ASSERT_EQ(inner.spans()[0].name, "b");
+  ASSERT_EQ(inner.counters().at("pixels"), 5);
+  ASSERT_EQ(trace::current(), nullptr);
+}
+
+TEST(TraceTest, JsonAggregatesStages) {
+  trace::Trace t("frame \"1\"");
+  trace::Clock::time_point start = trace::Clock::now();
+  t.add_span("find_dist", start, start + std::chrono::microseconds(10));
+  t.add_span("find_dist", start, start + std::chrono::microseconds(5));
+  t.add_count("bytes_written", 42);
+
+  std::string json = t.to_json();
+
+  ASSERT_NE(json.find("\"name\":\"frame \\\"1\\\"\""), std::string::npos) << json;
+  ASSERT_NE(json.find("\"find_dist\":{\"calls\":2,\"total_us\":15}"), std::string::npos) << json;
+  ASSERT_NE(json.find("\"bytes_written\":42"), std::string::npos) << json;
+}
+
+TEST(TraceTest, ChromeTraceHasOneThreadPerTrace) {
+  trace::Trace a("a");
+  trace::Trace b("b");
+  trace::Clock::time_point start = trace::Clock::now();
+  a.add_span("find_boundary", start, start + std::chrono::microseconds(3));
+  b.add_count("queue_pushes", 9);
+
+  std::ostringstream out;
+  trace::write_chrome_trace(out, {&a, &b});
+  std::string json = out.str();
+
+  ASSERT_EQ(json.rfind("{\"traceEvents\":[", 0), 0);
+  ASSERT_NE(json.find("\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"a\"}"), std::string::npos) << json;
+  ASSERT_NE(json.find("\"name\":\"find_boundary\",\"cat\":\"stage\",\"ph\":\"X\",\"pid\":1,\"tid\":0"),
+            std::string::npos) << json;
+  ASSERT_NE(json.find("\"ph\":\"C\",\"pid\":1,\"tid\":1"), std::string::npos) << json;
+  ASSERT_NE(json.find("\"queue_pushes\":9"), std::string::npos) << json;
+}
+
+TEST(TraceTest, StagesAreRecordedOnlyWhenBuiltWithTracing) {
+  RandomGeometry g(40, 40, 1);
+  trace::Trace t;
+  {
+    trace::Session session(t);
+    find_nucleus_force(g.cell, g.nucleus);
+  }
+
+#ifdef NUCLEUSFORCE_TRACE
+  std::string json = t.to_json();
+  for (const char* stage : {"find_boundary", "find_dist", "propagate_force"}) {
+    ASSERT_NE(json.find(std::string("\"") + stage + "\":{\"calls\":"), std::string::npos) << stage;
+  }
+  ASSERT_GT(t.counters().at("dist_pixels_visited"), 0);
+  ASSERT_GT(t.counters().at("bytes_allocated"), 0);
+#else
+  ASSERT_TRUE(t.spans().empty());
+  ASSERT_TRUE(t.counters().empty());
+#endif
+}
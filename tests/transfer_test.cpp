@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+#include <nucleus_force/force_map.h>
+#include <nucleus_force/nucleus_force.h>
+#include <nucleus_force/transfer.h>
+#include "reference_force.h"
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace nucleusforce;
+using nucleusforce::testing::RandomGeometry;
+
+/**
+  * @brief Assert a and b agree to within rounding of the largest force
+  */
+static void expect_close(const Grid<double>& a, const Grid<double>& b) {
+  ASSERT_EQ(a.rows(), b.rows());
+  ASSERT_EQ(a.cols(), b.cols());
+  double scale = 1;
+  for (size_t i = 0; i < b.size(); ++i) {
+    scale = std::max(scale, std::abs(b.data()[i]));
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    ASSERT_NEAR(a.data()[i], b.data()[i], 1e-12 * scale) << "at pixel " << i;
+  }
+}
+
+/**
+  * @brief Random force on every input pixel, never zero
+  */
+static Grid<double> random_load(const Grid<int>& inputs, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> unit(0.1, 2);
+  Grid<double> force(inputs.rows(), inputs.cols());
+  for (size_t i = 0; i < force.size(); ++i) {
+    if (inputs.data()[i]) force.data()[i] = unit(rng);
+  }
+  return force;
+}
+
+TEST(TransferOperatorTests, BoundaryOperatorMatchesPropagation) {
+  for (unsigned seed = 0; seed < 4; ++seed) {
+    RandomGeometry g(47, 53, seed);
+    ForceMap fm(g.cell, g.nucleus);
+
+    TransferOperator op = fm.transfer_operator();
+
+    Grid<int> boundary = fm.boundary();
+    expect_close(op.apply(Grid<double>(fm.rows(), fm.cols())), Grid<double>(fm.rows(), fm.cols()));
+    for (unsigned field = 0; field < 3; ++field) {
+      Grid<double> force = random_load(boundary, seed * 10 + field);
+      expect_close(op.apply(force), find_nucleus_force(g.cell, g.nucleus, force));
+    }
+  }
+}
+
+TEST(TransferOperatorTests, AnyInputsMatchPropagation) {
+  for (unsigned seed = 0; seed < 4; ++seed) {
+    RandomGeometry g(41, 38, seed);
+    Grid<int> dist = find_dist(g.cell, g.nucleus);
+
+    // Every pixel is an input, including background, nucleus and unreached cell
+    TransferOperator op(g.cell, g.nucleus, dist, Grid<int>(41, 38, 1));
+
+    ASSERT_EQ(op.inputs().size(), 41 * 38);
+    expect_close(op.apply(g.force), find_nucleus_force(g.cell, g.nucleus, g.force));
+  }
+}
+
+TEST(TransferOperatorTests, OverlapPixelsMatchPropagationWhenLoaded) {
+  for (unsigned seed = 0; seed < 4; ++seed) {
+    RandomGeometry g(44, 44, seed, true);
+    ForceMap fm(g.cell, g.nucleus);
+    Grid<int> inputs = fm.boundary();
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      inputs.data()[i] |= g.cell.data()[i] & g.nucleus.data()[i];
+    }
+
+    TransferOperator op(g.cell, g.nucleus, fm.dist(), inputs);
+
+    Grid<double> force = random_load(inputs, seed);
+    expect_close(op.apply(force), find_nucleus_force(g.cell, g.nucleus, force));
+  }
+}
+
+TEST(TransferOperatorTests, UnloadedOverlapPixelShouldThrowError) {
+  RandomGeometry g(44, 44, 2, true);
+  ForceMap fm(g.cell, g.nucleus);
+  Grid<int> inputs = fm.boundary();
+  int overlap = -1;
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    if (g.cell.data()[i] & g.nucleus.data()[i]) {
+      inputs.data()[i] = 1;
+      overlap = static_cast<int>(i);
+    }
+  }
+  ASSERT_GE(overlap, 0);
+
+  TransferOperator op(g.cell, g.nucleus, fm.dist(), inputs);
+
+  // Propagation keeps the force that reaches an unloaded overlap pixel, which the operator cannot
+  Grid<double> force = random_load(inputs, 5);
+  force.data()[overlap] = 0;
+  ASSERT_THROW(op.apply(force), std::invalid_argument);
+  ASSERT_THROW(op.apply(std::vector<Grid<double>>{force}), std::invalid_argument);
+  ASSERT_THROW(op.apply_loads(Grid<double>(1, static_cast<int>(op.inputs().size()))), std::invalid_argument);
+}
+
+TEST(TransferOperatorTests, BatchedFieldsMatchSingleFields) {
+  RandomGeometry g(60, 52, 3);
+  ForceMap fm(g.cell, g.nucleus);
+  TransferOperator serial = fm.transfer_operator();
+  TransferOperator threaded(g.cell, g.nucleus, fm.dist(), fm.boundary(), 3);
+
+  std::vector<Grid<double>> forces;
+  for (unsigned field = 0; field < 5; ++field) {
+    forces.push_back(random_load(fm.boundary(), field));
+  }
+  std::vector<Grid<double>> results = threaded.apply(forces);
+
+  ASSERT_EQ(threaded.nonzeros(), serial.nonzeros());
+  ASSERT_EQ(results.size(), forces.size());
+  for (size_t k = 0; k < forces.size(); ++k) {
+    ASSERT_EQ(results[k], serial.apply(forces[k]));
+  }
+
+  Grid<double> loads(2, static_cast<int>(serial.inputs().size()), 1.0);
+  Grid<double> out = serial.apply_loads(loads);
+  ASSERT_EQ(out.rows(), 2);
+  ASSERT_EQ(out.cols(), static_cast<int>(serial.outputs().size()));
+  Grid<double> expected = fm.nucleus_force();
+  for (size_t o = 0; o < serial.outputs().size(); ++o) {
+    ASSERT_NEAR(out(1, static_cast<int>(o)), expected.data()[serial.outputs()[o]], 1e-12);
+  }
+}
+
+TEST(TransferOperatorTests, InvalidForceShouldThrowError) {
+  RandomGeometry g(30, 30, 1);
+  ForceMap fm(g.cell, g.nucleus);
+  TransferOperator op = fm.transfer_operator();
+
+  Grid<double> outside(30, 30);
+  for (size_t i = 0; i < outside.size(); ++i) {
+    if (!fm.boundary().data()[i]) {
+      outside.data()[i] = 1;
+      break;
+    }
+  }
+
+  ASSERT_THROW(op.apply(Grid<double>(29, 30)), std::invalid_argument);
+  ASSERT_THROW(op.apply(outside), std::invalid_argument);
+  ASSERT_THROW(op.apply_loads(Grid<double>(1, 3)), std::invalid_argument);
+  ASSERT_THROW(TransferOperator(g.cell, g.nucleus, Grid<int>(30, 31), fm.boundary()), std::invalid_argument);
+}
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include <nucleus_force/nucleus_force.h>
+#include <nucleus_force/propagation.h>
+#include <nucleus_force/workspace.h>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "reference_force.h"
+
+using namespace nucleusforce;
+using nucleusforce::testing::RandomGeometry;
+
+// Allocations made by the whole test, counted by the replacement operator new below
+static std::atomic<long long> allocations{0};
+
+void* operator new(std::size_t size) {
+  ++allocations;
+  void* p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+TEST(WorkspaceTests, WorkspaceMatchesAllocatingFunctions) {
+  Workspace workspace;
+  // Shrink and grow the workspace between geometries
+  const int sizes[][2] = {{40, 45}, {20, 25}, {60, 50}};
+  for (unsigned seed = 0; seed < 6; ++seed) {
+    RandomGeometry g(sizes[seed % 3][0], sizes[seed % 3][1], seed, seed % 2 == 1);
+
+    ASSERT_EQ(find_dist(g.cell, g.nucleus, workspace), find_dist(g.cell, g.nucleus));
+    ASSERT_EQ(find_boundary(g.cell, g.nucleus, workspace), find_boundary(g.cell, g.nucleus));
+    ASSERT_EQ(find_nucleus_force(g.cell, g.nucleus, g.force, workspace),
+              find_nucleus_force(g.cell, g.nucleus, g.force));
+
+    Grid<double> force = find_nucleus_force(g.cell, g.nucleus);
+    ASSERT_EQ(find_nucleus_force(g.cell, g.nucleus, workspace), force);
+    ASSERT_EQ(workspace.boundary, find_boundary(g.cell, g.nucleus));
+    ASSERT_EQ(workspace.dist, find_dist(g.cell, g.nucleus));
+    ASSERT_EQ(find_force_vector(g.nucleus, workspace.force, workspace), find_force_vector(g.nucleus, force));
+  }
+}
+
+TEST(WorkspaceTests, LevelsMatchFreshLevels) {
+  DistanceLevels levels;
+  for (unsigned seed = 0; seed < 4; ++seed) {
+    RandomGeometry g(30 + 10 * (seed % 2), 35, seed);
+    Grid<int> dist = find_dist(g.cell, g.nucleus);
+    DistanceLevels fresh = build_levels(dist);
+
+    build_levels(dist, levels);
+
+    ASSERT_EQ(levels.rows, fresh.rows);
+    ASSERT_EQ(levels.cols, fresh.cols);
+    ASSERT_EQ(levels.offsets, fresh.offsets);
+    ASSERT_EQ(levels.pixels, fresh.pixels);
+  }
+}
+
+TEST(WorkspaceTests, RepeatedFramesAllocateNothing) {
+  // A different frame of the same size whose cell needs no more levels or queue space
+  RandomGeometry first(80, 90, 1, true);
+  RandomGeometry second(80, 90, 8, true);
+  Workspace workspace;
+  find_nucleus_force(first.cell, first.nucleus, workspace);
+  find_nucleus_force(first.cell, first.nucleus, first.force, workspace);
+  find_force_vector(first.nucleus, workspace.force, workspace);
+
+  Workspace needed;
+  find_nucleus_force(second.cell, second.nucleus, needed);
+  find_nucleus_force(second.cell, second.nucleus, second.force, needed);
+  ASSERT_NE(needed.dist, workspace.dist);
+  ASSERT_LE(needed.levels.offsets.size(), workspace.levels.offsets.capacity());
+  ASSERT_LE(needed.levels.pixels.size(), workspace.levels.pixels.capacity());
+  // The frontier and queue shrink back by the end of each call, so compare how far a fresh workspace grew them
+  ASSERT_LE(needed.frontier.capacity(), workspace.frontier.capacity());
+  ASSERT_LE(needed.queue.capacity(), workspace.queue.capacity());
+
+  long long before = allocations;
+  find_dist(second.cell, second.nucleus, workspace);
+  find_boundary(second.cell, second.nucleus, workspace);
+  find_nucleus_force(second.cell, second.nucleus, workspace);
+  find_force_vector(second.nucleus, workspace.force, workspace);
+  find_nucleus_force(second.cell, second.nucleus, second.force, workspace);
+  long long after = allocations;
+
+  ASSERT_EQ(after - before, 0);
+  // Without a workspace the same call does allocate
+  find_nucleus_force(second.cell, second.nucleus);
+  ASSERT_GT(allocations - after, 0);
+}